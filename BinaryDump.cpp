@@ -0,0 +1,62 @@
+#include <Std.h>
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <BinaryDump.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+void WriteBinaryDump(const string &filename, const CMatrix &matrix, const CBlockedAxis &x, const CBlockedAxis &y,
+                     size_t rankX, size_t rankY, MPI_Comm comm, size_t halo) {
+    CBinaryDumpHeader header;
+    copy(BinaryDumpMagic, BinaryDumpMagic + sizeof(BinaryDumpMagic), header.Magic);
+    header.PointsX = x.Size();
+    header.PointsY = y.Size();
+    header.ValueSize = sizeof(NumericType);
+    const MPI_Offset valuesOffset = static_cast<MPI_Offset>( header.ValueOffset(0, 0));
+
+    MPI_File file;
+    MpiCheck(MPI_File_open(comm, const_cast<char *>( filename.c_str()), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                           MPI_INFO_NULL, &file), "MPI_File_open");
+    MpiCheck(MPI_File_set_size(file, 0), "MPI_File_set_size"); // старое содержимое длиннее нового
+
+    int rank = 0;
+    MpiCheck(MPI_Comm_rank(comm, &rank), "MPI_Comm_rank");
+    if (rank == 0) {
+        MpiCheck(MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE),
+                 "MPI_File_write_at");
+        MpiCheck(MPI_File_write_at(file, sizeof(header), const_cast<NumericType *>( &x.Points[0] ),
+                                   static_cast<int>( x.Size()), MpiNumericType, MPI_STATUS_IGNORE),
+                 "MPI_File_write_at");
+        MpiCheck(MPI_File_write_at(file, sizeof(header) + x.Size() * sizeof(NumericType),
+                                   const_cast<NumericType *>( &y.Points[0] ), static_cast<int>( y.Size()),
+                                   MpiNumericType, MPI_STATUS_IGNORE),
+                 "MPI_File_write_at");
+    }
+
+    // Свой блок: в файле - подмассив всей сетки, в памяти - подмассив матрицы с "заездом".
+    int subsizes[2] = {static_cast<int>( y.BlockSize(rankY)), static_cast<int>( x.BlockSize(rankX))};
+    int fileSizes[2] = {static_cast<int>( y.Size()), static_cast<int>( x.Size())};
+    int fileStarts[2] = {static_cast<int>( y.Begins[rankY] ), static_cast<int>( x.Begins[rankX] )};
+    int memorySizes[2] = {static_cast<int>( matrix.SizeY()), static_cast<int>( matrix.SizeX())};
+    int memoryStarts[2] = {static_cast<int>( rankY > 0 ? halo : 0 ), static_cast<int>( rankX > 0 ? halo : 0 )};
+    MPI_Datatype fileType;
+    MPI_Datatype memoryType;
+    MpiCheck(MPI_Type_create_subarray(2, fileSizes, subsizes, fileStarts, MPI_ORDER_C, MpiNumericType, &fileType),
+             "MPI_Type_create_subarray");
+    MpiCheck(MPI_Type_commit(&fileType), "MPI_Type_commit");
+    MpiCheck(MPI_Type_create_subarray(2, memorySizes, subsizes, memoryStarts, MPI_ORDER_C, MpiNumericType,
+                                      &memoryType), "MPI_Type_create_subarray");
+    MpiCheck(MPI_Type_commit(&memoryType), "MPI_Type_commit");
+
+    MpiCheck(MPI_File_set_view(file, valuesOffset, MpiNumericType, fileType, const_cast<char *>( "native" ),
+                               MPI_INFO_NULL), "MPI_File_set_view");
+    MpiCheck(MPI_File_write_at_all(file, 0, const_cast<NumericType *>( matrix.Pointer(0, 0)), 1, memoryType,
+                                   MPI_STATUS_IGNORE), "MPI_File_write_at_all");
+
+    MPI_Type_free(&memoryType);
+    MPI_Type_free(&fileType);
+    MpiCheck(MPI_File_close(&file), "MPI_File_close");
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Двоичный файл результата: заголовок, узлы оси X (PointsX чисел), узлы оси Y (PointsY чисел),
+// затем значения во всех узлах сетки по строкам (x - подряд). Числа - NumericType в порядке байт машины.
+
+const char BinaryDumpMagic[8] = { 'D', 'I', 'R', 'C', 'H', 'B', 'I', 'N' };
+
+struct CBinaryDumpHeader {
+	char Magic[8]; // BinaryDumpMagic
+	uint64_t PointsX;
+	uint64_t PointsY;
+	uint64_t ValueSize; // sizeof( NumericType ) записавшей программы
+
+	// Смещение значения узла ( x, y ) от начала файла.
+	uint64_t ValueOffset( uint64_t x, uint64_t y ) const
+	{
+		return sizeof( CBinaryDumpHeader ) + ( PointsX + PointsY + y * PointsX + x ) * ValueSize;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef MPI_VERSION
+// Все процессы comm пишут свои блоки matrix (без "заезда") в один файл filename:
+// MPI_File_write_at_all через вид файла - подмассив всей сетки. Заголовок и оси пишет ранк 0.
+// Блок процесса - ( rankX, rankY ) в разбиении осей x и y, halo - ширина "заезда" matrix со стороны соседей.
+void WriteBinaryDump( const string& filename, const CMatrix& matrix, const CBlockedAxis& x, const CBlockedAxis& y,
+	size_t rankX, size_t rankY, MPI_Comm comm, size_t halo = 1 );
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
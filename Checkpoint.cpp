@@ -0,0 +1,206 @@
+#include <Std.h>
+#include <stdio.h>
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <Errors.h>
+#include <Options.h>
+#include <Profiler.h>
+#include <Checkpoint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+CCheckpoint::CCheckpoint(const CBlockedAxis &x, const CBlockedAxis &y, size_t rankX, size_t rankY, MPI_Comm comm,
+                         size_t halo) :
+        comm(comm),
+        rank(0),
+        axisX(x),
+        axisY(y),
+        rankX(rankX),
+        rankY(rankY),
+        halo(halo),
+        everyIterations(0),
+        everySeconds(0),
+        lastTime(MPI_Wtime()),
+        dueFlag(0),
+        dueRequest(MPI_REQUEST_NULL),
+        writing(false),
+        file(MPI_FILE_NULL),
+        writeRequest(MPI_REQUEST_NULL),
+        fileType(MPI_DATATYPE_NULL) {
+    MpiCheck(MPI_Comm_rank(comm, &rank), "MPI_Comm_rank");
+}
+
+CCheckpoint::~CCheckpoint() {
+    try {
+        Finish();
+        if (dueRequest != MPI_REQUEST_NULL) {
+            MPI_Wait(&dueRequest, MPI_STATUS_IGNORE);
+        }
+    } catch (...) {
+        // деструктор не бросает: незаконченный файл остаётся с суффиксом .tmp
+    }
+}
+
+void CCheckpoint::SetSchedule(size_t iterations, double seconds) {
+    everyIterations = iterations;
+    everySeconds = seconds;
+}
+
+bool CCheckpoint::Due(size_t iteration) {
+    bool due = (everyIterations > 0 && iteration % everyIterations == 0);
+    if (everySeconds > 0) {
+        if (dueRequest != MPI_REQUEST_NULL) { // решение ранка 0 с прошлой итерации уже пришло
+            MpiCheck(MPI_Wait(&dueRequest, MPI_STATUS_IGNORE), "MPI_Wait");
+            due = due || (dueFlag != 0);
+        }
+        dueFlag = 0;
+        if (rank == 0 && MPI_Wtime() - lastTime >= everySeconds) {
+            dueFlag = 1;
+            lastTime = MPI_Wtime();
+        }
+        MpiCheck(MPI_Ibcast(&dueFlag, 1, MPI_INT, 0, comm, &dueRequest), "MPI_Ibcast");
+    }
+    return due;
+}
+
+MPI_Datatype CCheckpoint::blockType(size_t matrices, bool withHalo) const {
+    int sizes[3] = {static_cast<int>( matrices ), static_cast<int>( axisY.Size()), static_cast<int>( axisX.Size())};
+    int subsizes[3] = {static_cast<int>( matrices ), static_cast<int>( axisY.BlockSize(rankY)),
+                       static_cast<int>( axisX.BlockSize(rankX))};
+    int starts[3] = {0, static_cast<int>( axisY.Begins[rankY] ), static_cast<int>( axisX.Begins[rankX] )};
+    if (withHalo) { // блок с "заездом" - как матрицы CProgram
+        const bool left = (rankX > 0);
+        const bool top = (rankY > 0);
+        const bool right = (rankX + 1 < axisX.Blocks());
+        const bool bottom = (rankY + 1 < axisY.Blocks());
+        const int width = static_cast<int>( halo );
+        subsizes[1] += (top ? width : 0) + (bottom ? width : 0);
+        subsizes[2] += (left ? width : 0) + (right ? width : 0);
+        starts[1] -= top ? width : 0;
+        starts[2] -= left ? width : 0;
+    }
+    MPI_Datatype type;
+    MpiCheck(MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MpiNumericType, &type),
+             "MPI_Type_create_subarray");
+    MpiCheck(MPI_Type_commit(&type), "MPI_Type_commit");
+    return type;
+}
+
+void CCheckpoint::Start(const string &_filename, uint64_t mode, size_t iteration, const vector<CMatrix *> &matrices,
+                        const vector<NumericType> &scalars) {
+    Finish();
+    CPhaseTimer timer(PP_Checkpoint, matrices.size() * axisX.BlockSize(rankX) * axisY.BlockSize(rankY));
+
+    copy(CheckpointMagic, CheckpointMagic + sizeof(CheckpointMagic), header.Magic);
+    header.PointsX = axisX.Size();
+    header.PointsY = axisY.Size();
+    header.ValueSize = sizeof(NumericType);
+    header.Mode = mode;
+    header.Iteration = iteration;
+    header.Scalars = scalars.size();
+    header.Matrices = matrices.size();
+
+    // Снимок: итерации меняют матрицы, пока файл пишется.
+    const size_t sizeX = axisX.BlockSize(rankX);
+    const size_t sizeY = axisY.BlockSize(rankY);
+    const size_t beginX = (rankX > 0) ? halo : 0;
+    const size_t beginY = (rankY > 0) ? halo : 0;
+    values.assign(scalars.begin(), scalars.end());
+    values.reserve(scalars.size() + matrices.size() * sizeX * sizeY);
+    for (size_t m = 0; m < matrices.size(); m++) {
+        for (size_t y = 0; y < sizeY; y++) {
+            const NumericType *row = matrices[m]->Pointer(beginX, beginY + y);
+            values.insert(values.end(), row, row + sizeX);
+        }
+    }
+
+    filename = _filename;
+    const string temporary = filename + ".tmp";
+    MpiCheck(MPI_File_open(comm, const_cast<char *>( temporary.c_str()), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                           MPI_INFO_NULL, &file), "MPI_File_open");
+    MpiCheck(MPI_File_set_size(file, 0), "MPI_File_set_size");
+    if (rank == 0) {
+        MpiCheck(MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE),
+                 "MPI_File_write_at");
+        if (!scalars.empty()) {
+            MpiCheck(MPI_File_write_at(file, sizeof(header), &values[0], static_cast<int>( scalars.size()),
+                                       MpiNumericType, MPI_STATUS_IGNORE), "MPI_File_write_at");
+        }
+    }
+    fileType = blockType(matrices.size(), false);
+    MpiCheck(MPI_File_set_view(file, sizeof(header) + scalars.size() * sizeof(NumericType), MpiNumericType, fileType,
+                               const_cast<char *>( "native" ), MPI_INFO_NULL), "MPI_File_set_view");
+    MpiCheck(MPI_File_iwrite_at_all(file, 0, &values[0] + scalars.size(),
+                                    static_cast<int>( values.size() - scalars.size()), MpiNumericType,
+                                    &writeRequest), "MPI_File_iwrite_at_all");
+    writing = true;
+}
+
+void CCheckpoint::Finish() {
+    if (!writing) {
+        return;
+    }
+    CPhaseTimer timer(PP_Checkpoint); // записанные значения учтены в Start
+    writing = false;
+    MpiCheck(MPI_Wait(&writeRequest, MPI_STATUS_IGNORE), "MPI_Wait");
+    MpiCheck(MPI_File_close(&file), "MPI_File_close");
+    MPI_Type_free(&fileType);
+    // Переименование после закрытия: прерванная запись не портит прошлую контрольную точку.
+    if (rank == 0 && rename((filename + ".tmp").c_str(), filename.c_str()) != 0) {
+        throw CException("cannot rename checkpoint `" + filename + ".tmp`");
+    }
+}
+
+size_t CCheckpoint::Read(const string &_filename, uint64_t mode, const vector<CMatrix *> &matrices,
+                         vector<NumericType> &scalars) {
+    Finish();
+    CPhaseTimer timer(PP_Checkpoint, matrices.size() * axisX.BlockSize(rankX) * axisY.BlockSize(rankY));
+
+    MPI_File input;
+    MpiCheck(MPI_File_open(comm, const_cast<char *>( _filename.c_str()), MPI_MODE_RDONLY, MPI_INFO_NULL, &input),
+             "MPI_File_open");
+    CCheckpointHeader fileHeader;
+    MpiCheck(MPI_File_read_at_all(input, 0, &fileHeader, sizeof(fileHeader), MPI_BYTE, MPI_STATUS_IGNORE),
+             "MPI_File_read_at_all");
+    if (!equal(CheckpointMagic, CheckpointMagic + sizeof(CheckpointMagic), fileHeader.Magic)) {
+        throw CException("`" + _filename + "` is not a dirch checkpoint");
+    }
+    if (fileHeader.PointsX != axisX.Size() || fileHeader.PointsY != axisY.Size()) {
+        throw CException("checkpoint `" + _filename + "` was written for another grid");
+    }
+    if (fileHeader.ValueSize != sizeof(NumericType) || fileHeader.Mode != mode ||
+        fileHeader.Matrices != matrices.size()) {
+        throw CException("checkpoint `" + _filename + "` was written by another iteration method");
+    }
+
+    scalars.resize(fileHeader.Scalars);
+    if (!scalars.empty()) {
+        MpiCheck(MPI_File_read_at_all(input, sizeof(fileHeader), &scalars[0], static_cast<int>( scalars.size()),
+                                      MpiNumericType, MPI_STATUS_IGNORE), "MPI_File_read_at_all");
+    }
+
+    // Блок читается вместе с "заездом": соседние значения берутся из файла, обмен не нужен.
+    MPI_Datatype type = blockType(matrices.size(), true);
+    MpiCheck(MPI_File_set_view(input, sizeof(fileHeader) + scalars.size() * sizeof(NumericType), MpiNumericType,
+                               type, const_cast<char *>( "native" ), MPI_INFO_NULL), "MPI_File_set_view");
+    const size_t sizeX = axisX.BlockSize(rankX) + (rankX > 0 ? halo : 0) + (rankX + 1 < axisX.Blocks() ? halo : 0);
+    const size_t sizeY = axisY.BlockSize(rankY) + (rankY > 0 ? halo : 0) + (rankY + 1 < axisY.Blocks() ? halo : 0);
+    for (size_t m = 0; m < matrices.size(); m++) {
+        assert(matrices[m]->SizeX() == sizeX && matrices[m]->SizeY() == sizeY);
+    }
+    const size_t size = matrices.size() * sizeX * sizeY;
+    vector<NumericType> buffer(size);
+    MpiCheck(MPI_File_read_at_all(input, 0, buffer.empty() ? 0 : &buffer[0], static_cast<int>( size ),
+                                  MpiNumericType, MPI_STATUS_IGNORE), "MPI_File_read_at_all");
+    MPI_Type_free(&type);
+    MpiCheck(MPI_File_close(&input), "MPI_File_close");
+
+    const NumericType *from = buffer.empty() ? 0 : &buffer[0];
+    for (size_t m = 0; m < matrices.size(); m++, from += sizeX * sizeY) {
+        copy(from, from + sizeX * sizeY, matrices[m]->Pointer(0, 0));
+    }
+    return static_cast<size_t>( fileHeader.Iteration );
+}
+
+///////////////////////////////////////////////////////////////////////////////
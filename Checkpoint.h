@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Файл контрольной точки: заголовок, числа состояния (Scalars штук), затем матрицы состояния
+// целиком по всей сетке (Matrices x PointsY x PointsX, x - подряд). "Заезд" не хранится,
+// поэтому при восстановлении сетку можно разбить на другое число процессов.
+
+const char CheckpointMagic[8] = { 'D', 'I', 'R', 'C', 'H', 'C', 'K', 'P' };
+
+struct CCheckpointHeader {
+	char Magic[8]; // CheckpointMagic
+	uint64_t PointsX;
+	uint64_t PointsY;
+	uint64_t ValueSize; // sizeof( NumericType )
+	uint64_t Mode; // TIterationMode записавшего метода
+	uint64_t Iteration; // сколько итераций (с нулевой) выполнено
+	uint64_t Scalars;
+	uint64_t Matrices;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CCheckpoint {
+private:
+	CCheckpoint( const CCheckpoint& );
+	CCheckpoint& operator=( const CCheckpoint& );
+
+public:
+	// Блоки процессов - как в CMultigrid: ранк блока ( bx, by ) в comm равен by * x.Blocks() + bx.
+	// halo - ширина "заезда" матриц со стороны соседей.
+	CCheckpoint( const CBlockedAxis& x, const CBlockedAxis& y, size_t rankX, size_t rankY, MPI_Comm comm,
+		size_t halo = 1 );
+	~CCheckpoint(); // дожидается начатой записи
+
+	// Расписание: каждые iterations итераций и/или каждые seconds секунд (0 - не используется).
+	void SetSchedule( size_t iterations, double seconds );
+	// Пора ли писать после итерации iteration. Коллективный вызов: решение по времени принимает ранк 0,
+	// оно приходит к остальным неблокирующим MPI_Ibcast и действует на следующей итерации.
+	bool Due( size_t iteration );
+
+	// Начать запись: свои узлы матриц и числа копируются, файл пишется MPI_File_iwrite_at_all,
+	// пока идут итерации. Запись идёт в filename.tmp и после окончания переименовывается в filename.
+	void Start( const string& filename, uint64_t mode, size_t iteration, const vector<CMatrix*>& matrices,
+		const vector<NumericType>& scalars );
+	// Дождаться окончания начатой записи (если она есть).
+	void Finish();
+
+	// Прочитать состояние, записанное Start: матрицы - вместе с "заездом", числа - в scalars.
+	// Бросает CException, если файл записан для другой сетки, метода или набора состояния.
+	size_t Read( const string& filename, uint64_t mode, const vector<CMatrix*>& matrices,
+		vector<NumericType>& scalars );
+
+private:
+	MPI_Comm comm;
+	int rank;
+	CBlockedAxis axisX;
+	CBlockedAxis axisY;
+	size_t rankX;
+	size_t rankY;
+	size_t halo;
+	// Расписание.
+	size_t everyIterations;
+	double everySeconds;
+	double lastTime; // ранк 0: когда было назначено последнее сохранение
+	int dueFlag; // буфер MPI_Ibcast
+	MPI_Request dueRequest; // MPI_REQUEST_NULL - рассылки нет
+	// Начатая запись.
+	bool writing;
+	string filename;
+	MPI_File file;
+	MPI_Request writeRequest;
+	MPI_Datatype fileType;
+	CCheckpointHeader header;
+	vector<NumericType> values; // снимок: числа (только ранк 0 пишет их) и свои узлы матриц
+
+	// Вид файла на блок процесса: подмассив Matrices x PointsY x PointsX.
+	MPI_Datatype blockType( size_t matrices, bool withHalo ) const;
+};
+
+///////////////////////////////////////////////////////////////////////////////
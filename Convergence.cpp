@@ -0,0 +1,125 @@
+#include <Std.h>
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <Options.h>
+#include <Profiler.h>
+#include <Convergence.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+CConvergenceMonitor::CConvergenceMonitor(TConvergenceCheck check, size_t period, TNorm norm, NumericType eps,
+                                         MPI_Comm comm) :
+        check(check),
+        period(max<size_t>(period, 1)),
+        norm(norm),
+        eps(eps),
+        comm(comm),
+        request(MPI_REQUEST_NULL),
+        pendingIteration(0),
+        buffer(0),
+        haveResult(false),
+        result(0),
+        nextDue(0),
+        step(1),
+        closing(false),
+        haveHistory(false),
+        lastValue(0),
+        lastIteration(0) {
+    assert(check != CC_Auto);
+}
+
+CConvergenceMonitor::~CConvergenceMonitor() {
+    Finish();
+}
+
+bool CConvergenceMonitor::Due(size_t iteration) {
+    switch (check) {
+        case CC_Auto: // разрешается в ParseArguments
+        case CC_Every:
+            return true;
+        case CC_Periodic:
+            return iteration % period == 0;
+        case CC_Adaptive:
+            complete();
+            return iteration >= nextDue;
+    }
+    return true;
+}
+
+void CConvergenceMonitor::Submit(size_t iteration, const CUpdateNorms &norms, NumericType &difference) {
+    complete();
+    if (haveResult) {
+        difference = result;
+        haveResult = false;
+    }
+    if (!Due(iteration)) {
+        return;
+    }
+    const bool isMax = (norm == N_Max);
+    buffer = isMax ? norms.Max : norms.Squares;
+    if (comm == MPI_COMM_NULL) { // один процесс: значение известно сразу
+        accept(iteration, norms.Value(norm));
+    } else if (check == CC_Every) {
+        CPhaseTimer timer(PP_Allreduce, 1);
+        MpiCheck(MPI_Allreduce(MPI_IN_PLACE, &buffer, 1, MpiNumericType, isMax ? MPI_MAX : MPI_SUM, comm),
+                 "MPI_Allreduce");
+        CUpdateNorms total;
+        total.Squares = buffer;
+        total.Max = buffer;
+        accept(iteration, total.Value(norm));
+    } else {
+        MpiCheck(MPI_Iallreduce(MPI_IN_PLACE, &buffer, 1, MpiNumericType, isMax ? MPI_MAX : MPI_SUM, comm, &request),
+                 "MPI_Iallreduce");
+        pendingIteration = iteration;
+        return;
+    }
+    difference = result;
+    haveResult = false;
+}
+
+void CConvergenceMonitor::Finish() {
+    complete();
+    haveResult = false;
+}
+
+void CConvergenceMonitor::complete() {
+    if (request == MPI_REQUEST_NULL) {
+        return;
+    }
+    CPhaseTimer timer(PP_Allreduce, 1);
+    MpiCheck(MPI_Wait(&request, MPI_STATUS_IGNORE), "MPI_Wait");
+    CUpdateNorms total;
+    total.Squares = buffer;
+    total.Max = buffer;
+    accept(pendingIteration, total.Value(norm));
+}
+
+void CConvergenceMonitor::accept(size_t iteration, NumericType value) {
+    result = value;
+    haveResult = true;
+    if (check != CC_Adaptive) {
+        return;
+    }
+    // Скорость сходимости - по двум последним проверкам: value ~ lastValue * q^(iteration - lastIteration).
+    // Следующая проверка - на половине пути до eps, так что проверки сгущаются к концу решения.
+    // Изменение убывает не монотонно, и у близких проверок оценка скорости шумит: стоит пересечению
+    // один раз приблизиться меньше чем на два периода, шаг дальше только уменьшается.
+    if (haveHistory && value > 0 && value < lastValue && iteration > lastIteration) {
+        const double rate = log(static_cast<double>( value / lastValue )) /
+                            static_cast<double>( iteration - lastIteration );
+        const double remaining = log(static_cast<double>( eps / value )) / rate;
+        const size_t projected = (remaining < 2) ? 1 : static_cast<size_t>( min(remaining / 2,
+                                                                                   static_cast<double>( period )) );
+        step = closing ? min(step, projected) : projected;
+        closing = closing || projected < period;
+    } else if (haveHistory && !closing) { // изменение не убывает: скорость не оценить, проверки реже
+        step = min(period, 2 * step);
+    }
+    haveHistory = true;
+    lastValue = value;
+    lastIteration = iteration;
+    nextDue = iteration + step;
+}
+
+///////////////////////////////////////////////////////////////////////////////
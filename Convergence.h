@@ -0,0 +1,57 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Проверка сходимости (--convergence): когда норма изменения p редуцируется по процессам.
+// При CC_Periodic и CC_Adaptive редукция неблокирующая (MPI_Iallreduce) и завершается на следующей
+// итерации, так что difference отстаёт от итераций на одну-k итераций, а решение может сделать
+// столько же лишних итераций. Между проверками difference - последнее известное общее значение.
+// Расписание на всех процессах одинаково: оно зависит только от номера итерации и общих значений.
+class CConvergenceMonitor {
+private:
+	CConvergenceMonitor( const CConvergenceMonitor& );
+	CConvergenceMonitor& operator=( const CConvergenceMonitor& );
+
+public:
+	// check - уже разрешённый, не CC_Auto; period - k для CC_Periodic, наибольший шаг проверок для CC_Adaptive;
+	// eps - порог, к которому CC_Adaptive подгоняет проверки. comm == MPI_COMM_NULL - один процесс, без редукций.
+	CConvergenceMonitor( TConvergenceCheck check, size_t period, TNorm norm, NumericType eps, MPI_Comm comm );
+	~CConvergenceMonitor(); // Finish
+
+	// Нужна ли норма изменения после итерации iteration; если нет, её можно не считать.
+	// Коллективный вызов: завершает начатую редукцию, от неё зависит расписание CC_Adaptive.
+	bool Due( size_t iteration );
+
+	// Конец итерации iteration: завершить начатую редукцию (её значение - в difference)
+	// и, если итерация назначена для проверки, начать редукцию norms. Иначе norms не используются.
+	void Submit( size_t iteration, const CUpdateNorms& norms, NumericType& difference );
+
+	// Дождаться начатой редукции после последней итерации; её значение уже не нужно.
+	void Finish();
+
+private:
+	const TConvergenceCheck check;
+	const size_t period;
+	const TNorm norm;
+	const NumericType eps;
+	const MPI_Comm comm;
+	// Начатая редукция.
+	MPI_Request request; // MPI_REQUEST_NULL - редукции нет
+	size_t pendingIteration;
+	NumericType buffer;
+	// Завершённая редукция, значение которой ещё не передано в Submit.
+	bool haveResult;
+	NumericType result;
+	// CC_Adaptive: следующая проверка, шаг проверок и прошлое общее значение.
+	size_t nextDue;
+	size_t step;
+	bool closing; // пересечение eps уже близко: шаг не растёт
+	bool haveHistory;
+	NumericType lastValue;
+	size_t lastIteration;
+
+	void complete(); // MPI_Wait начатой редукции
+	void accept( size_t iteration, NumericType value ); // общее значение итерации iteration
+};
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,483 @@
+#include <Std.h>
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <Options.h>
+#include <Profiler.h>
+#include <Exchange.h>
+#include <SharedMemory.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Теги сообщений в коммуникаторе обмена: полосы - 0, служебные сообщения EM_Shared - свои.
+static const int GeometryTag = 1; // полоса соседа по узлу и ширина его матрицы
+static const int ReadyTag = 2; // свои полосы записаны
+static const int ReadTag = 3; // полосы соседа прочитаны
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void CExchangeDefinitionT<T>::DoExchange(CMatrixT<T> &matrix) {
+    sendBuffer.clear(); // Очищаем значения, которые посылали в прошлый раз (это вектор)
+    for (size_t x = sendPart.BeginX;
+         x < sendPart.EndX; x++) { // пушим в буффер для отправки нужную часть матрицы (часть колонки или стобца)
+        for (size_t y = sendPart.BeginY; y < sendPart.EndY; y++) {
+            sendBuffer.push_back(matrix(x, y));
+        }
+    }
+
+    MpiCheck( // проверить на 0 и выбросить excepion
+            MPI_Isend( // возвращает код ошибки или 0
+                    sendBuffer.data(), // адресс начала данных
+                    sendBuffer.size(), // кол-во данных
+                    MpiTypeOf<T>(), // тип данных
+                    rank, // адресс отправки
+                    0, // id сообщения
+                    comm, // коммуникатор
+                    &sendRequest) // OUT - "запрос обмена".
+            , "MPI_Isend"); // текс exceptionа
+
+    recvBuffer.resize(recvPart.Size());
+    MpiCheck( // проверить на 0 и выбросить excepion
+            MPI_Irecv( // возвращает код ошибки или 0
+                    recvBuffer.data(), // адресс начала данных
+                    recvBuffer.size(), // кол-во данных
+                    MpiTypeOf<T>(), // тип данных
+                    rank, // адресс отправки
+                    0, // id сообщения
+                    comm, // коммуникатор
+                    &recvRequest), // OUT - "запрос обмена".
+            "MPI_Irecv"); // текс exceptionа
+}
+
+template<typename T>
+void CExchangeDefinitionT<T>::Wait(CMatrixT<T> &matrix) {
+    MpiCheck( // проверить на 0 и выбросить excepion
+            MPI_Wait( // блокируемся, пока не получим
+                    &recvRequest, // переменная, отвечающая за текущий запрос
+                     MPI_STATUS_IGNORE), // Mpi_status field будет проигнорирован (передается в Iresv для синхронных операций),
+            // иначе можно указатель, куда записывать указать
+            "MPI_Wait"); // текс exceptionа
+
+    typename vector<T>::const_iterator value = recvBuffer.begin(); // Копируем данные в матрицу в текущий процесс
+    for (size_t x = recvPart.BeginX; x < recvPart.EndX; x++) {
+        for (size_t y = recvPart.BeginY; y < recvPart.EndY; y++) {
+            matrix(x, y) = *value;
+            ++value;
+        }
+    }
+
+    MpiCheck( // проверить на 0 и выбросить excepion
+            MPI_Wait( // блокируемся, пока не отправим
+                    &sendRequest, // переменная, отвечающая за текущий запрос
+                    MPI_STATUS_IGNORE),  // Mpi_status field будет проигнорирован (передается в Iresv для синхронных операций),
+            // иначе можно указатель, куда записывать указать
+            "MPI_Wait"); // текс exceptionа
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+CExchangeDefinitionsT<T>::~CExchangeDefinitionsT() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (finalized != 0) {
+        return; // после MPI_Finalize освобождать уже нечего
+    }
+    for (typename map<const T *, vector<MPI_Request> >::iterator i = persistentRequests.begin();
+         i != persistentRequests.end(); ++i) {
+        for (vector<MPI_Request>::iterator request = i->second.begin(); request != i->second.end(); ++request) {
+            MPI_Request_free(&*request);
+        }
+    }
+    for (vector<MPI_Datatype>::iterator type = types.begin(); type != types.end(); ++type) {
+        MPI_Type_free(&*type);
+    }
+    for (typename vector<pair<const T *, MPI_Win> >::iterator window = rmaWindows.begin();
+         window != rmaWindows.end(); ++window) {
+        MPI_Win_free(&window->second);
+    }
+    if (neighborGroup != MPI_GROUP_NULL) {
+        MPI_Group_free(&neighborGroup);
+    }
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::InitHalo(const CUniformGrid &grid, int left, int right, int top, int bottom,
+                                    MPI_Comm comm) {
+    InitHalo(grid, 1, left, right, top, bottom, -1, -1, -1, -1, comm);
+}
+
+// Полосы по одной оси: сдвиг соседа -1, 0 или +1, size - число узлов оси в матрице.
+// Со стороны соседа отправляются [width, 2 width) или [size - 2 width, size - width), принимается "заезд";
+// вдоль стороны (сдвиг 0) - свои узлы без глобальной границы, её значения известны обоим процессам.
+static void HaloRange(int shift, size_t size, size_t width, bool before, bool after, bool send,
+                      size_t &begin, size_t &end) {
+    if (shift < 0) {
+        begin = send ? width : 0;
+    } else if (shift > 0) {
+        begin = send ? size - 2 * width : size - width;
+    } else {
+        begin = before ? width : 1;
+        end = size - (after ? width : 1);
+        return;
+    }
+    end = begin + width;
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::InitHalo(const CUniformGrid &grid, size_t width, int left, int right, int top,
+                                        int bottom, int topLeft, int topRight, int bottomLeft, int bottomRight,
+                                        MPI_Comm comm) {
+    // Порядок обменов: стороны (как при ширине 1), затем углы.
+    const int ranks[8] = {left, right, top, bottom, topLeft, topRight, bottomLeft, bottomRight};
+    const int shiftsX[8] = {-1, 1, 0, 0, -1, 1, -1, 1};
+    const int shiftsY[8] = {0, 0, -1, 1, -1, -1, 1, 1};
+    for (size_t i = 0; i < 8; i++) {
+        if (ranks[i] < 0) { // проверка, не крайний ли наш блок
+            continue;
+        }
+        CMatrixPart sendPart;
+        CMatrixPart recvPart;
+        HaloRange(shiftsX[i], grid.X.Size(), width, left >= 0, right >= 0, true, sendPart.BeginX, sendPart.EndX);
+        HaloRange(shiftsY[i], grid.Y.Size(), width, top >= 0, bottom >= 0, true, sendPart.BeginY, sendPart.EndY);
+        HaloRange(shiftsX[i], grid.X.Size(), width, left >= 0, right >= 0, false, recvPart.BeginX, recvPart.EndX);
+        HaloRange(shiftsY[i], grid.Y.Size(), width, top >= 0, bottom >= 0, false, recvPart.BeginY, recvPart.EndY);
+        this->push_back(CDefinition(ranks[i], sendPart, recvPart, comm));
+    }
+    gridSizeX = grid.X.Size();
+    gridSizeY = grid.Y.Size();
+    if (mode == EM_Shared || mode == EM_Rma) {
+        initGeometry(comm);
+    }
+    if (mode == EM_Shared) {
+        initShared(comm);
+    } else if (mode == EM_Rma) {
+        initRma(comm);
+    }
+}
+
+template<typename T>
+size_t CExchangeDefinitionsT<T>::haloSize() const {
+    size_t size = 0;
+    for (typename CExchangeDefinitionsT::const_iterator i = this->begin(); i != this->end(); ++i) {
+        size += i->SendPart().Size() + i->RecvPart().Size();
+    }
+    return size;
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::Start(CMatrixT<T> &matrix) {
+    CPhaseTimer timer(PP_ExchangeStart, CProfiler::Enabled() ? haloSize() : 0, sizeof(T));
+    if (mode == EM_Datatype) {
+        started = &requestsFor(matrix);
+        if (!started->empty()) {
+            MpiCheck(MPI_Startall(static_cast<int>( started->size()), started->data()), "MPI_Startall");
+        }
+        return;
+    }
+    if (mode == EM_Shared) {
+        startShared(matrix);
+        return;
+    }
+    if (mode == EM_Rma) {
+        startRma(matrix);
+        return;
+    }
+    for (typename CExchangeDefinitionsT::iterator i = this->begin(); i != this->end(); ++i) {
+        i->DoExchange(matrix); // асинхронный метод обмена
+    }
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::Finish(CMatrixT<T> &matrix) {
+    CPhaseTimer timer(PP_ExchangeWait);
+    if (mode == EM_Datatype) {
+        assert(started != 0 && started == &requestsFor(matrix));
+        if (!started->empty()) {
+            MpiCheck(MPI_Waitall(static_cast<int>( started->size()), started->data(), MPI_STATUSES_IGNORE),
+                     "MPI_Waitall");
+        }
+        started = 0;
+        return;
+    }
+    if (mode == EM_Shared) {
+        finishShared(matrix);
+        return;
+    }
+    if (mode == EM_Rma) {
+        finishRma();
+        return;
+    }
+    for (typename CExchangeDefinitionsT::iterator i = this->begin(); i != this->end(); ++i) {
+        i->Wait(matrix); // ждем окончания обмена
+    }
+}
+
+// Полоса part матрицы размера sizeX x sizeY как подмассив хранилища CMatrix (y - строки, x - столбцы).
+static MPI_Datatype CreatePartType(const CMatrixPart &part, size_t sizeX, size_t sizeY, MPI_Datatype valueType) {
+    const int sizes[2] = {static_cast<int>( sizeY ), static_cast<int>( sizeX )};
+    const int subsizes[2] = {static_cast<int>( part.SizeY()), static_cast<int>( part.SizeX())};
+    const int starts[2] = {static_cast<int>( part.BeginY ), static_cast<int>( part.BeginX )};
+    MPI_Datatype type;
+    MpiCheck(MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, valueType, &type),
+             "MPI_Type_create_subarray");
+    MpiCheck(MPI_Type_commit(&type), "MPI_Type_commit");
+    return type;
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::createTypes(const CMatrixT<T> &matrix) {
+    typesSizeX = matrix.SizeX();
+    typesSizeY = matrix.SizeY();
+    for (typename CExchangeDefinitionsT::const_iterator i = this->begin(); i != this->end(); ++i) {
+        types.push_back(CreatePartType(i->SendPart(), typesSizeX, typesSizeY, MpiTypeOf<T>()));
+        types.push_back(CreatePartType(i->RecvPart(), typesSizeX, typesSizeY, MpiTypeOf<T>()));
+    }
+}
+
+// Постоянные запросы создаются при первом обмене матрицей и затем только перезапускаются.
+// Адрес данных меняется только при Init или Swap, тогда под новый адрес заводятся свои запросы.
+template<typename T>
+vector<MPI_Request> &CExchangeDefinitionsT<T>::requestsFor(CMatrixT<T> &matrix) {
+    if (types.empty()) {
+        createTypes(matrix);
+    }
+    if (matrix.SizeX() != typesSizeX || matrix.SizeY() != typesSizeY) {
+        throw CException("exchanged matrices must have the same size");
+    }
+    vector<MPI_Request> &requests = persistentRequests[matrix.Pointer(0, 0)];
+    if (requests.empty() && !this->empty()) {
+        requests.resize(2 * this->size());
+        for (size_t i = 0; i < this->size(); i++) {
+            const int rank = static_cast<int>( (*this)[i].Rank());
+            MpiCheck(MPI_Send_init(matrix.Pointer(0, 0), 1, types[2 * i], rank, 0, (*this)[i].Comm(),
+                                   &requests[2 * i]), "MPI_Send_init");
+            MpiCheck(MPI_Recv_init(matrix.Pointer(0, 0), 1, types[2 * i + 1], rank, 0, (*this)[i].Comm(),
+                                   &requests[2 * i + 1]), "MPI_Recv_init");
+        }
+    }
+    return requests;
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::initGeometry(MPI_Comm comm) {
+    // Каждый сосед сообщает свои полосы для этого процесса и размер своей матрицы.
+    vector<unsigned long> sent(10 * this->size());
+    vector<unsigned long> received(10 * this->size());
+    vector<MPI_Request> requests(2 * this->size());
+    for (size_t i = 0; i < this->size(); i++) {
+        const CDefinition &definition = (*this)[i];
+        const CMatrixPart &send = definition.SendPart();
+        const CMatrixPart &recv = definition.RecvPart();
+        const unsigned long geometry[10] = {send.BeginX, send.EndX, send.BeginY, send.EndY,
+                                            recv.BeginX, recv.EndX, recv.BeginY, recv.EndY, gridSizeX, gridSizeY};
+        copy(geometry, geometry + 10, &sent[10 * i]);
+        const int rank = static_cast<int>( definition.Rank());
+        MpiCheck(MPI_Irecv(&received[10 * i], 10, MPI_UNSIGNED_LONG, rank, GeometryTag, comm, &requests[2 * i]),
+                 "MPI_Irecv");
+        MpiCheck(MPI_Isend(&sent[10 * i], 10, MPI_UNSIGNED_LONG, rank, GeometryTag, comm, &requests[2 * i + 1]),
+                 "MPI_Isend");
+    }
+    if (!requests.empty()) {
+        MpiCheck(MPI_Waitall(static_cast<int>( requests.size()), requests.data(), MPI_STATUSES_IGNORE),
+                 "MPI_Waitall");
+    }
+    neighbors.resize(this->size());
+    for (size_t i = 0; i < this->size(); i++) {
+        const unsigned long *geometry = &received[10 * i];
+        CNeighborGeometry &neighbor = neighbors[i];
+        neighbor.SendPart = CMatrixPart(geometry[0], geometry[1], geometry[2], geometry[3]);
+        neighbor.RecvPart = CMatrixPart(geometry[4], geometry[5], geometry[6], geometry[7]);
+        neighbor.SizeX = geometry[8];
+        neighbor.SizeY = geometry[9];
+        const CDefinition &definition = (*this)[i];
+        if (neighbor.SendPart.Size() != definition.RecvPart().Size() ||
+            neighbor.RecvPart.Size() != definition.SendPart().Size()) {
+            throw CException("halo exchange: the neighbor exchanges strips of another size");
+        }
+    }
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::initShared(MPI_Comm comm) {
+    nodeRanks.assign(this->size(), MPI_UNDEFINED);
+    if (CSharedMemory::NodeSize() < 2) {
+        return; // на узле один процесс: все обмены - сообщениями
+    }
+    for (size_t i = 0; i < this->size(); i++) {
+        nodeRanks[i] = CSharedMemory::NodeRank(comm, static_cast<int>( (*this)[i].Rank()));
+    }
+}
+
+template<typename T>
+typename CExchangeDefinitionsT<T>::CSharedView &CExchangeDefinitionsT<T>::sharedViewFor(CMatrixT<T> &matrix) {
+    if (matrix.SizeX() != gridSizeX || matrix.SizeY() != gridSizeY) {
+        throw CException("exchanged matrices must have the size of the grid");
+    }
+    typename map<const T *, CSharedView>::iterator found = sharedViews.find(matrix.Pointer(0, 0));
+    if (found != sharedViews.end()) {
+        return found->second;
+    }
+    MPI_Win window;
+    T *base = static_cast<T *>( CSharedMemory::Place(matrix.Pointer(0, 0), gridSizeX * gridSizeY * sizeof(T),
+                                                     window));
+    matrix.MoveTo(base);
+    CSharedView &view = sharedViews[base];
+    view.Window = window;
+    view.Neighbors.assign(this->size(), 0);
+    for (size_t i = 0; i < this->size(); i++) {
+        if (nodeRanks[i] != MPI_UNDEFINED) {
+            view.Neighbors[i] = static_cast<const T *>( CSharedMemory::Segment(window, nodeRanks[i]));
+        }
+    }
+    return view;
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::signalShared(int tag) {
+    signals.clear();
+    for (size_t i = 0; i < this->size(); i++) {
+        if (nodeRanks[i] == MPI_UNDEFINED) {
+            continue;
+        }
+        const int rank = static_cast<int>( (*this)[i].Rank());
+        signals.push_back(MPI_REQUEST_NULL);
+        MpiCheck(MPI_Irecv(0, 0, MPI_BYTE, rank, tag, (*this)[i].Comm(), &signals.back()), "MPI_Irecv");
+        signals.push_back(MPI_REQUEST_NULL);
+        MpiCheck(MPI_Isend(0, 0, MPI_BYTE, rank, tag, (*this)[i].Comm(), &signals.back()), "MPI_Isend");
+    }
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::startShared(CMatrixT<T> &matrix) {
+    // Окна коллективны по узлу, поэтому матрица переносится в окно, даже если соседей по узлу нет.
+    startedShared = (CSharedMemory::NodeSize() > 1) ? &sharedViewFor(matrix) : 0;
+    if (startedShared != 0) {
+        MpiCheck(MPI_Win_sync(startedShared->Window), "MPI_Win_sync"); // свои полосы записаны до сигнала
+        signalShared(ReadyTag);
+    }
+    for (size_t i = 0; i < this->size(); i++) {
+        if (nodeRanks[i] == MPI_UNDEFINED) {
+            (*this)[i].DoExchange(matrix); // сосед на другом узле
+        }
+    }
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::finishShared(CMatrixT<T> &matrix) {
+    if (startedShared != 0) {
+        if (!signals.empty()) {
+            MpiCheck(MPI_Waitall(static_cast<int>( signals.size()), signals.data(), MPI_STATUSES_IGNORE),
+                     "MPI_Waitall");
+        }
+        MpiCheck(MPI_Win_sync(startedShared->Window), "MPI_Win_sync"); // полосы соседей записаны до их сигналов
+        for (size_t i = 0; i < this->size(); i++) {
+            const T *neighbor = startedShared->Neighbors[i];
+            if (neighbor == 0) {
+                continue;
+            }
+            const CMatrixPart &from = neighbors[i].SendPart;
+            const CMatrixPart &to = (*this)[i].RecvPart();
+            for (size_t y = 0; y < to.SizeY(); y++) {
+                const T *row = neighbor + (from.BeginY + y) * neighbors[i].SizeX + from.BeginX;
+                copy(row, row + to.SizeX(), matrix.Pointer(to.BeginX, to.BeginY + y));
+            }
+        }
+        signalShared(ReadTag);
+    }
+    for (size_t i = 0; i < this->size(); i++) {
+        if (nodeRanks[i] == MPI_UNDEFINED) {
+            (*this)[i].Wait(matrix);
+        }
+    }
+    if (startedShared != 0) {
+        // Сосед меняет свои полосы только после того, как их прочитали все соседи по узлу.
+        if (!signals.empty()) {
+            MpiCheck(MPI_Waitall(static_cast<int>( signals.size()), signals.data(), MPI_STATUSES_IGNORE),
+                     "MPI_Waitall");
+        }
+        startedShared = 0;
+    }
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::initRma(MPI_Comm comm) {
+    if (this->empty()) {
+        return; // блок без соседей (один процесс в коммуникаторе): ни окон, ни эпох
+    }
+    rmaComm = comm;
+    vector<int> ranks;
+    for (size_t i = 0; i < this->size(); i++) {
+        const CDefinition &definition = (*this)[i];
+        ranks.push_back(static_cast<int>( definition.Rank()));
+        types.push_back(CreatePartType(definition.SendPart(), gridSizeX, gridSizeY, MpiTypeOf<T>()));
+        types.push_back(CreatePartType(neighbors[i].RecvPart, neighbors[i].SizeX, neighbors[i].SizeY,
+                                       MpiTypeOf<T>()));
+    }
+    sort(ranks.begin(), ranks.end()); // в группе каждый сосед один раз
+    ranks.erase(unique(ranks.begin(), ranks.end()), ranks.end());
+    MPI_Group group;
+    MpiCheck(MPI_Comm_group(comm, &group), "MPI_Comm_group");
+    MpiCheck(MPI_Group_incl(group, static_cast<int>( ranks.size()), ranks.data(), &neighborGroup),
+             "MPI_Group_incl");
+    MPI_Group_free(&group);
+}
+
+// Окно создаётся коллективно по коммуникатору обмена, поэтому все процессы обмениваются
+// одними и теми же матрицами в одном порядке (как и для сообщений).
+template<typename T>
+MPI_Win CExchangeDefinitionsT<T>::rmaWindowFor(CMatrixT<T> &matrix) {
+    if (matrix.SizeX() != gridSizeX || matrix.SizeY() != gridSizeY) {
+        throw CException("exchanged matrices must have the size of the grid");
+    }
+    for (typename vector<pair<const T *, MPI_Win> >::const_iterator window = rmaWindows.begin();
+         window != rmaWindows.end(); ++window) {
+        if (window->first == matrix.Pointer(0, 0)) {
+            return window->second;
+        }
+    }
+    MPI_Info info;
+    MpiCheck(MPI_Info_create(&info), "MPI_Info_create");
+    MpiCheck(MPI_Info_set(info, const_cast<char *>( "no_locks" ), const_cast<char *>( "true" )), "MPI_Info_set");
+    MPI_Win window;
+    const int result = MPI_Win_create(matrix.Pointer(0, 0), static_cast<MPI_Aint>( gridSizeX * gridSizeY * sizeof(T) ),
+                                      sizeof(T), info, rmaComm, &window);
+    MPI_Info_free(&info);
+    MpiCheck(result, "MPI_Win_create");
+    rmaWindows.push_back(make_pair(static_cast<const T *>( matrix.Pointer(0, 0)), window));
+    return window;
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::startRma(CMatrixT<T> &matrix) {
+    if (rmaComm == MPI_COMM_NULL) {
+        return;
+    }
+    startedRma = rmaWindowFor(matrix);
+    // "Заезд" открыт соседям, пока не закончится Finish; свои полосы уходят сразу.
+    MpiCheck(MPI_Win_post(neighborGroup, 0, startedRma), "MPI_Win_post");
+    MpiCheck(MPI_Win_start(neighborGroup, 0, startedRma), "MPI_Win_start");
+    for (size_t i = 0; i < this->size(); i++) {
+        MpiCheck(MPI_Put(matrix.Pointer(0, 0), 1, types[2 * i], static_cast<int>( (*this)[i].Rank()), 0, 1,
+                         types[2 * i + 1], startedRma), "MPI_Put");
+    }
+}
+
+template<typename T>
+void CExchangeDefinitionsT<T>::finishRma() {
+    if (rmaComm == MPI_COMM_NULL) {
+        return;
+    }
+    assert(startedRma != MPI_WIN_NULL);
+    MpiCheck(MPI_Win_complete(startedRma), "MPI_Win_complete"); // свои полосы доставлены
+    MpiCheck(MPI_Win_wait(startedRma), "MPI_Win_wait"); // полосы всех соседей в "заезде"
+    startedRma = MPI_WIN_NULL;
+}
+
+template class CExchangeDefinitionT<double>;
+template class CExchangeDefinitionT<float>;
+template class CExchangeDefinitionsT<double>;
+template class CExchangeDefinitionsT<float>;
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,156 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Обмены матрицами CMatrixT<T>: T - NumericType или float (смешанная точность).
+// Определения - в Exchange.cpp, там же явно инстанцированы double и float.
+
+template<typename T>
+class CExchangeDefinitionT { // описание одного обмена
+public:
+	CExchangeDefinitionT( size_t rank, // ранк того, кому посылаем. откуда == текущий процесс
+			const CMatrixPart& sendPart, // отправляемая часть матрицы
+			const CMatrixPart& recvPart, // получаемая часть матрицы
+			MPI_Comm comm = MPI_COMM_WORLD ) : // коммуникатор, в котором задан rank
+		rank( rank ),
+		comm( comm ),
+		sendPart( sendPart ),
+		recvPart( recvPart )
+	{
+		sendBuffer.reserve( sendPart.Size() ); // вектор-переменная для обмена
+		recvBuffer.reserve( recvPart.Size() ); // вектор-переменная для обмена
+	}
+
+	size_t Rank() const { return rank; } // getter
+	MPI_Comm Comm() const { return comm; } // getter
+	const CMatrixPart& SendPart() const { return sendPart; } // getter
+	const CMatrixPart& RecvPart() const { return recvPart; } // getter
+
+	void DoExchange( CMatrixT<T>& matrix ); // асинхронный обмен
+	void Wait( CMatrixT<T>& matrix ); // дождаться обмена
+
+private:
+	size_t rank;
+	MPI_Comm comm;
+
+	CMatrixPart sendPart; // отправляемая часть матрицы
+	MPI_Request sendRequest;
+	vector<T> sendBuffer; // вектор-переменная для обмена/ данные запроса на отправку данных в другой процесс
+
+	CMatrixPart recvPart; // получаемая часть матрицы
+	MPI_Request recvRequest; // данные запроса на отправку данных в другой процесс
+	vector<T> recvBuffer; // вектор-переменная для обмена/ данные запроса на получения данных в другой процесс
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+class CExchangeDefinitionsT : public vector<CExchangeDefinitionT<T> > { // список обменов
+private:
+	CExchangeDefinitionsT( const CExchangeDefinitionsT& );
+	CExchangeDefinitionsT& operator=( const CExchangeDefinitionsT& );
+
+public:
+	typedef CExchangeDefinitionT<T> CDefinition;
+
+	CExchangeDefinitionsT() :
+		mode( EM_Buffered ),
+		typesSizeX( 0 ),
+		typesSizeY( 0 ),
+		started( 0 ),
+		gridSizeX( 0 ),
+		gridSizeY( 0 ),
+		startedShared( 0 ),
+		rmaComm( MPI_COMM_NULL ),
+		neighborGroup( MPI_GROUP_NULL ),
+		startedRma( MPI_WIN_NULL )
+	{
+	}
+	~CExchangeDefinitionsT();
+
+	// Обмен полосами шириной в узел с соседями блока grid по решётке процессов:
+	// отправляются крайние внутренние строки и столбцы, принимается "заезд" (ранк < 0 - соседа нет).
+	void InitHalo( const CUniformGrid& grid, int left, int right, int top, int bottom, MPI_Comm comm );
+	// "Заезд" шириной width узлов: отправляются width крайних своих строк и столбцов. Углы "заезда"
+	// приходят прямо от соседей по диагонали (topLeft, topRight, bottomLeft, bottomRight, < 0 - углов нет),
+	// поэтому шаблон можно применить width раз подряд без обмена. Свои узлы соседей - не меньше width.
+	void InitHalo( const CUniformGrid& grid, size_t width, int left, int right, int top, int bottom,
+		int topLeft, int topRight, int bottomLeft, int bottomRight, MPI_Comm comm );
+
+	// Способ обмена; менять до InitHalo.
+	void SetMode( TExchangeMode value ) { mode = value; }
+	TExchangeMode Mode() const { return mode; }
+
+	// Начать обмен: отправить свои полосы и ждать чужие, не блокируясь.
+	// Пока обмен не закончен, matrix можно только читать, "заезд" ещё не обновлён.
+	void Start( CMatrixT<T>& matrix );
+	// Дождаться окончания обмена, начатого Start.
+	void Finish( CMatrixT<T>& matrix );
+
+	void Exchange( CMatrixT<T>& matrix ) // процедуа выполнения обмена
+	{
+		Start( matrix );
+		Finish( matrix );
+	}
+
+private:
+	TExchangeMode mode;
+	// EM_Datatype: типы полос над хранилищем CMatrix - для каждого обмена отправка и приём.
+	// Все матрицы, которыми обмениваются, одного размера, поэтому типы общие.
+	vector<MPI_Datatype> types;
+	size_t typesSizeX;
+	size_t typesSizeY;
+	// Постоянные запросы (отправка, приём для каждого обмена), привязанные к адресу данных матрицы.
+	map<const T*, vector<MPI_Request> > persistentRequests;
+	vector<MPI_Request>* started; // запросы, запущенные Start
+	size_t gridSizeX; // размер матриц, которыми обмениваются
+	size_t gridSizeY;
+	// EM_Shared и EM_Rma: полосы соседа в координатах его матрицы, для каждого обмена (сообщает InitHalo).
+	struct CNeighborGeometry {
+		CMatrixPart SendPart; // что сосед отдаёт этому процессу
+		CMatrixPart RecvPart; // куда сосед принимает значения этого процесса
+		size_t SizeX; // размер матрицы соседа
+		size_t SizeY;
+	};
+	vector<CNeighborGeometry> neighbors;
+	// EM_Shared: обмены с соседями по узлу идут через окна общей памяти (SharedMemory.h).
+	// Start - барьер памяти и сигнал "полосы готовы" каждому соседу по узлу, Finish - чтение полос
+	// соседей из их сегментов и сигнал "прочитано": до него сосед не меняет свои полосы.
+	// Сигналы - сообщения нулевой длины в коммуникаторе обмена.
+	struct CSharedView { // матрица в окне и начала матриц соседей по узлу
+		MPI_Win Window;
+		vector<const T*> Neighbors; // для каждого обмена, 0 - сосед на другом узле
+	};
+	vector<int> nodeRanks; // ранк соседа в CSharedMemory::NodeComm, MPI_UNDEFINED - другой узел или нет окон
+	map<const T*, CSharedView> sharedViews; // по адресу данных матрицы (начало сегмента)
+	CSharedView* startedShared; // окно обмена, начатого Start
+	vector<MPI_Request> signals;
+	// EM_Rma: окно MPI_Win_create над каждой матрицей; соседи кладут свои полосы в её "заезд" MPI_Put.
+	// Эпохи доступа и открытия - MPI_Win_start/complete и MPI_Win_post/wait только с группой соседей.
+	// В types - для каждого обмена тип своей полосы и тип "заезда" соседа в его матрице.
+	MPI_Comm rmaComm; // MPI_COMM_NULL - соседей нет, обменов нет
+	MPI_Group neighborGroup;
+	vector<pair<const T*, MPI_Win> > rmaWindows; // в порядке создания: MPI_Win_free коллективен
+	MPI_Win startedRma; // окно обмена, начатого Start
+
+	size_t haloSize() const; // сколько значений отправляется и принимается за обмен
+
+	void createTypes( const CMatrixT<T>& matrix );
+	vector<MPI_Request>& requestsFor( CMatrixT<T>& matrix );
+	void initGeometry( MPI_Comm comm ); // neighbors
+	void initShared( MPI_Comm comm ); // соседи по узлу
+	void initRma( MPI_Comm comm ); // группа соседей и типы полос
+	CSharedView& sharedViewFor( CMatrixT<T>& matrix ); // переносит матрицу в окно при первом обмене
+	void signalShared( int tag ); // сигнал нулевой длины каждому соседу по узлу и от каждого
+	void startShared( CMatrixT<T>& matrix );
+	void finishShared( CMatrixT<T>& matrix );
+	MPI_Win rmaWindowFor( CMatrixT<T>& matrix ); // создаёт окно при первом обмене матрицей
+	void startRma( CMatrixT<T>& matrix );
+	void finishRma();
+};
+
+typedef CExchangeDefinitionT<NumericType> CExchangeDefinition;
+typedef CExchangeDefinitionsT<NumericType> CExchangeDefinitions;
+typedef CExchangeDefinitionsT<float> CFloatExchangeDefinitions;
+
+///////////////////////////////////////////////////////////////////////////////
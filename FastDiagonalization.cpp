@@ -0,0 +1,471 @@
+#include <Std.h>
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <Errors.h>
+#include <Options.h>
+#include <Profiler.h>
+#include <FastDiagonalization.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Собственные значения симметричной трёхдиагональной матрицы неявным QL-алгоритмом со сдвигом Уилкинсона.
+// diagonal - диагональ (на выходе - собственные значения), offDiagonal[k] связывает k и k + 1 (портится).
+static void TridiagonalEigenvalues(vector<NumericType> &diagonal, vector<NumericType> &offDiagonal) {
+    const size_t n = diagonal.size();
+    vector<NumericType> &d = diagonal;
+    vector<NumericType> &e = offDiagonal;
+    e.resize(n, 0);
+    e[n - 1] = 0;
+    for (size_t l = 0; l < n; l++) {
+        size_t iterations = 0;
+        size_t m;
+        do {
+            for (m = l; m + 1 < n; m++) { // ищем пренебрежимо малый внедиагональный элемент
+                const NumericType scale = fabs(d[m]) + fabs(d[m + 1]);
+                if (fabs(e[m]) <= numeric_limits<NumericType>::epsilon() * scale) {
+                    break;
+                }
+            }
+            if (m == l) {
+                break;
+            }
+            if (++iterations > 60) {
+                throw CException("FastDiagonalization: QL iterations do not converge");
+            }
+            NumericType g = (d[l + 1] - d[l]) / (2 * e[l]);
+            NumericType r = hypot(g, static_cast<NumericType>( 1 ));
+            g = d[m] - d[l] + e[l] / (g + (g >= 0 ? r : -r));
+            NumericType s = 1;
+            NumericType c = 1;
+            NumericType p = 0;
+            bool underflow = false;
+            for (size_t i = m; i-- > l;) {
+                const NumericType f = s * e[i];
+                const NumericType b = c * e[i];
+                r = hypot(f, g);
+                e[i + 1] = r;
+                if (r == 0) { // исчезновение порядка: матрица распалась
+                    d[i + 1] -= p;
+                    e[m] = 0;
+                    underflow = true;
+                    break;
+                }
+                s = f / r;
+                c = g / r;
+                g = d[i + 1] - p;
+                r = (d[i] - g) * s + 2 * c * b;
+                p = s * r;
+                d[i + 1] = g + p;
+                g = c * r - b;
+            }
+            if (underflow) {
+                continue;
+            }
+            d[l] -= p;
+            e[l] = g;
+            e[m] = 0;
+        } while (m != l);
+    }
+}
+
+// Собственный вектор симметричной трёхдиагональной матрицы для собственного значения lambda
+// обратными итерациями: решения ( T - lambda I ) x = v с выбором главного элемента (как LAPACK dgttrf).
+// Значения оси разделены, поэтому векторы ортогональны с точностью eps ||T|| / зазор.
+static void TridiagonalEigenvector(const vector<NumericType> &diagonal, const vector<NumericType> &offDiagonal,
+                                   NumericType lambda, NumericType tiny, size_t seed, NumericType *result) {
+    const size_t n = diagonal.size();
+    vector<NumericType> d(n); // U: диагональ и две наддиагонали
+    vector<NumericType> du(n, 0);
+    vector<NumericType> du2(n, 0);
+    vector<NumericType> dl(n, 0); // множители L
+    vector<bool> swapped(n, false);
+    for (size_t i = 0; i < n; i++) {
+        d[i] = diagonal[i] - lambda;
+    }
+    for (size_t i = 0; i + 1 < n; i++) {
+        du[i] = offDiagonal[i];
+        dl[i] = offDiagonal[i];
+    }
+    for (size_t i = 0; i + 1 < n; i++) {
+        if (fabs(d[i]) >= fabs(dl[i])) {
+            if (fabs(d[i]) < tiny) {
+                d[i] = (d[i] >= 0) ? tiny : -tiny;
+            }
+            const NumericType factor = dl[i] / d[i];
+            dl[i] = factor;
+            d[i + 1] -= factor * du[i];
+        } else { // меняем строки i и i + 1
+            const NumericType factor = d[i] / dl[i];
+            d[i] = dl[i];
+            dl[i] = factor;
+            const NumericType next = du[i];
+            du[i] = d[i + 1];
+            d[i + 1] = next - factor * d[i + 1];
+            if (i + 2 < n) {
+                du2[i] = du[i + 1];
+                du[i + 1] = -factor * du[i + 1];
+            }
+            swapped[i] = true;
+        }
+    }
+    if (fabs(d[n - 1]) < tiny) {
+        d[n - 1] = (d[n - 1] >= 0) ? tiny : -tiny;
+    }
+
+    for (size_t i = 0; i < n; i++) { // начальный вектор не должен быть ортогонален искомому
+        result[i] = 1 + static_cast<NumericType>( 0.5 ) * sin(static_cast<NumericType>( i * 7 + seed ));
+    }
+    for (size_t iteration = 0; iteration < 3; iteration++) {
+        for (size_t i = 0; i + 1 < n; i++) {
+            if (swapped[i]) {
+                const NumericType value = result[i];
+                result[i] = result[i + 1];
+                result[i + 1] = value - dl[i] * result[i];
+            } else {
+                result[i + 1] -= dl[i] * result[i];
+            }
+        }
+        for (size_t i = n; i-- > 0;) {
+            NumericType value = result[i];
+            if (i + 1 < n) {
+                value -= du[i] * result[i + 1];
+            }
+            if (i + 2 < n) {
+                value -= du2[i] * result[i + 2];
+            }
+            result[i] = value / d[i];
+        }
+        NumericType norm = 0;
+        for (size_t i = 0; i < n; i++) {
+            norm += result[i] * result[i];
+        }
+        norm = sqrt(norm);
+        for (size_t i = 0; i < n; i++) {
+            result[i] /= norm;
+        }
+    }
+}
+
+// Сколько собственных значений симметричной трёхдиагональной матрицы меньше x (последовательность Штурма:
+// число отрицательных ведущих элементов LDL^T разложения T - x I).
+static size_t TridiagonalEigenvaluesBelow(const vector<NumericType> &diagonal, const vector<NumericType> &offDiagonal,
+                                          NumericType x, NumericType tiny) {
+    size_t count = 0;
+    NumericType pivot = 1;
+    for (size_t k = 0; k < diagonal.size(); k++) {
+        pivot = diagonal[k] - x - ((k > 0) ? offDiagonal[k - 1] * offDiagonal[k - 1] / pivot : 0);
+        if (fabs(pivot) < tiny) {
+            pivot = -tiny; // x совпал с собственным значением ведущей подматрицы: сдвигаем его вниз
+        }
+        if (pivot < 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// T = M^1/2 L M^-1/2 оси с узлами points - симметричная трёхдиагональная (offDiagonal[k] связывает k и k + 1),
+// L = M^-1/2 W Lambda W^T M^1/2. volumeRoots - корни M, возвращается оценка нормы T.
+static NumericType SymmetricAxis(const vector<NumericType> &points, vector<NumericType> &diagonal,
+                                 vector<NumericType> &offDiagonal, vector<NumericType> &volumeRoots) {
+    if (points.size() < 3) {
+        throw CException("FastDiagonalization: an axis has no inner points");
+    }
+    CUniformPartition axis;
+    axis.PartInit(points, 0, points.size());
+    const size_t n = points.size() - 2;
+    diagonal.assign(n, 0);
+    offDiagonal.assign(n, 0);
+    volumeRoots.assign(n, 0);
+    for (size_t k = 0; k < n; k++) {
+        const size_t i = k + 1;
+        diagonal[k] = axis.WeightCenter(i);
+        volumeRoots[k] = sqrt(axis.AverageStep(i));
+        if (k + 1 < n) {
+            offDiagonal[k] = -axis.StepInverse(i) / sqrt(axis.AverageStep(i) * axis.AverageStep(i + 1));
+        }
+    }
+    NumericType norm = 0;
+    for (size_t k = 0; k < n; k++) {
+        norm = max(norm, fabs(diagonal[k]) + 2 * fabs(offDiagonal[k]));
+    }
+    return norm;
+}
+
+void AxisSpectrumBounds(const vector<NumericType> &points, NumericType &smallest, NumericType &largest) {
+    vector<NumericType> diagonal;
+    vector<NumericType> offDiagonal;
+    vector<NumericType> volumeRoots;
+    const NumericType norm = SymmetricAxis(points, diagonal, offDiagonal, volumeRoots);
+    const size_t n = diagonal.size();
+    const NumericType tiny = numeric_limits<NumericType>::epsilon() * norm;
+    // Круги Гершгорина дают начальный отрезок; бисекция сужает его, не теряя значений за концами.
+    NumericType lower = -norm;
+    NumericType upper = norm;
+    for (size_t k = 0; k < n; k++) {
+        const NumericType radius = fabs(offDiagonal[k]) + ((k > 0) ? fabs(offDiagonal[k - 1]) : 0);
+        lower = (k == 0) ? diagonal[k] - radius : min(lower, diagonal[k] - radius);
+        upper = (k == 0) ? diagonal[k] + radius : max(upper, diagonal[k] + radius);
+    }
+    const NumericType tolerance = 4 * numeric_limits<NumericType>::epsilon() * norm;
+    NumericType low = lower; // все значения >= low
+    NumericType high = upper;
+    while (high - low > tolerance) {
+        const NumericType middle = (low + high) / 2;
+        if (middle <= low || middle >= high) {
+            break;
+        }
+        if (TridiagonalEigenvaluesBelow(diagonal, offDiagonal, middle, tiny) > 0) {
+            high = middle;
+        } else {
+            low = middle;
+        }
+    }
+    smallest = low - tolerance;
+    low = lower;
+    high = upper; // все значения <= high
+    while (high - low > tolerance) {
+        const NumericType middle = (low + high) / 2;
+        if (middle <= low || middle >= high) {
+            break;
+        }
+        if (TridiagonalEigenvaluesBelow(diagonal, offDiagonal, middle, tiny) == n) {
+            high = middle;
+        } else {
+            low = middle;
+        }
+    }
+    largest = high + tolerance;
+}
+
+void CAxisEigen::Init(const vector<NumericType> &points) {
+    vector<NumericType> diagonal;
+    vector<NumericType> offDiagonal;
+    vector<NumericType> volumeRoots;
+    const NumericType norm = SymmetricAxis(points, diagonal, offDiagonal, volumeRoots);
+    Size = diagonal.size();
+    const size_t n = Size;
+
+    Values = diagonal;
+    vector<NumericType> work(offDiagonal);
+    TridiagonalEigenvalues(Values, work);
+    sort(Values.begin(), Values.end());
+
+    Forward.resize(n * n);
+    Backward.resize(n * n);
+    const NumericType tiny = numeric_limits<NumericType>::epsilon() * norm;
+    const long count = static_cast<long>( n );
+#ifndef DIRCH_NO_OPENMP
+#pragma omp parallel
+#endif
+    {
+        vector<NumericType> w(n);
+#ifndef DIRCH_NO_OPENMP
+#pragma omp for schedule( dynamic, 16 )
+#endif
+        for (long j = 0; j < count; j++) {
+            TridiagonalEigenvector(diagonal, offDiagonal, Values[j], tiny, static_cast<size_t>( j ), &w[0]);
+            for (size_t k = 0; k < n; k++) {
+                Forward[k * n + j] = w[k] * volumeRoots[k];
+                Backward[j * n + k] = w[k] / volumeRoots[k];
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// c = a * b, все матрицы плотные по строкам: a - m x k, b - k x n, c - m x n.
+// Блоки b по BlockK x BlockN остаются в кэше, пока через них проходят BlockRows строк a;
+// четыре строки c обновляются одной загрузкой строки b.
+static void Multiply(const NumericType *a, size_t m, size_t k, const NumericType *b, size_t n, NumericType *c) {
+    CPhaseTimer timer(PP_Transform, m * k * n);
+    const size_t BlockRows = 32;
+    const size_t BlockK = 64;
+    const size_t BlockN = 512;
+    const long rowBlocks = static_cast<long>( (m + BlockRows - 1) / BlockRows );
+#ifndef DIRCH_NO_OPENMP
+#pragma omp parallel for schedule( static )
+#endif
+    for (long block = 0; block < rowBlocks; block++) {
+        const size_t beginI = static_cast<size_t>( block ) * BlockRows;
+        const size_t endI = min(beginI + BlockRows, m);
+        fill(c + beginI * n, c + endI * n, static_cast<NumericType>( 0 ));
+        for (size_t beginK = 0; beginK < k; beginK += BlockK) {
+            const size_t endK = min(beginK + BlockK, k);
+            for (size_t beginJ = 0; beginJ < n; beginJ += BlockN) {
+                const size_t endJ = min(beginJ + BlockN, n);
+                size_t i = beginI;
+                for (; i + 4 <= endI; i += 4) {
+                    NumericType *c0 = c + i * n;
+                    NumericType *c1 = c0 + n;
+                    NumericType *c2 = c1 + n;
+                    NumericType *c3 = c2 + n;
+                    for (size_t kk = beginK; kk < endK; kk++) {
+                        const NumericType a0 = a[i * k + kk];
+                        const NumericType a1 = a[(i + 1) * k + kk];
+                        const NumericType a2 = a[(i + 2) * k + kk];
+                        const NumericType a3 = a[(i + 3) * k + kk];
+                        const NumericType *row = b + kk * n;
+                        for (size_t j = beginJ; j < endJ; j++) {
+                            const NumericType value = row[j];
+                            c0[j] += a0 * value;
+                            c1[j] += a1 * value;
+                            c2[j] += a2 * value;
+                            c3[j] += a3 * value;
+                        }
+                    }
+                }
+                for (; i < endI; i++) {
+                    NumericType *ci = c + i * n;
+                    for (size_t kk = beginK; kk < endK; kk++) {
+                        const NumericType ai = a[i * k + kk];
+                        const NumericType *row = b + kk * n;
+                        for (size_t j = beginJ; j < endJ; j++) {
+                            ci[j] += ai * row[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Место узла ( x, y ) в плотном хранении прямоугольника part.
+static size_t Position(const CMatrixPart &part, bool transposed, size_t x, size_t y) {
+    return transposed ? (x - part.BeginX) * part.SizeY() + (y - part.BeginY)
+                      : (y - part.BeginY) * part.SizeX() + (x - part.BeginX);
+}
+
+static NumericType *Data(vector<NumericType> &values) {
+    return values.empty() ? 0 : &values[0];
+}
+
+// Часть [begin, end) из n элементов номер index из parts (как GetBeginEndPoints).
+static void EvenRange(size_t n, size_t parts, size_t index, size_t &begin, size_t &end) {
+    begin = (n / parts) * index + min(index, n % parts);
+    end = begin + n / parts + (index < n % parts ? 1 : 0);
+}
+
+CFastDiagonalization::CFastDiagonalization(const CBlockedAxis &x, const CBlockedAxis &y, size_t rankX, size_t rankY,
+                                           MPI_Comm comm) :
+        comm(comm),
+        rank(rankY * x.Blocks() + rankX),
+        offsetX(x.Begins[rankX] - (rankX > 0 ? 1 : 0)),
+        offsetY(y.Begins[rankY] - (rankY > 0 ? 1 : 0)) {
+    eigenX.Init(x.Points);
+    eigenY.Init(y.Points);
+    const size_t nx = eigenX.Size;
+    const size_t ny = eigenY.Size;
+
+    // Внутренние узлы блока ( bx, by ) - его узлы без "заезда" и без границы области, номера на 1 меньше.
+    const size_t processes = x.Blocks() * y.Blocks();
+    for (size_t by = 0; by < y.Blocks(); by++) {
+        for (size_t bx = 0; bx < x.Blocks(); bx++) {
+            blocks.push_back(Rectangle(max<size_t>(x.Begins[bx], 1) - 1, min(x.Begins[bx + 1], nx + 1) - 1,
+                                       max<size_t>(y.Begins[by], 1) - 1, min(y.Begins[by + 1], ny + 1) - 1));
+        }
+    }
+    for (size_t p = 0; p < processes; p++) {
+        size_t begin;
+        size_t end;
+        EvenRange(ny, processes, p, begin, end);
+        rows.push_back(Rectangle(0, nx, begin, end));
+        EvenRange(nx, processes, p, begin, end);
+        columns.push_back(Rectangle(begin, end, 0, ny));
+    }
+
+    blockValues.resize(blocks[rank].Size());
+    rowValues.resize(rows[rank].Size());
+    columnValues.resize(columns[rank].Size());
+    product.resize(max(rowValues.size(), columnValues.size()));
+}
+
+void CFastDiagonalization::Solve(const CMatrix &r, CMatrix &e) {
+    const CMatrixPart &block = blocks[rank];
+    for (size_t y = block.BeginY; y < block.EndY; y++) {
+        for (size_t x = block.BeginX; x < block.EndX; x++) {
+            blockValues[Position(block, false, x, y)] = r(x + 1 - offsetX, y + 1 - offsetY);
+        }
+    }
+
+    const size_t nx = eigenX.Size;
+    const size_t ny = eigenY.Size;
+    const size_t rowCount = rows[rank].SizeY();
+    const size_t columnCount = columns[rank].SizeX();
+
+    redistribute(blocks, false, blockValues, rows, false, rowValues);
+    Multiply(Data(rowValues), rowCount, nx, Data(eigenX.Forward), nx, Data(product)); // Sx^-1 по x
+    redistribute(rows, false, product, columns, true, columnValues);
+    Multiply(Data(columnValues), columnCount, ny, Data(eigenY.Forward), ny, Data(product)); // Sy^-1 по y
+    const size_t beginX = columns[rank].BeginX;
+    for (size_t i = 0; i < columnCount; i++) {
+        const NumericType lambdaX = eigenX.Values[beginX + i];
+        NumericType *column = &product[i * ny];
+        for (size_t j = 0; j < ny; j++) {
+            column[j] /= lambdaX + eigenY.Values[j];
+        }
+    }
+    Multiply(Data(product), columnCount, ny, Data(eigenY.Backward), ny, Data(columnValues)); // Sy по y
+    redistribute(columns, true, columnValues, rows, false, rowValues);
+    Multiply(Data(rowValues), rowCount, nx, Data(eigenX.Backward), nx, Data(product)); // Sx по x
+    redistribute(rows, false, product, blocks, false, blockValues);
+
+    for (size_t y = block.BeginY; y < block.EndY; y++) {
+        for (size_t x = block.BeginX; x < block.EndX; x++) {
+            e(x + 1 - offsetX, y + 1 - offsetY) = blockValues[Position(block, false, x, y)];
+        }
+    }
+}
+
+void CFastDiagonalization::redistribute(const vector<CMatrixPart> &from, bool fromTransposed,
+                                        const vector<NumericType> &source,
+                                        const vector<CMatrixPart> &to, bool toTransposed,
+                                        vector<NumericType> &target) {
+    CPhaseTimer timer(PP_Transpose, from[rank].Size() + to[rank].Size());
+    const size_t processes = from.size();
+    vector<int> sendCounts(processes);
+    vector<int> sendDisplacements(processes);
+    vector<int> recvCounts(processes);
+    vector<int> recvDisplacements(processes);
+
+    sendBuffer.clear();
+    for (size_t p = 0; p < processes; p++) { // узлы, которые ранк p получает от нас, - по строкам
+        const CMatrixPart part = Intersection(from[rank], to[p]);
+        sendDisplacements[p] = static_cast<int>( sendBuffer.size());
+        for (size_t y = part.BeginY; y < part.EndY; y++) {
+            for (size_t x = part.BeginX; x < part.EndX; x++) {
+                sendBuffer.push_back(source[Position(from[rank], fromTransposed, x, y)]);
+            }
+        }
+        sendCounts[p] = static_cast<int>( part.Size());
+    }
+    size_t received = 0;
+    for (size_t p = 0; p < processes; p++) {
+        recvDisplacements[p] = static_cast<int>( received );
+        recvCounts[p] = static_cast<int>( Intersection(from[p], to[rank]).Size());
+        received += recvCounts[p];
+    }
+    recvBuffer.resize(received);
+
+    MpiCheck(MPI_Alltoallv(Data(sendBuffer), &sendCounts[0], &sendDisplacements[0],
+                           MpiNumericType, Data(recvBuffer), &recvCounts[0],
+                           &recvDisplacements[0], MpiNumericType, comm),
+             "MPI_Alltoallv");
+
+    target.resize(to[rank].Size());
+    const NumericType *value = Data(recvBuffer);
+    for (size_t p = 0; p < processes; p++) {
+        const CMatrixPart part = Intersection(from[p], to[rank]);
+        for (size_t y = part.BeginY; y < part.EndY; y++) {
+            for (size_t x = part.BeginX; x < part.EndX; x++) {
+                target[Position(to[rank], toTransposed, x, y)] = *value++;
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
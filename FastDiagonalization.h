@@ -0,0 +1,71 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Прямой решатель методом быстрой диагонализации. Сетка - прямое произведение осей, поэтому
+// A = Lx (x) I + I (x) Ly, где L - вторая разностная производная по оси. L = M^-1 K, K симметрична,
+// M = diag( AverageStep ), и L = S Lambda S^-1 (обобщённая задача K s = lambda M s).
+// Решение A e = r: e = Sx [ ( Sx^-1 r Sy^-T ) / ( lambdaX_i + lambdaY_j ) ] Sy^T - четыре умножения
+// плотных матриц и одно деление, вместо тысяч итераций, ограниченных памятью.
+// Разложение осей считается один раз, O( n^2 ) на ось; память - 4 n^2 чисел на ось у каждого процесса.
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CAxisEigen { // разложение L = S Lambda S^-1 по внутренним узлам оси
+	size_t Size; // число внутренних узлов n
+	vector<NumericType> Values; // lambda
+	vector<NumericType> Forward; // ( S^-1 )^T, n x n по строкам: строка * Forward = S^-1 строка
+	vector<NumericType> Backward; // S^T: строка * Backward = S строка
+
+	CAxisEigen() : Size( 0 ) {}
+	// Разложение оси с узлами points (собственные значения - QL, векторы - обратными итерациями).
+	void Init( const vector<NumericType>& points );
+};
+
+// Отрезок [smallest, largest], содержащий все собственные значения L оси с узлами points:
+// бисекция по числу значений Штурма, O( n ) на шаг, без разложения. Спектр A - суммы значений осей.
+void AxisSpectrumBounds( const vector<NumericType>& points, NumericType& smallest, NumericType& largest );
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CFastDiagonalization {
+private:
+	CFastDiagonalization( const CFastDiagonalization& );
+	CFastDiagonalization& operator=( const CFastDiagonalization& );
+
+public:
+	// Блоки процессов - как в CMultigrid: ранк блока ( bx, by ) в comm равен by * x.Blocks() + bx.
+	CFastDiagonalization( const CBlockedAxis& x, const CBlockedAxis& y, size_t rankX, size_t rankY,
+		MPI_Comm comm );
+
+	// e = A^-1 r во внутренних точках блока с нулевыми значениями на границе области
+	// (r и e - матрицы блока с "заездом", "заезд" e не заполняется).
+	void Solve( const CMatrix& r, CMatrix& e );
+
+private:
+	MPI_Comm comm;
+	size_t rank;
+	size_t offsetX; // глобальный номер узла (0, 0) блока
+	size_t offsetY;
+	CAxisEigen eigenX;
+	CAxisEigen eigenY;
+	// Раскладки внутренних узлов (номера с нуля) по ранкам: блоки CProgram, полосы строк
+	// (строка по x подряд) и полосы столбцов (хранятся транспонированными: столбец по y подряд).
+	vector<CMatrixPart> blocks;
+	vector<CMatrixPart> rows;
+	vector<CMatrixPart> columns;
+	// Данные текущего ранка в раскладках и промежуточные произведения.
+	vector<NumericType> blockValues;
+	vector<NumericType> rowValues;
+	vector<NumericType> columnValues;
+	vector<NumericType> product;
+	// Буферы MPI_Alltoallv.
+	vector<NumericType> sendBuffer;
+	vector<NumericType> recvBuffer;
+
+	// Перестановка данных из раскладки from в раскладку to (транспонирование полос).
+	void redistribute( const vector<CMatrixPart>& from, bool fromTransposed, const vector<NumericType>& source,
+		const vector<CMatrixPart>& to, bool toTransposed, vector<NumericType>& target );
+};
+
+///////////////////////////////////////////////////////////////////////////////
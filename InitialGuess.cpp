@@ -0,0 +1,170 @@
+#include <Std.h>
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <Errors.h>
+#include <BinaryDump.h>
+#include <InitialGuess.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Клетка [index, index + 1] оси, в которой лежит value, и доля weight пути по ней (0..1).
+static void Locate(const vector<NumericType> &axis, NumericType value, size_t &index, NumericType &weight) {
+    index = 0;
+    weight = 0;
+    if (axis.size() < 2) {
+        return;
+    }
+    index = upper_bound(axis.begin(), axis.end(), value) - axis.begin();
+    index = min(max<size_t>(index, 1), axis.size() - 1) - 1;
+    weight = (value - axis[index]) / (axis[index + 1] - axis[index]);
+    weight = min<NumericType>(max<NumericType>(weight, 0), 1);
+}
+
+NumericType CGridSamples::Interpolate(NumericType x, NumericType y) const {
+    size_t i;
+    size_t j;
+    NumericType wx;
+    NumericType wy;
+    Locate(X, x, i, wx);
+    Locate(Y, y, j, wy);
+    const size_t nextI = min(i + 1, X.size() - 1);
+    const size_t nextJ = min(j + 1, Y.size() - 1);
+    const NumericType *row = &Values[j * X.size()];
+    const NumericType *nextRow = &Values[nextJ * X.size()];
+    return (1 - wy) * ((1 - wx) * row[i] + wx * row[nextI]) + wy * ((1 - wx) * nextRow[i] + wx * nextRow[nextI]);
+}
+
+void CoveringRange(const vector<NumericType> &axis, NumericType from, NumericType to, size_t &begin, size_t &end) {
+    begin = upper_bound(axis.begin(), axis.end(), from) - axis.begin(); // первый узел правее from
+    begin = (begin > 0) ? begin - 1 : 0;
+    end = lower_bound(axis.begin(), axis.end(), to) - axis.begin(); // первый узел не левее to
+    end = min(end + 1, axis.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ReadGridSamples(const string &filename, const CArea &area, MPI_Comm comm, CGridSamples &samples) {
+    MPI_File file;
+    MpiCheck(MPI_File_open(comm, const_cast<char *>( filename.c_str()), MPI_MODE_RDONLY, MPI_INFO_NULL, &file),
+             "MPI_File_open");
+    CBinaryDumpHeader header;
+    MpiCheck(MPI_File_read_at_all(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE),
+             "MPI_File_read_at_all");
+    if (!equal(BinaryDumpMagic, BinaryDumpMagic + sizeof(BinaryDumpMagic), header.Magic)) {
+        throw CException("`" + filename + "` is not a dirch binary dump");
+    }
+    if (header.ValueSize != sizeof(NumericType)) {
+        throw CException("`" + filename + "` was written with another NumericType");
+    }
+    if (header.PointsX == 0 || header.PointsY == 0) {
+        throw CException("`" + filename + "` has no grid points");
+    }
+
+    vector<NumericType> axisX(header.PointsX);
+    vector<NumericType> axisY(header.PointsY);
+    MpiCheck(MPI_File_read_at_all(file, sizeof(header), &axisX[0], static_cast<int>( axisX.size()),
+                                  MpiNumericType, MPI_STATUS_IGNORE), "MPI_File_read_at_all");
+    MpiCheck(MPI_File_read_at_all(file, sizeof(header) + axisX.size() * sizeof(NumericType), &axisY[0],
+                                  static_cast<int>( axisY.size()), MpiNumericType, MPI_STATUS_IGNORE),
+             "MPI_File_read_at_all");
+
+    size_t beginX;
+    size_t endX;
+    size_t beginY;
+    size_t endY;
+    CoveringRange(axisX, area.X0, area.Xn, beginX, endX);
+    CoveringRange(axisY, area.Y0, area.Yn, beginY, endY);
+    samples.X.assign(axisX.begin() + beginX, axisX.begin() + endX);
+    samples.Y.assign(axisY.begin() + beginY, axisY.begin() + endY);
+    samples.Values.resize(samples.X.size() * samples.Y.size());
+
+    int sizes[2] = {static_cast<int>( axisY.size()), static_cast<int>( axisX.size())};
+    int subsizes[2] = {static_cast<int>( samples.Y.size()), static_cast<int>( samples.X.size())};
+    int starts[2] = {static_cast<int>( beginY ), static_cast<int>( beginX )};
+    MPI_Datatype fileType;
+    MpiCheck(MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MpiNumericType, &fileType),
+             "MPI_Type_create_subarray");
+    MpiCheck(MPI_Type_commit(&fileType), "MPI_Type_commit");
+    MpiCheck(MPI_File_set_view(file, static_cast<MPI_Offset>( header.ValueOffset(0, 0)), MpiNumericType, fileType,
+                               const_cast<char *>( "native" ), MPI_INFO_NULL), "MPI_File_set_view");
+    MpiCheck(MPI_File_read_at_all(file, 0, &samples.Values[0], static_cast<int>( samples.Values.size()),
+                                  MpiNumericType, MPI_STATUS_IGNORE), "MPI_File_read_at_all");
+    MPI_Type_free(&fileType);
+    MpiCheck(MPI_File_close(&file), "MPI_File_close");
+}
+
+void GatherGridSamples(const CMatrix &matrix, const CBlockedAxis &x, const CBlockedAxis &y,
+                       size_t rankX, size_t rankY, MPI_Comm comm, const CArea &area, CGridSamples &samples,
+                       size_t halo) {
+    const size_t processes = x.Blocks() * y.Blocks();
+    const size_t rank = rankY * x.Blocks() + rankX;
+
+    // Нужные прямоугольники всех процессов (в номерах узлов всей сетки).
+    unsigned long need[4];
+    {
+        size_t beginX;
+        size_t endX;
+        size_t beginY;
+        size_t endY;
+        CoveringRange(x.Points, area.X0, area.Xn, beginX, endX);
+        CoveringRange(y.Points, area.Y0, area.Yn, beginY, endY);
+        need[0] = beginX;
+        need[1] = endX;
+        need[2] = beginY;
+        need[3] = endY;
+    }
+    vector<unsigned long> needs(4 * processes);
+    MpiCheck(MPI_Allgather(need, 4, MPI_UNSIGNED_LONG, &needs[0], 4, MPI_UNSIGNED_LONG, comm), "MPI_Allgather");
+    vector<CMatrixPart> needed(processes);
+    vector<CMatrixPart> owned(processes);
+    for (size_t p = 0; p < processes; p++) {
+        const size_t bx = p % x.Blocks();
+        const size_t by = p / x.Blocks();
+        needed[p] = Rectangle(needs[4 * p], needs[4 * p + 1], needs[4 * p + 2], needs[4 * p + 3]);
+        owned[p] = Rectangle(x.Begins[bx], x.Begins[bx + 1], y.Begins[by], y.Begins[by + 1]);
+    }
+
+    // Узел ( gx, gy ) всей сетки в matrix - со сдвигом на "заезд".
+    const size_t offsetX = x.Begins[rankX] - (rankX > 0 ? halo : 0);
+    const size_t offsetY = y.Begins[rankY] - (rankY > 0 ? halo : 0);
+    vector<int> sendCounts(processes);
+    vector<int> sendDisplacements(processes);
+    vector<int> recvCounts(processes);
+    vector<int> recvDisplacements(processes);
+    vector<NumericType> sendBuffer;
+    for (size_t p = 0; p < processes; p++) {
+        const CMatrixPart part = Intersection(owned[rank], needed[p]);
+        sendDisplacements[p] = static_cast<int>( sendBuffer.size());
+        for (size_t gy = part.BeginY; gy < part.EndY; gy++) {
+            const NumericType *row = matrix.Pointer(part.BeginX - offsetX, gy - offsetY);
+            sendBuffer.insert(sendBuffer.end(), row, row + part.SizeX());
+        }
+        sendCounts[p] = static_cast<int>( part.Size());
+    }
+    size_t received = 0;
+    for (size_t p = 0; p < processes; p++) {
+        recvDisplacements[p] = static_cast<int>( received );
+        recvCounts[p] = static_cast<int>( Intersection(owned[p], needed[rank]).Size());
+        received += recvCounts[p];
+    }
+    vector<NumericType> recvBuffer(received);
+    MpiCheck(MPI_Alltoallv(sendBuffer.empty() ? 0 : &sendBuffer[0], &sendCounts[0], &sendDisplacements[0],
+                           MpiNumericType, recvBuffer.empty() ? 0 : &recvBuffer[0], &recvCounts[0],
+                           &recvDisplacements[0], MpiNumericType, comm), "MPI_Alltoallv");
+
+    const CMatrixPart &mine = needed[rank];
+    samples.X.assign(x.Points.begin() + mine.BeginX, x.Points.begin() + mine.EndX);
+    samples.Y.assign(y.Points.begin() + mine.BeginY, y.Points.begin() + mine.EndY);
+    samples.Values.resize(mine.Size());
+    const NumericType *value = recvBuffer.empty() ? 0 : &recvBuffer[0];
+    for (size_t p = 0; p < processes; p++) {
+        const CMatrixPart part = Intersection(owned[p], mine);
+        for (size_t gy = part.BeginY; gy < part.EndY; gy++, value += part.SizeX()) {
+            copy(value, value + part.SizeX(),
+                 &samples.Values[(gy - mine.BeginY) * mine.SizeX() + part.BeginX - mine.BeginX]);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
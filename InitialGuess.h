@@ -0,0 +1,37 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Начальное приближение по решению на другой сетке той же области: из файла результата (BinaryDump.h)
+// или с грубой сетки, решённой перед основной (вложенные итерации). Каждый процесс получает только
+// узлы той сетки, которые окружают его блок, и интерполирует их в узлы своего CUniformGrid.
+
+struct CGridSamples { // значения в узлах прямоугольника другой сетки
+	vector<NumericType> X; // узлы прямоугольника по осям
+	vector<NumericType> Y;
+	vector<NumericType> Values; // Y.size() x X.size(), x - подряд
+
+	// Билинейная интерполяция; за краем прямоугольника - по крайней клетке.
+	NumericType Interpolate( NumericType x, NumericType y ) const;
+};
+
+// Узлы [begin, end) возрастающей оси axis, крайние из которых охватывают отрезок [from, to]
+// (или доходят до конца оси).
+void CoveringRange( const vector<NumericType>& axis, NumericType from, NumericType to,
+	size_t& begin, size_t& end );
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef MPI_VERSION
+// Прочитать из файла результата узлы, охватывающие прямоугольник area. Коллективный вызов comm:
+// оси читают все процессы, значения - каждый свой прямоугольник через MPI_File_read_at_all.
+void ReadGridSamples( const string& filename, const CArea& area, MPI_Comm comm, CGridSamples& samples );
+
+// Собрать узлы, охватывающие прямоугольник area, из блоков matrix (без "заезда" ширины halo) процессов comm.
+// Блоки - как в CMultigrid: ранк блока ( bx, by ) в comm равен by * x.Blocks() + bx.
+// Прямоугольник у каждого процесса свой; пересылаются только нужные узлы (MPI_Alltoallv).
+void GatherGridSamples( const CMatrix& matrix, const CBlockedAxis& x, const CBlockedAxis& y,
+	size_t rankX, size_t rankY, MPI_Comm comm, const CArea& area, CGridSamples& samples, size_t halo = 1 );
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
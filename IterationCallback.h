@@ -12,6 +12,9 @@ public:
 
 	// Нужно звать после выполнения итерации. проставляет значения diff и логгирует шаг
 	virtual void EndIteration( const NumericType difference ) = 0;
+
+	// Продолжение с контрольной точки: iteration итераций уже выполнено, последняя дала difference.
+	virtual void Resume( size_t iteration, const NumericType difference ) = 0;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -32,6 +35,10 @@ public:
 	{
 		difference = _difference;
 	}
+	virtual void Resume( size_t, const NumericType _difference )
+	{
+		difference = _difference;
+	}
 
 private:
 	const NumericType eps;
@@ -68,11 +75,17 @@ public:
 	{
 		CSimpleIterationCallback::EndIteration( diff );
 
-		cout << "(" << id << ") Iteratition #" << iteration << " finished "
+		out << "(" << id << ") Iteratition #" << iteration << " finished "
 			<< "with difference `" << diff << "`." << endl;
 		iteration++;
 	}
 
+	virtual void Resume( size_t _iteration, const NumericType diff )
+	{
+		CSimpleIterationCallback::Resume( _iteration, diff );
+		iteration = _iteration;
+	}
+
 private:
 	ostream& out;
 	const size_t id;
@@ -0,0 +1,122 @@
+#include <Std.h>
+#include <string.h>
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <Errors.h>
+#include <Options.h>
+#include <IterationCallback.h>
+#include <IterationLog.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+CLoggingIterationCallback::CLoggingIterationCallback(ostream &outputStream, size_t id, size_t every,
+                                                     double seconds, const NumericType eps) :
+        CSimpleIterationCallback(eps),
+        out(outputStream),
+        id(id),
+        every(every),
+        seconds(seconds),
+        startTime(MPI_Wtime()),
+        lastReportTime(startTime),
+        iteration(0),
+        lastReported(true),
+        stopping(false) {
+    history.reserve(1024);
+    writer = std::thread(&CLoggingIterationCallback::drain, this);
+}
+
+CLoggingIterationCallback::~CLoggingIterationCallback() {
+    Finish();
+}
+
+void CLoggingIterationCallback::EndIteration(const NumericType difference) {
+    CSimpleIterationCallback::EndIteration(difference);
+    const double now = MPI_Wtime();
+    const CConvergenceRecord record = {iteration, static_cast<double>( difference ), now - startTime};
+    history.push_back(record);
+    lastReported = false;
+    if ((every > 0 && iteration % every == 0) || (seconds > 0 && now - lastReportTime >= seconds)) {
+        report(record);
+        lastReportTime = now;
+    }
+    iteration++;
+}
+
+void CLoggingIterationCallback::Resume(size_t _iteration, const NumericType difference) {
+    CSimpleIterationCallback::Resume(_iteration, difference);
+    iteration = _iteration;
+}
+
+void CLoggingIterationCallback::Finish() {
+    if (!writer.joinable()) {
+        return;
+    }
+    if (!lastReported && !history.empty()) {
+        report(history.back());
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    writer.join();
+}
+
+void CLoggingIterationCallback::report(const CConvergenceRecord &record) {
+    char line[128];
+    snprintf(line, sizeof(line), "(%lu) Iteration #%lu finished with difference `%g` at %.3f s.\n",
+             static_cast<unsigned long>( id ), static_cast<unsigned long>( record.Iteration ), record.Difference,
+             record.Seconds);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending += line;
+    }
+    wakeUp.notify_one();
+    lastReported = true;
+}
+
+void CLoggingIterationCallback::drain() {
+    string lines;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wakeUp.wait(lock, [this] { return stopping || !pending.empty(); });
+        lines.swap(pending);
+        const bool last = stopping;
+        lock.unlock();
+        out << lines << flush; // один сброс на пачку строк, без блокировки буфера
+        lines.clear();
+        lock.lock();
+        if (last && pending.empty()) {
+            return;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CLoggingIterationCallback::WriteHistory(const string &filename, THistoryFormat format) const {
+    ofstream file(filename.c_str(), (format == HF_Binary) ? ios::out | ios::binary : ios::out);
+    if (!file) {
+        throw CException("cannot open `" + filename + "`");
+    }
+    if (format == HF_Binary) {
+        CHistoryHeader header;
+        memcpy(header.Magic, HistoryMagic, sizeof(header.Magic));
+        header.Count = history.size();
+        file.write(reinterpret_cast<const char *>( &header ), sizeof(header));
+        if (!history.empty()) {
+            file.write(reinterpret_cast<const char *>( &history[0] ), history.size() * sizeof(CConvergenceRecord));
+        }
+    } else {
+        file << "iteration,difference,seconds\n";
+        file.precision(10);
+        for (size_t i = 0; i < history.size(); i++) {
+            file << history[i].Iteration << ',' << history[i].Difference << ',' << history[i].Seconds << '\n';
+        }
+    }
+    if (!file.flush()) {
+        throw CException("cannot write `" + filename + "`");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// История сходимости (--history): по записи на итерацию - номер, изменение решения и время
+// от начала решения. Двоичный файл - заголовок, затем Count записей CConvergenceRecord
+// в порядке байт машины; CSV - строки "iteration,difference,seconds".
+
+const char HistoryMagic[8] = { 'D', 'I', 'R', 'C', 'H', 'H', 'S', 'T' };
+
+struct CHistoryHeader {
+	char Magic[8]; // HistoryMagic
+	uint64_t Count;
+};
+
+struct CConvergenceRecord {
+	uint64_t Iteration;
+	double Difference;
+	double Seconds;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Прореженный журнал итераций: строка - раз в every итераций и/или раз в seconds секунд
+// (0 - не используется), без сброса потока на каждой строке. Строки копятся в буфере,
+// в поток out их пишет отдельный поток, так что итерации не ждут вывода. Последняя итерация
+// печатается всегда (в Finish). Поток записи не вызывает MPI.
+class CLoggingIterationCallback : public CSimpleIterationCallback {
+private:
+	CLoggingIterationCallback( const CLoggingIterationCallback& );
+	CLoggingIterationCallback& operator=( const CLoggingIterationCallback& );
+
+public:
+	CLoggingIterationCallback( ostream& outputStream, size_t id, size_t every, double seconds,
+		const NumericType eps = DefaultEps );
+	~CLoggingIterationCallback(); // Finish
+
+	virtual void EndIteration( const NumericType difference );
+	virtual void Resume( size_t iteration, const NumericType difference );
+
+	// Напечатать последнюю итерацию, дописать буфер и остановить поток записи.
+	// После Finish в out можно писать из вызывающего потока.
+	void Finish();
+
+	// Записать историю сходимости в filename. Бросает CException, если файл не открылся.
+	void WriteHistory( const string& filename, THistoryFormat format ) const;
+
+private:
+	ostream& out;
+	const size_t id;
+	const size_t every;
+	const double seconds;
+	double startTime;
+	double lastReportTime;
+	size_t iteration; // номер текущей (следующей завершённой) итерации
+	bool lastReported; // напечатана ли последняя завершённая итерация
+	vector<CConvergenceRecord> history;
+	// Буфер строк и поток записи.
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	string pending;
+	bool stopping;
+	std::thread writer;
+
+	void report( const CConvergenceRecord& record );
+	void drain(); // тело потока записи
+};
+
+///////////////////////////////////////////////////////////////////////////////
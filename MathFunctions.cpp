@@ -1,116 +1,596 @@
 #include <Std.h>
 #include <Definitions.h>
+#include <Problem.h>
 #include <MathFunctions.h>
+#include <StencilEngine.h>
+#include <Options.h>
+#include <SimdKernels.h>
+#include <Profiler.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
-NumericType LaplasOperator(const CMatrix &matrix, const CUniformGrid &grid, size_t x, size_t y) {
-    const NumericType ldx = (matrix(x, y) - matrix(x - 1, y)) / grid.X.Step(x - 1); // производные численные
-    const NumericType rdx = (matrix(x + 1, y) - matrix(x, y)) / grid.X.Step(x);
-    const NumericType tdy = (matrix(x, y) - matrix(x, y - 1)) / grid.Y.Step(y - 1);
-    const NumericType bdy = (matrix(x, y + 1) - matrix(x, y)) / grid.Y.Step(y);
-    const NumericType dx = (ldx - rdx) / grid.X.AverageStep(x); // численные вторые производные
-    const NumericType dy = (tdy - bdy) / grid.Y.AverageStep(y);
-    return (dx + dy);
+template<typename T>
+NumericType LaplasOperator(const CMatrixT<T> &matrix, const CUniformGrid &grid, size_t x, size_t y) {
+    // Численные вторые производные через коэффициенты, посчитанные в PartInit, - без делений.
+    if (grid.Weights.empty()) {
+        return (grid.X.WeightCenter(x) + grid.Y.WeightCenter(y)) * matrix(x, y)
+               - grid.X.WeightPrev(x) * matrix(x - 1, y) - grid.X.WeightNext(x) * matrix(x + 1, y)
+               - grid.Y.WeightPrev(y) * matrix(x, y - 1) - grid.Y.WeightNext(y) * matrix(x, y + 1);
+    }
+    const CStencilWeights &weight = grid.Weight(x, y);
+    return weight.Center * matrix(x, y)
+           - weight.West * matrix(x - 1, y) - weight.East * matrix(x + 1, y)
+           - weight.North * matrix(x, y - 1) - weight.South * matrix(x, y + 1);
 }
 
-// Вычисление невязки rij во внутренних точках.
-void CalcR(const CMatrix &p, const CUniformGrid &grid, CMatrix &r) {
-#ifndef DIRCH_NO_OPENMP
-    // omp_set_num_threads(3); // устанавливаем 3 потока
-#pragma omp parallel for // https://mindhalls.ru/pragma-omp-directives-samples/
-    for (long x = 1; x < r.SizeX() - 1; x++) {
-        // omp_get_thread_num() для того чтобы узнать номер потока
-#else
-        for( size_t x = 1; x < r.SizeX() - 1; x++ ) {
-#endif
-        for (size_t y = 1; y < r.SizeY() - 1; y++) {
-            r(x, y) = LaplasOperator(p, grid, x, y) - F(grid.X[x], grid.Y[y]);
+// Значения правой части на отрезке строки: из таблицы или, при первом проходе, из задачи с записью в таблицу.
+static const NumericType *RightHandSideRow(CRightHandSide &rhs, const CUniformGrid &grid,
+                                           size_t y, size_t beginX, size_t endX) {
+    if (!rhs.IsReady()) {
+        for (size_t x = beginX; x < endX; x++) {
+            rhs(x, y) = rhs.Problem().F(grid.X[x], grid.Y[y]);
         }
     }
+    return rhs.Pointer(beginX, y);
 }
 
-// Вычисление значений gij во внутренних точках.
-void CalcG(const CMatrix &r, const NumericType alpha, CMatrix &g) {
-#ifndef DIRCH_NO_OPENMP
-    // omp_set_num_threads(3); // устанавливаем 3 потока
-#pragma omp parallel for // https://mindhalls.ru/pragma-omp-directives-samples/
-    for (long x = 1; x < g.SizeX() - 1; x++) {
-#else
-        for( size_t x = 1; x < g.SizeX() - 1; x++ ) {
-#endif
-        for (size_t y = 1; y < g.SizeY() - 1; y++) {
+// Отрезок строки для построчных ядер CSimd, начиная с узла (x, y).
+template<typename T>
+static inline CStencilRowT<T> StencilRow(const CMatrixT<T> &matrix, size_t x, size_t y) {
+    const CStencilRowT<T> row = {matrix.Pointer(x, y), matrix.Pointer(x, y - 1), matrix.Pointer(x, y + 1)};
+    return row;
+}
+
+// Построчные ядра для матриц типа T.
+static inline const CRowKernels &RowKernels(const CMatrix &) {
+    return CSimd::Kernels();
+}
+
+static inline const CFloatRowKernels &RowKernels(const CFloatMatrix &) {
+    return CSimd::FloatKernels();
+}
+
+static inline CRowMetrics RowMetrics(const CUniformGrid &grid, size_t x, size_t y) {
+    const CRowMetrics metrics = {grid.X.WeightsPrev() + x, grid.X.WeightsNext() + x, grid.X.AverageSteps() + x,
+                                 grid.Y.WeightPrev(y), grid.Y.WeightNext(y), grid.Y.AverageStep(y)};
+    return metrics;
+}
+
+template NumericType LaplasOperator(const CMatrix &, const CUniformGrid &, size_t, size_t);
+template NumericType LaplasOperator(const CFloatMatrix &, const CUniformGrid &, size_t, size_t);
+
+///////////////////////////////////////////////////////////////////////////////
+// Ядра для RunStencil: каждое обрабатывает отрезок строки, суммы объединяются в Join.
+// Если коэффициенты шаблона берутся по осям, строка обрабатывается векторными ядрами CSimd,
+// с полной таблицей CUniformGrid::Weights - поточечно через LaplasOperator.
+// Ядра-шаблоны работают и с матрицами float: их строки идут через CSimd::FloatKernels()
+// (значения читаются и пишутся во float, арифметика и суммы - в NumericType).
+
+struct CCalcRKernel : public CStencilKernel {
+    const CMatrix &p;
+    const CUniformGrid &grid;
+    CRightHandSide &rhs;
+    CMatrix &r;
+
+    CCalcRKernel(const CMatrix &p, const CUniformGrid &grid, CRightHandSide &rhs, CMatrix &r) :
+            p(p), grid(grid), rhs(rhs), r(r) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        const NumericType *f = RightHandSideRow(rhs, grid, y, beginX, endX);
+        if (grid.Weights.empty()) {
+            CSimd::Kernels().Residual(StencilRow(p, beginX, y), RowMetrics(grid, beginX, y), f,
+                                      endX - beginX, r.Pointer(beginX, y));
+            return;
+        }
+        for (size_t x = beginX; x < endX; x++) {
+            r(x, y) = LaplasOperator(p, grid, x, y) - f[x - beginX];
+        }
+    }
+};
+
+template<typename T>
+struct CCalcGKernel : public CStencilKernel {
+    const CMatrixT<T> &r;
+    const NumericType alpha;
+    CMatrixT<T> &g;
+
+    CCalcGKernel(const CMatrixT<T> &r, NumericType alpha, CMatrixT<T> &g) : r(r), alpha(alpha), g(g) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        RowKernels(g).Direction(r.Pointer(beginX, y), alpha, endX - beginX, g.Pointer(beginX, y));
+    }
+};
+
+template<typename T>
+struct CCalcPKernel {
+    const CMatrixT<T> &g;
+    const NumericType tau;
+    CMatrixT<T> &p;
+    CUpdateNorms Norms; // нормы изменения p
+
+    CCalcPKernel(const CMatrixT<T> &g, NumericType tau, CMatrixT<T> &p) : g(g), tau(tau), p(p) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        NumericType norms[2] = {0, 0};
+        RowKernels(p).Update(g.Pointer(beginX, y), tau, endX - beginX, p.Pointer(beginX, y), norms);
+        Norms.Squares += norms[0];
+        Norms.Max = max(Norms.Max, norms[1]);
+    }
+
+    void Join(const CCalcPKernel &other) { Norms.Add(other.Norms); }
+};
+
+template<typename T>
+struct CCalcAlphaKernel {
+    const CMatrixT<T> &r;
+    const CMatrixT<T> &g;
+    const CUniformGrid &grid;
+    CFraction Alpha;
+
+    CCalcAlphaKernel(const CMatrixT<T> &r, const CMatrixT<T> &g, const CUniformGrid &grid) :
+            r(r), g(g), grid(grid), Alpha(0, 0) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        if (!grid.Weights.empty()) {
+            Points(y, beginX, endX);
+            return;
+        }
+        NumericType sums[2] = {0, 0};
+        RowKernels(g).AlphaSums(StencilRow(r, beginX, y), StencilRow(g, beginX, y),
+                                RowMetrics(grid, beginX, y), endX - beginX, sums);
+        Alpha.Numerator += sums[0];
+        Alpha.Denominator += sums[1];
+    }
+
+    void Points(size_t y, size_t beginX, size_t endX) {
+        for (size_t x = beginX; x < endX; x++) {
+            const NumericType common = g(x, y) * grid.Volume(x, y);
+            Alpha.Numerator += LaplasOperator(r, grid, x, y) * common;
+            Alpha.Denominator += LaplasOperator(g, grid, x, y) * common;
+        }
+    }
+
+    void Join(const CCalcAlphaKernel &other) { Alpha.Add(other.Alpha); }
+};
+
+template<typename T>
+struct CCalcTauKernel {
+    const CMatrixT<T> &r;
+    const CMatrixT<T> &g;
+    const CUniformGrid &grid;
+    CFraction Tau;
+
+    CCalcTauKernel(const CMatrixT<T> &r, const CMatrixT<T> &g, const CUniformGrid &grid) :
+            r(r), g(g), grid(grid), Tau(0, 0) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        if (!grid.Weights.empty()) {
+            Points(y, beginX, endX);
+            return;
+        }
+        NumericType sums[2] = {0, 0};
+        RowKernels(g).TauSums(r.Pointer(beginX, y), StencilRow(g, beginX, y),
+                              RowMetrics(grid, beginX, y), endX - beginX, sums);
+        Tau.Numerator += sums[0];
+        Tau.Denominator += sums[1];
+    }
+
+    void Points(size_t y, size_t beginX, size_t endX) {
+        for (size_t x = beginX; x < endX; x++) {
+            const NumericType common = g(x, y) * grid.Volume(x, y);
+            Tau.Numerator += r(x, y) * common;
+            Tau.Denominator += LaplasOperator(g, grid, x, y) * common;
+        }
+    }
+
+    void Join(const CCalcTauKernel &other) { Tau.Add(other.Tau); }
+};
+
+struct CFusedRKernel {
+    const CMatrix &p;
+    const CMatrix &g;
+    const CMatrix &ag;
+    const NumericType tau;
+    const CUniformGrid &grid;
+    CRightHandSide &rhs;
+    CMatrix &pNext;
+    CMatrix &r;
+    NumericType Numerator; // числитель alpha
+
+    CFusedRKernel(const CMatrix &p, const CMatrix &g, const CMatrix &ag, NumericType tau,
+                  const CUniformGrid &grid, CRightHandSide &rhs, CMatrix &pNext, CMatrix &r) :
+            p(p), g(g), ag(ag), tau(tau), grid(grid), rhs(rhs), pNext(pNext), r(r), Numerator(0) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        const NumericType *f = RightHandSideRow(rhs, grid, y, beginX, endX);
+        if (grid.Weights.empty()) {
+            Numerator += CSimd::Kernels().FusedR(StencilRow(p, beginX, y), g.Pointer(beginX, y),
+                                                 ag.Pointer(beginX, y), tau, RowMetrics(grid, beginX, y), f,
+                                                 endX - beginX, pNext.Pointer(beginX, y), r.Pointer(beginX, y));
+            return;
+        }
+        for (size_t x = beginX; x < endX; x++) {
+            pNext(x, y) = p(x, y) - tau * g(x, y);
+            // A(p - tau * g) = A(p) - tau * Ag, поэтому лапласиан считаем от старого p
+            r(x, y) = LaplasOperator(p, grid, x, y) - tau * ag(x, y) - f[x - beginX];
+            Numerator += r(x, y) * ag(x, y) * grid.Volume(x, y);
+        }
+    }
+
+    void Join(const CFusedRKernel &other) { Numerator += other.Numerator; }
+};
+
+struct CFusedGKernel {
+    const CMatrix &r;
+    const NumericType alpha;
+    const CUniformGrid &grid;
+    CMatrix &g;
+    CMatrix &ag;
+    CFusedSums Sums;
+
+    CFusedGKernel(const CMatrix &r, NumericType alpha, const CUniformGrid &grid, CMatrix &g, CMatrix &ag) :
+            r(r), alpha(alpha), grid(grid), g(g), ag(ag) { Sums.Tau = CFraction(0, 0); }
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        if (grid.Weights.empty()) {
+            NumericType sums[4] = {0, 0, 0, 0};
+            CSimd::Kernels().FusedG(StencilRow(r, beginX, y), alpha, RowMetrics(grid, beginX, y), endX - beginX,
+                                    g.Pointer(beginX, y), ag.Pointer(beginX, y), sums);
+            Sums.Tau.Numerator += sums[0];
+            Sums.Tau.Denominator += sums[1];
+            Sums.G.Squares += sums[2];
+            Sums.G.Max = max(Sums.G.Max, sums[3]);
+            return;
+        }
+        for (size_t x = beginX; x < endX; x++) {
             g(x, y) = r(x, y) - alpha * g(x, y);
+            ag(x, y) = LaplasOperator(r, grid, x, y) - alpha * ag(x, y); // A(r - alpha * g) = Ar - alpha * Ag
+            const NumericType common = g(x, y) * grid.Volume(x, y);
+            Sums.Tau.Numerator += r(x, y) * common;
+            Sums.Tau.Denominator += ag(x, y) * common;
+            Sums.G.Squares += g(x, y) * g(x, y);
+            Sums.G.Max = max(Sums.G.Max, fabs(g(x, y)));
         }
     }
-}
 
-// Вычисление значений pij во внутренних точках, возвращается евклидова норма.
-NumericType CalcP(const CMatrix &g, const NumericType tau, CMatrix &p) {
-    NumericType squares = 0;
-    for (size_t x = 1; x < p.SizeX() - 1; x++) {
-        for (size_t y = 1; y < p.SizeY() - 1; y++) {
-            const NumericType newValue = p(x, y) - tau * g(x, y); // считаем новое значение
-            squares += (newValue - p(x, y)) * (newValue - p(x, y)); // добавляем квадрат разницы компоненты
-            p(x, y) = newValue; // присваиваем новое значение
+    void Join(const CFusedGKernel &other) { Sums.Add(other.Sums); }
+};
+
+struct CApplyKernel : public CStencilKernel {
+    const CMatrix &u;
+    const CUniformGrid &grid;
+    CMatrix &result;
+
+    CApplyKernel(const CMatrix &u, const CUniformGrid &grid, CMatrix &result) : u(u), grid(grid), result(result) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        if (grid.Weights.empty()) {
+            CSimd::Kernels().Apply(StencilRow(u, beginX, y), RowMetrics(grid, beginX, y), endX - beginX,
+                                   result.Pointer(beginX, y));
+            return;
+        }
+        for (size_t x = beginX; x < endX; x++) {
+            result(x, y) = LaplasOperator(u, grid, x, y);
+        }
+    }
+};
+
+struct CPipelinedKernel {
+    const CMatrix &aar;
+    const NumericType alpha;
+    const NumericType beta;
+    const CUniformGrid &grid;
+    CPipelinedVectors &vectors;
+    CPipelinedSums Sums;
+
+    CPipelinedKernel(const CMatrix &aar, NumericType alpha, NumericType beta, const CUniformGrid &grid,
+                     CPipelinedVectors &vectors) :
+            aar(aar), alpha(alpha), beta(beta), grid(grid), vectors(vectors) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        if (grid.Weights.empty()) {
+            const CPipelinedRow row = {vectors.P.Pointer(beginX, y), vectors.R.Pointer(beginX, y),
+                                       vectors.Ar.Pointer(beginX, y), vectors.G.Pointer(beginX, y),
+                                       vectors.Ag.Pointer(beginX, y), vectors.Aag.Pointer(beginX, y),
+                                       aar.Pointer(beginX, y)};
+            NumericType sums[4] = {0, 0, 0, 0};
+            CSimd::Kernels().Pipelined(row, alpha, beta, RowMetrics(grid, beginX, y), endX - beginX, sums);
+            Sums.RR += sums[0];
+            Sums.ArR += sums[1];
+            Sums.G.Squares += sums[2];
+            Sums.G.Max = max(Sums.G.Max, sums[3]);
+            return;
+        }
+        for (size_t x = beginX; x < endX; x++) {
+            vectors.Aag(x, y) = aar(x, y) + beta * vectors.Aag(x, y);
+            vectors.Ag(x, y) = vectors.Ar(x, y) + beta * vectors.Ag(x, y);
+            vectors.G(x, y) = vectors.R(x, y) + beta * vectors.G(x, y);
+            vectors.P(x, y) -= alpha * vectors.G(x, y);
+            vectors.R(x, y) -= alpha * vectors.Ag(x, y);
+            vectors.Ar(x, y) -= alpha * vectors.Aag(x, y);
+            const NumericType common = vectors.R(x, y) * grid.Volume(x, y);
+            Sums.RR += vectors.R(x, y) * common;
+            Sums.ArR += vectors.Ar(x, y) * common;
+            Sums.G.Squares += vectors.G(x, y) * vectors.G(x, y);
+            Sums.G.Max = max(Sums.G.Max, fabs(vectors.G(x, y)));
         }
     }
-    return static_cast<NumericType> (pow(squares, 0.5));
+
+    void Join(const CPipelinedKernel &other) { Sums.Add(other.Sums); }
+};
+
+// Ядра многосеточного метода: правая часть - матрица, а не таблица CRightHandSide.
+
+// Диагональ оператора в узле.
+static inline NumericType Diagonal(const CUniformGrid &grid, size_t x, size_t y) {
+    return grid.Weights.empty() ? grid.X.WeightCenter(x) + grid.Y.WeightCenter(y) : grid.Weight(x, y).Center;
 }
 
-// Вычисление значений pij во внутренних точках, возвращается сумма квадратов.
-NumericType CalcP_2(const CMatrix &g, const NumericType tau, CMatrix &p) {
-    NumericType squares = 0;
-    for (size_t x = 1; x < p.SizeX() - 1; x++) {
-        for (size_t y = 1; y < p.SizeY() - 1; y++) {
-            const NumericType newValue = p(x, y) - tau * g(x, y); // считаем новое значение
-            squares += (newValue - p(x, y)) * (newValue - p(x, y)); // добавляем квадрат разницы компоненты
-            p(x, y) = newValue; // присваиваем новое значение
+template<typename T>
+struct CResidualKernel : public CStencilKernel {
+    const CMatrixT<T> &u;
+    const CMatrixT<T> &f;
+    const CUniformGrid &grid;
+    CMatrixT<T> &r;
+
+    CResidualKernel(const CMatrixT<T> &u, const CMatrixT<T> &f, const CUniformGrid &grid, CMatrixT<T> &r) :
+            u(u), f(f), grid(grid), r(r) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        if (!grid.Weights.empty()) {
+            Points(y, beginX, endX);
+            return;
         }
+        RowKernels(r).Residual(StencilRow(u, beginX, y), RowMetrics(grid, beginX, y), f.Pointer(beginX, y),
+                               endX - beginX, r.Pointer(beginX, y));
     }
-    return static_cast<NumericType> (squares);
+
+    void Points(size_t y, size_t beginX, size_t endX) {
+        for (size_t x = beginX; x < endX; x++) {
+            r(x, y) = static_cast<T>( LaplasOperator(u, grid, x, y) - f(x, y));
+        }
+    }
+};
+
+struct CJacobiKernel : public CResidualKernel<NumericType> {
+    const NumericType omega;
+
+    CJacobiKernel(const CMatrix &u, const CMatrix &f, NumericType omega, const CUniformGrid &grid, CMatrix &result) :
+            CResidualKernel(u, f, grid, result), omega(omega) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        CResidualKernel<NumericType>::Row(y, beginX, endX); // сначала невязка в result
+        for (size_t x = beginX; x < endX; x++) {
+            r(x, y) = u(x, y) - omega * r(x, y) / Diagonal(grid, x, y);
+        }
+    }
+};
+
+struct CRedBlackKernel : public CStencilKernel {
+    CMatrix &u;
+    const CMatrix &f;
+    const CUniformGrid &grid;
+    const size_t color;
+
+    CRedBlackKernel(CMatrix &u, const CMatrix &f, const CUniformGrid &grid, size_t color) :
+            u(u), f(f), grid(grid), color(color) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        // соседи узла - другого цвета, поэтому строки можно обновлять на месте в любом порядке
+        for (size_t x = beginX + (beginX + y + color) % 2; x < endX; x += 2) {
+            u(x, y) -= (LaplasOperator(u, grid, x, y) - f(x, y)) / Diagonal(grid, x, y);
+        }
+    }
+};
+
+struct CDifferenceKernel {
+    const CMatrix &a;
+    const CMatrix &b;
+    CUpdateNorms Norms;
+
+    CDifferenceKernel(const CMatrix &a, const CMatrix &b) : a(a), b(b) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        for (size_t x = beginX; x < endX; x++) {
+            const NumericType difference = a(x, y) - b(x, y);
+            Norms.Squares += difference * difference;
+            Norms.Max = max(Norms.Max, fabs(difference));
+        }
+    }
+
+    void Join(const CDifferenceKernel &other) { Norms.Add(other.Norms); }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Вычисление невязки rij во внутренних точках.
+void CalcR(const CMatrix &p, const CUniformGrid &grid, CRightHandSide &rhs, CMatrix &r) {
+    CalcR(p, grid, rhs, r, InnerPart(r));
+    rhs.SetReady();
+}
+
+// Вычисление невязки rij в точках part, rhs помечает готовой вызывающий.
+void CalcR(const CMatrix &p, const CUniformGrid &grid, CRightHandSide &rhs, CMatrix &r, const CMatrixPart &part) {
+    CPhaseTimer timer(PP_CalcR, part.Size());
+    CCalcRKernel kernel(p, grid, rhs, r);
+    RunStencil(part, kernel);
+}
+
+// Вычисление значений gij во внутренних точках.
+template<typename T>
+void CalcG(const CMatrixT<T> &r, const NumericType alpha, CMatrixT<T> &g) {
+    CalcG(r, alpha, g, InnerPart(g));
+}
+
+template<typename T>
+void CalcG(const CMatrixT<T> &r, const NumericType alpha, CMatrixT<T> &g, const CMatrixPart &part) {
+    CPhaseTimer timer(PP_CalcG, part.Size(), sizeof(T));
+    CCalcGKernel<T> kernel(r, alpha, g);
+    RunStencil(part, kernel);
+}
+
+// Вычисление значений pij во внутренних точках, возвращаются сумма квадратов и максимум изменения.
+template<typename T>
+CUpdateNorms CalcP(const CMatrixT<T> &g, const NumericType tau, CMatrixT<T> &p) {
+    return CalcP(g, tau, p, InnerPart(p));
+}
+
+template<typename T>
+CUpdateNorms CalcP(const CMatrixT<T> &g, const NumericType tau, CMatrixT<T> &p, const CMatrixPart &part) {
+    CPhaseTimer timer(PP_CalcP, part.Size(), sizeof(T));
+    CCalcPKernel<T> kernel(g, tau, p);
+    RunStencil(part, kernel);
+    return kernel.Norms;
 }
 
 // Вычисление alpha.
-CFraction CalcAlpha(const CMatrix &r, const CMatrix &g, const CUniformGrid &grid) {
-    NumericType numerator = 0;
-    NumericType denominator = 0;
-#ifndef DIRCH_NO_OPENMP
-    // omp_set_num_threads(3); // устанавливаем 3 потока
-#pragma omp parallel for reduction( +:numerator, denominator ) // https://habrahabr.ru/company/intel/blog/88574/
-    // суммируем числитель и знаменатель
-    for (long x = 1; x < r.SizeX() - 1; x++) {
-#else
-        for( size_t x = 1; x < r.SizeX() - 1; x++ ) {
-#endif
-        for (size_t y = 1; y < r.SizeY() - 1; y++) {
-            const NumericType common = g(x, y) * grid.X.AverageStep(x) * grid.Y.AverageStep(y);
-            numerator += LaplasOperator(r, grid, x, y) * common;
-            denominator += LaplasOperator(g, grid, x, y) * common;
-        }
-    }
-    return CFraction(numerator, denominator);
+template<typename T>
+CFraction CalcAlpha(const CMatrixT<T> &r, const CMatrixT<T> &g, const CUniformGrid &grid) {
+    return CalcAlpha(r, g, grid, InnerPart(r));
+}
+
+template<typename T>
+CFraction CalcAlpha(const CMatrixT<T> &r, const CMatrixT<T> &g, const CUniformGrid &grid, const CMatrixPart &part) {
+    CPhaseTimer timer(PP_CalcAlpha, part.Size(), sizeof(T));
+    CCalcAlphaKernel<T> kernel(r, g, grid);
+    RunStencil(part, kernel);
+    return kernel.Alpha;
 }
 
 // Вычисление tau.
-CFraction CalcTau(const CMatrix &r, const CMatrix &g, const CUniformGrid &grid) {
-    NumericType numerator = 0;
-    NumericType denominator = 0;
-#ifndef DIRCH_NO_OPENMP
-    // omp_set_num_threads(3); // устанавливаем 3 потока
-#pragma omp parallel for reduction( +:numerator, denominator ) //https://habrahabr.ru/company/intel/blog/88574/
-    // суммируем числитель и знаменатель
-    for (long x = 1; x < r.SizeX() - 1; x++) {
-#else
-        for( size_t x = 1; x < r.SizeX() - 1; x++ ) {
-#endif
-        for (size_t y = 1; y < r.SizeY() - 1; y++) {
-            const NumericType common = g(x, y) * grid.X.AverageStep(x) * grid.Y.AverageStep(y);
-            numerator += r(x, y) * common;
-            denominator += LaplasOperator(g, grid, x, y) * common;
-        }
-    }
-    return CFraction(numerator, denominator);
+template<typename T>
+CFraction CalcTau(const CMatrixT<T> &r, const CMatrixT<T> &g, const CUniformGrid &grid) {
+    return CalcTau(r, g, grid, InnerPart(r));
+}
+
+template<typename T>
+CFraction CalcTau(const CMatrixT<T> &r, const CMatrixT<T> &g, const CUniformGrid &grid, const CMatrixPart &part) {
+    CPhaseTimer timer(PP_CalcTau, part.Size(), sizeof(T));
+    CCalcTauKernel<T> kernel(r, g, grid);
+    RunStencil(part, kernel);
+    return kernel.Tau;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// result = a - k * b на границе матрицы (на глобальной границе g = 0, в "заезде" - данные соседа).
+static void CalcBorderCombination(const CMatrix &a, const NumericType k, const CMatrix &b, CMatrix &result) {
+    const size_t right = result.SizeX() - 1;
+    const size_t bottom = result.SizeY() - 1;
+    for (size_t x = 0; x < result.SizeX(); x++) {
+        result(x, 0) = a(x, 0) - k * b(x, 0);
+        result(x, bottom) = a(x, bottom) - k * b(x, bottom);
+    }
+    for (size_t y = 1; y < bottom; y++) {
+        result(0, y) = a(0, y) - k * b(0, y);
+        result(right, y) = a(right, y) - k * b(right, y);
+    }
+}
+
+// Невязка r = A(u) - f во внутренних точках.
+template<typename T>
+void CalcResidual(const CMatrixT<T> &u, const CMatrixT<T> &f, const CUniformGrid &grid, CMatrixT<T> &r) {
+    CPhaseTimer timer(PP_Residual, InnerPart(r).Size(), sizeof(T));
+    CResidualKernel<T> kernel(u, f, grid, r);
+    RunStencil(InnerPart(r), kernel);
+}
+
+// Результат result = u - omega * (A(u) - f) / D во внутренних точках, на границе - копия u.
+void CalcJacobi(const CMatrix &u, const CMatrix &f, const NumericType omega, const CUniformGrid &grid,
+                CMatrix &result) {
+    CPhaseTimer timer(PP_Jacobi, InnerPart(result).Size());
+    CalcBorderCombination(u, 0, u, result);
+    CJacobiKernel kernel(u, f, omega, grid, result);
+    RunStencil(InnerPart(result), kernel);
+}
+
+// Полуитерация Гаусса - Зейделя по узлам с (x + y) % 2 == color.
+void CalcRedBlack(CMatrix &u, const CMatrix &f, const CUniformGrid &grid, const size_t color) {
+    CPhaseTimer timer(PP_RedBlack, InnerPart(u).Size() / 2);
+    CRedBlackKernel kernel(u, f, grid, color);
+    RunStencil(InnerPart(u), kernel);
+}
+
+// Нормы a - b во внутренних точках.
+CUpdateNorms CalcDifference(const CMatrix &a, const CMatrix &b) {
+    CPhaseTimer timer(PP_Difference, InnerPart(a).Size());
+    CDifferenceKernel kernel(a, b);
+    RunStencil(InnerPart(a), kernel);
+    return kernel.Norms;
+}
+
+// Применение оператора: result = A(u) во внутренних точках.
+void CalcOperator(const CMatrix &u, const CUniformGrid &grid, CMatrix &result) {
+    CalcOperator(u, grid, result, InnerPart(result));
+}
+
+void CalcOperator(const CMatrix &u, const CUniformGrid &grid, CMatrix &result, const CMatrixPart &part) {
+    CPhaseTimer timer(PP_Operator, part.Size());
+    CApplyKernel kernel(u, grid, result);
+    RunStencil(part, kernel);
+}
+
+// Конвейерный метод: обновление всех векторов одним проходом и суммы для следующей итерации.
+CPipelinedSums CalcPipelined(const CMatrix &aar, const NumericType alpha, const NumericType beta,
+                             const CUniformGrid &grid, CPipelinedVectors &vectors) {
+    CPhaseTimer timer(PP_Pipelined, InnerPart(aar).Size());
+    CPipelinedKernel kernel(aar, alpha, beta, grid, vectors);
+    RunStencil(InnerPart(aar), kernel);
+    return kernel.Sums;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Шаблонные проходы: матрицы NumericType и float.
+#define DIRCH_INSTANTIATE_KERNELS( T ) \
+    template void CalcG(const CMatrixT<T> &, const NumericType, CMatrixT<T> &); \
+    template void CalcG(const CMatrixT<T> &, const NumericType, CMatrixT<T> &, const CMatrixPart &); \
+    template CUpdateNorms CalcP(const CMatrixT<T> &, const NumericType, CMatrixT<T> &); \
+    template CUpdateNorms CalcP(const CMatrixT<T> &, const NumericType, CMatrixT<T> &, const CMatrixPart &); \
+    template CFraction CalcAlpha(const CMatrixT<T> &, const CMatrixT<T> &, const CUniformGrid &); \
+    template CFraction CalcAlpha(const CMatrixT<T> &, const CMatrixT<T> &, const CUniformGrid &, \
+                                 const CMatrixPart &); \
+    template CFraction CalcTau(const CMatrixT<T> &, const CMatrixT<T> &, const CUniformGrid &); \
+    template CFraction CalcTau(const CMatrixT<T> &, const CMatrixT<T> &, const CUniformGrid &, const CMatrixPart &); \
+    template void CalcResidual(const CMatrixT<T> &, const CMatrixT<T> &, const CUniformGrid &, CMatrixT<T> &);
+
+DIRCH_INSTANTIATE_KERNELS(double)
+DIRCH_INSTANTIATE_KERNELS(float)
+
+#undef DIRCH_INSTANTIATE_KERNELS
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Слитная итерация, проход 1: отложенное обновление p и невязка r.
+NumericType CalcFusedR(const CMatrix &p, const CMatrix &g, const CMatrix &ag, const NumericType tau,
+                       const CUniformGrid &grid, CRightHandSide &rhs, CMatrix &pNext, CMatrix &r) {
+    CPhaseTimer timer(PP_FusedR, InnerPart(r).Size());
+    CalcBorderCombination(p, tau, g, pNext);
+    CFusedRKernel kernel(p, g, ag, tau, grid, rhs, pNext, r);
+    RunStencil(InnerPart(r), kernel);
+    rhs.SetReady();
+    return kernel.Numerator;
+}
+
+// Слитная итерация, проход 2: новое направление g и его лапласиан Ag.
+CFusedSums CalcFusedG(const CMatrix &r, const NumericType alpha, const CUniformGrid &grid,
+                      CMatrix &g, CMatrix &ag) {
+    CalcFusedGBorder(r, alpha, g);
+    return CalcFusedG(r, alpha, grid, g, ag, InnerPart(g));
+}
+
+// Слитная итерация, проход 2 только в точках part (граница матрицы - CalcFusedGBorder).
+CFusedSums CalcFusedG(const CMatrix &r, const NumericType alpha, const CUniformGrid &grid,
+                      CMatrix &g, CMatrix &ag, const CMatrixPart &part) {
+    CPhaseTimer timer(PP_FusedG, part.Size());
+    CFusedGKernel kernel(r, alpha, grid, g, ag);
+    RunStencil(part, kernel);
+    return kernel.Sums;
+}
+
+// Слитная итерация, проход 2 на границе матрицы: g = r - alpha * g (в "заезде" нужен уже полученный r).
+void CalcFusedGBorder(const CMatrix &r, const NumericType alpha, CMatrix &g) {
+    CalcBorderCombination(r, alpha, g, g);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
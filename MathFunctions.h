@@ -2,21 +2,102 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
-NumericType LaplasOperator( const CMatrix& matrix, const CUniformGrid& grid, size_t x, size_t y );
+// Проходы с параметром T определены для матриц NumericType и float (смешанная точность);
+// для float значения хранятся во float, а арифметика и суммы идут в NumericType.
+
+template<typename T>
+NumericType LaplasOperator( const CMatrixT<T>& matrix, const CUniformGrid& grid, size_t x, size_t y );
 
 // Вычисление невязки rij во внутренних точках.
-void CalcR( const CMatrix&p, const CUniformGrid& grid, CMatrix& r );
+// Если rhs ещё не заполнена, значения F считаются и записываются в неё в этом же проходе.
+void CalcR( const CMatrix&p, const CUniformGrid& grid, CRightHandSide& rhs, CMatrix& r );
+// То же только в точках part (например, в глубине блока, пока идёт обмен "заездами").
+// rhs не помечается готовой: после обхода всех частей вызывающий делает rhs.SetReady().
+void CalcR( const CMatrix&p, const CUniformGrid& grid, CRightHandSide& rhs, CMatrix& r, const CMatrixPart& part );
 
 // Вычисление значений gij во внутренних точках.
-void CalcG( const CMatrix&r, const NumericType alpha, CMatrix& g );
+template<typename T>
+void CalcG( const CMatrixT<T>& r, const NumericType alpha, CMatrixT<T>& g );
+// То же только в точках part.
+template<typename T>
+void CalcG( const CMatrixT<T>& r, const NumericType alpha, CMatrixT<T>& g, const CMatrixPart& part );
 
-// Вычисление значений pij во внутренних точках, возвращается максимум норма.
-NumericType CalcP( const CMatrix&g, const NumericType tau, CMatrix& p );
+// Вычисление значений pij во внутренних точках (один проход, параллельно).
+// Возвращаются локальные сумма квадратов и максимум модуля изменения p.
+template<typename T>
+CUpdateNorms CalcP( const CMatrixT<T>& g, const NumericType tau, CMatrixT<T>& p );
+// То же только в точках part, нормы - по part.
+template<typename T>
+CUpdateNorms CalcP( const CMatrixT<T>& g, const NumericType tau, CMatrixT<T>& p, const CMatrixPart& part );
 
 // Вычисление alpha.
-CFraction CalcAlpha( const CMatrix&r, const CMatrix&g, const CUniformGrid& grid );
+template<typename T>
+CFraction CalcAlpha( const CMatrixT<T>& r, const CMatrixT<T>& g, const CUniformGrid& grid );
+// Частичные суммы alpha по точкам part.
+template<typename T>
+CFraction CalcAlpha( const CMatrixT<T>& r, const CMatrixT<T>& g, const CUniformGrid& grid,
+	const CMatrixPart& part );
 
 // Вычисление tau.
-CFraction CalcTau( const CMatrix&r, const CMatrix&g, const CUniformGrid& grid );
+template<typename T>
+CFraction CalcTau( const CMatrixT<T>& r, const CMatrixT<T>& g, const CUniformGrid& grid );
+// Частичные суммы tau по точкам part.
+template<typename T>
+CFraction CalcTau( const CMatrixT<T>& r, const CMatrixT<T>& g, const CUniformGrid& grid,
+	const CMatrixPart& part );
+
+// Многосеточный метод и внутренние итерации смешанной точности (правая часть f - матрица).
+// Невязка r = A(u) - f во внутренних точках.
+template<typename T>
+void CalcResidual( const CMatrixT<T>& u, const CMatrixT<T>& f, const CUniformGrid& grid, CMatrixT<T>& r );
+// Взвешенный Якоби: result = u - omega * (A(u) - f) / D во внутренних точках, на границе - копия u.
+void CalcJacobi( const CMatrix& u, const CMatrix& f, const NumericType omega, const CUniformGrid& grid,
+	CMatrix& result );
+// Полуитерация красно-чёрного Гаусса - Зейделя: обновляются узлы с ( x + y ) % 2 == color.
+void CalcRedBlack( CMatrix& u, const CMatrix& f, const CUniformGrid& grid, const size_t color );
+// Нормы a - b во внутренних точках.
+CUpdateNorms CalcDifference( const CMatrix& a, const CMatrix& b );
+
+// Применение оператора Лапласа: result = A(u) во внутренних точках (или в точках part).
+void CalcOperator( const CMatrix& u, const CUniformGrid& grid, CMatrix& result );
+void CalcOperator( const CMatrix& u, const CUniformGrid& grid, CMatrix& result, const CMatrixPart& part );
+
+struct CPipelinedVectors { // векторы конвейерного метода сопряжённых градиентов (Ghysels, Vanroose)
+	CMatrix& P; // приближение
+	CMatrix& R; // невязка r = A(p) - F
+	CMatrix& Ar; // A r, пересчитывается по линейности
+	CMatrix& G; // направление g
+	CMatrix& Ag; // A g
+	CMatrix& Aag; // A(A g)
+
+	CPipelinedVectors( CMatrix& p, CMatrix& r, CMatrix& ar, CMatrix& g, CMatrix& ag, CMatrix& aag ) :
+		P( p ), R( r ), Ar( ar ), G( g ), Ag( ag ), Aag( aag )
+	{
+	}
+};
+
+// Конвейерный метод, проход обновления во внутренних точках (aar = A(Ar) уже посчитан):
+// Aag = aar + beta * Aag, Ag = Ar + beta * Ag, G = R + beta * G,
+// P = P - alpha * G, R = R - alpha * Ag, Ar = Ar - alpha * Aag.
+// Возвращает (r, r), (Ar, r) для следующей итерации и нормы G (изменение p равно alpha * G).
+CPipelinedSums CalcPipelined( const CMatrix& aar, const NumericType alpha, const NumericType beta,
+	const CUniformGrid& grid, CPipelinedVectors& vectors );
+
+// Слитная итерация, проход 1: отложенное обновление pNext = p - tau * g во всех точках
+// и невязка r = A(pNext) - F = A(p) - tau * Ag - F во внутренних точках.
+// Возвращает числитель alpha (r, Ag), по симметрии оператора равный (Ar, g).
+NumericType CalcFusedR( const CMatrix& p, const CMatrix& g, const CMatrix& ag, const NumericType tau,
+	const CUniformGrid& grid, CRightHandSide& rhs, CMatrix& pNext, CMatrix& r );
+
+// Слитная итерация, проход 2: g = r - alpha * g во всех точках и Ag = Ar - alpha * Ag
+// во внутренних точках (оператор Лапласа применяется только к r).
+// Возвращает дробь tau и нормы нового g.
+CFusedSums CalcFusedG( const CMatrix& r, const NumericType alpha, const CUniformGrid& grid,
+	CMatrix& g, CMatrix& ag );
+// Проход 2 только во внутренних точках part, без границы матрицы.
+CFusedSums CalcFusedG( const CMatrix& r, const NumericType alpha, const CUniformGrid& grid,
+	CMatrix& g, CMatrix& ag, const CMatrixPart& part );
+// Проход 2 на границе матрицы ("заезд" и глобальная граница): g = r - alpha * g.
+void CalcFusedGBorder( const CMatrix& r, const NumericType alpha, CMatrix& g );
 
 ///////////////////////////////////////////////////////////////////////////////
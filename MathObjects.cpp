@@ -2,24 +2,121 @@
 #include <math.h>
 #include <Definitions.h>
 #include <MathObjects.h>
+#include <StencilEngine.h>
 #include <Errors.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
-CMatrix &CMatrix::operator=(const CMatrix &other) {
-    sizeX = other.sizeX;
-    sizeY = other.sizeY;
-    values = other.values;
+bool CMatrixPlacement::firstTouch = false;
+
+template<typename T>
+CMatrixT<T> &CMatrixT<T>::operator=(const CMatrixT &other) {
+    if (this != &other) {
+        allocate(other.sizeX, other.sizeY);
+        assign(other.values);
+    }
     return *this;
 }
 
-void CMatrix::Init(const size_t _sizeX, const size_t _sizeY) {
+template<typename T>
+void CMatrixT<T>::Init(const size_t _sizeX, const size_t _sizeY) {
+    allocate(_sizeX, _sizeY);
+    assign(0);
+}
+
+template<typename T>
+void CMatrixT<T>::allocate(size_t _sizeX, size_t _sizeY) {
+    if (values != 0 && sizeX == _sizeX && sizeY == _sizeY) {
+        return; // страницы уже размещены
+    }
+    release();
     sizeX = _sizeX;
     sizeY = _sizeY;
-    values.resize(sizeX * sizeY);
-    fill(values.begin(), values.end(), static_cast<NumericType>( 0 ));
+    if (sizeX * sizeY > 0) {
+        values = static_cast<T *>( malloc(sizeX * sizeY * sizeof(T)));
+        if (values == 0) {
+            throw bad_alloc();
+        }
+    }
+}
+
+template<typename T>
+void CMatrixT<T>::release() {
+    if (owned) {
+        free(values);
+    }
+    values = 0;
+    owned = true;
+}
+
+template<typename T>
+void CMatrixT<T>::MoveTo(T *storage) {
+    if (storage == values) {
+        return;
+    }
+    copy(values, values + sizeX * sizeY, storage);
+    release();
+    values = storage;
+    owned = false;
 }
 
+// Копирование или обнуление отрезков строк. Отрезок, начинающийся или кончающийся у границы,
+// захватывает граничный столбец, первая и последняя внутренние строки - граничные строки.
+template<typename T>
+struct CAssignKernel : public CStencilKernel {
+    T *to;
+    const T *from;
+    const size_t sizeX;
+    const size_t sizeY;
+
+    CAssignKernel(T *to, const T *from, size_t sizeX, size_t sizeY) :
+            to(to), from(from), sizeX(sizeX), sizeY(sizeY) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        if (beginX == 1) {
+            beginX = 0;
+        }
+        if (endX == sizeX - 1) {
+            endX = sizeX;
+        }
+        span(y, beginX, endX);
+        if (y == 1) {
+            span(0, beginX, endX);
+        }
+        if (y == sizeY - 2) {
+            span(sizeY - 1, beginX, endX);
+        }
+    }
+
+    void span(size_t y, size_t beginX, size_t endX) {
+        const size_t begin = y * sizeX + beginX;
+        const size_t end = y * sizeX + endX;
+        if (from != 0) {
+            copy(from + begin, from + end, to + begin);
+        } else {
+            fill(to + begin, to + end, static_cast<T>( 0 ));
+        }
+    }
+};
+
+template<typename T>
+void CMatrixT<T>::assign(const T *from) {
+    if (values == 0) {
+        return;
+    }
+    if (FirstTouch() && sizeX >= 3 && sizeY >= 3) {
+        CAssignKernel<T> kernel(values, from, sizeX, sizeY);
+        RunStencil(CMatrixPart(1, sizeX - 1, 1, sizeY - 1), kernel);
+    } else if (from != 0) {
+        copy(from, from + sizeX * sizeY, values);
+    } else {
+        fill(values, values + sizeX * sizeY, static_cast<T>( 0 ));
+    }
+}
+
+template class CMatrixT<double>;
+template class CMatrixT<float>;
+
 ///////////////////////////////////////////////////////////////////////////////
 
 ostream &operator<<(ostream &out, const CMatrixPart &matrixPart) {
@@ -28,6 +125,19 @@ ostream &operator<<(ostream &out, const CMatrixPart &matrixPart) {
     return out;
 }
 
+CMatrixPart Rectangle(size_t beginX, size_t endX, size_t beginY, size_t endY) {
+    CMatrixPart part;
+    part.BeginX = beginX;
+    part.EndX = max(beginX, endX);
+    part.BeginY = beginY;
+    part.EndY = max(beginY, endY);
+    return part;
+}
+
+CMatrixPart Intersection(const CMatrixPart &a, const CMatrixPart &b) {
+    return Rectangle(max(a.BeginX, b.BeginX), min(a.EndX, b.EndX), max(a.BeginY, b.BeginY), min(a.EndY, b.EndY));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 NumericType CUniformPartition::BorderFunc(NumericType t) { // функция, f(t) из методички - как параметр сетки
@@ -54,6 +164,63 @@ void CUniformPartition::PartInit(NumericType p0, NumericType pN, size_t size, si
         const NumericType p = part * pN + (1 - part) * p0;
         ps.push_back(p);
     }
+    initMetrics();
+}
+
+void CUniformPartition::PartInit(const vector<NumericType> &points, size_t begin, size_t end) {
+    if (!(begin < end && end <= points.size())) {
+        throw CException("CUniformPartition: invalid [begin, end)");
+    }
+    ps.assign(points.begin() + begin, points.begin() + end);
+    initMetrics();
+}
+
+void CUniformPartition::initMetrics() { // сетка больше не меняется, поэтому делим один раз здесь
+    const size_t n = ps.size();
+    stepInverses.assign(n, 0);
+    averageSteps.assign(n, 0);
+    weightsPrev.assign(n, 0);
+    weightsNext.assign(n, 0);
+    for (size_t i = 0; i + 1 < n; i++) {
+        stepInverses[i] = 1 / Step(i);
+    }
+    if (n > 1) {
+        averageSteps[0] = Step(0) / 2;
+        averageSteps[n - 1] = Step(n - 2) / 2;
+    }
+    for (size_t i = 1; i + 1 < n; i++) {
+        averageSteps[i] = (Point(i + 1) - Point(i - 1)) / static_cast<NumericType>( 2 );
+        const NumericType averageInverse = 1 / averageSteps[i];
+        weightsPrev[i] = stepInverses[i - 1] * averageInverse;
+        weightsNext[i] = stepInverses[i] * averageInverse;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t CBlockedAxis::MinBlockSize() const {
+    size_t size = numeric_limits<size_t>::max();
+    for (size_t block = 0; block < Blocks(); block++) {
+        size = min(size, BlockSize(block));
+    }
+    return size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CUniformGrid::InitWeights() {
+    Weights.resize(X.Size() * Y.Size());
+    for (size_t y = 1; y + 1 < Y.Size(); y++) {
+        for (size_t x = 1; x + 1 < X.Size(); x++) {
+            CStencilWeights &weight = Weights[y * X.Size() + x];
+            weight.Center = X.WeightCenter(x) + Y.WeightCenter(y);
+            weight.West = X.WeightPrev(x);
+            weight.East = X.WeightNext(x);
+            weight.North = Y.WeightPrev(y);
+            weight.South = Y.WeightNext(y);
+            weight.Volume = X.AverageStep(x) * Y.AverageStep(y);
+        }
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -30,47 +30,197 @@ struct CFraction { // дробь для взаимодействий через
 	{
 		return ( Numerator / Denominator );
 	}
+
+	void Add( const CFraction& other ) // сложить числители и знаменатели (частичные суммы)
+	{
+		Numerator += other.Numerator;
+		Denominator += other.Denominator;
+	}
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-class CMatrix { // матрица
+enum TNorm { // норма изменения приближения, по которой проверяется сходимость
+	N_Euclidean, // корень из суммы квадратов
+	N_Max // максимум модуля
+};
+
+struct CUpdateNorms { // нормы изменения приближения во внутренних точках
+	NumericType Squares; // сумма квадратов (для MPI_SUM)
+	NumericType Max; // максимум модуля (для MPI_MAX)
+
+	CUpdateNorms() :
+		Squares( 0 ),
+		Max( 0 )
+	{
+	}
+
+	NumericType Value( TNorm norm ) const
+	{
+		return ( norm == N_Max ) ? Max : static_cast<NumericType>( pow( Squares, 0.5 ) );
+	}
+
+	void Add( const CUpdateNorms& other ) // объединить нормы двух частей области
+	{
+		Squares += other.Squares;
+		Max = max( Max, other.Max );
+	}
+
+	void Scale( NumericType factor ) // нормы factor * изменение
+	{
+		Squares *= factor * factor;
+		Max *= fabs( factor );
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CFusedSums { // суммы второго прохода слитной итерации, редуцируются одним MPI_Allreduce
+	CFraction Tau; // tau = (r, g) / (Ag, g)
+	CUpdateNorms G; // нормы g во внутренних точках: изменение p равно tau * g
+
+	void Add( const CFusedSums& other )
+	{
+		Tau.Add( other.Tau );
+		G.Add( other.G );
+	}
+};
+
+struct CPipelinedSums { // суммы конвейерного метода, редуцируются одним MPI_Iallreduce
+	NumericType RR; // (r, r)
+	NumericType ArR; // (Ar, r)
+	CUpdateNorms G; // нормы g: изменение p равно alpha * g
+
+	CPipelinedSums() :
+		RR( 0 ),
+		ArR( 0 )
+	{
+	}
+
+	void Add( const CPipelinedSums& other )
+	{
+		RR += other.RR;
+		ArR += other.ArR;
+		G.Add( other.G );
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CMatrixPlacement { // общая для всех типов значений настройка размещения матриц
+public:
+	// Первое касание страниц (NUMA): Init и operator= заполняют строки из потоков OpenMP
+	// по тому же статическому расписанию блоков, что и RunStencil для внутренних точек,
+	// поэтому страницы оказываются на узле памяти потока, который потом их обходит.
+	// Иначе память заполняется одним потоком.
+	static void SetFirstTouch( bool value ) { firstTouch = value; }
+	static bool FirstTouch() { return firstTouch; }
+
+private:
+	static bool firstTouch;
+};
+
+// Матрица значений типа T: NumericType или float для внутренних итераций смешанной точности.
+// Определения - в MathObjects.cpp, там же явно инстанцированы double и float.
+template<typename T>
+class CMatrixT : public CMatrixPlacement { // матрица
 public:
-	CMatrix() :
+	typedef T ValueType;
+
+	CMatrixT() :
 		sizeX( 0 ),
-		sizeY( 0 )
+		sizeY( 0 ),
+		values( 0 ),
+		owned( true )
 	{
 	}
 
-	CMatrix( size_t sizeX, size_t sizeY )
+	CMatrixT( size_t sizeX, size_t sizeY ) :
+		sizeX( 0 ),
+		sizeY( 0 ),
+		values( 0 ),
+		owned( true )
 	{
 		Init( sizeX, sizeY );
 	}
 
-	CMatrix( const CMatrix& other ) { *this = other; };
-	CMatrix& operator=( const CMatrix& other );
+	CMatrixT( const CMatrixT& other ) :
+		sizeX( 0 ),
+		sizeY( 0 ),
+		values( 0 ),
+		owned( true )
+	{
+		*this = other;
+	}
+	~CMatrixT() { release(); }
+	CMatrixT& operator=( const CMatrixT& other );
 
 
 	void Init( const size_t _sizeX, const size_t _sizeY );
 
-	NumericType& operator()( size_t x, size_t y )
+	T& operator()( size_t x, size_t y )
 	{
 		return values[y * sizeX + x];
 	}
-	NumericType operator()( size_t x, size_t y ) const
+	T operator()( size_t x, size_t y ) const
 	{
 		return values[y * sizeX + x];
 	}
+	// Адрес узла: строка лежит в памяти подряд, от него можно идти по x.
+	T* Pointer( size_t x, size_t y )
+	{
+		return &values[y * sizeX + x];
+	}
+	const T* Pointer( size_t x, size_t y ) const
+	{
+		return &values[y * sizeX + x];
+	}
 
 	size_t SizeX() const { return sizeX; }
 	size_t SizeY() const { return sizeY; }
 
+	void Swap( CMatrixT& other ) // обмен содержимым без копирования
+	{
+		swap( sizeX, other.sizeX );
+		swap( sizeY, other.sizeY );
+		swap( values, other.values );
+		swap( owned, other.owned );
+	}
+
+	// Перенести значения в storage (SizeX * SizeY значений), которым матрица не владеет: его освобождает
+	// тот, кто выделил (окно общей памяти, SharedMemory.h). operator= и Init того же размера пишут
+	// в storage, Init другого размера снова выделяет собственную память.
+	void MoveTo( T* storage );
+
 private:
 	size_t sizeX;
 	size_t sizeY;
-	vector<NumericType> values;
+	T* values; // malloc без заполнения: страницы размещаются при первой записи
+	bool owned; // values выделены malloc и освобождаются матрицей
+
+	void release(); // освободить values, если они свои
+
+	void allocate( size_t _sizeX, size_t _sizeY );
+	void assign( const T* from ); // копия from или нули (from == 0)
 };
 
+typedef CMatrixT<NumericType> CMatrix;
+typedef CMatrixT<float> CFloatMatrix;
+
+// Копия from со сменой типа значений, размер - как у from.
+template<typename TTo, typename TFrom>
+void ConvertMatrix( const CMatrixT<TFrom>& from, CMatrixT<TTo>& to )
+{
+	to.Init( from.SizeX(), from.SizeY() );
+	for( size_t y = 0; y < from.SizeY(); y++ ) {
+		const TFrom* source = from.Pointer( 0, y );
+		TTo* target = to.Pointer( 0, y );
+		for( size_t x = 0; x < from.SizeX(); x++ ) {
+			target[x] = static_cast<TTo>( source[x] );
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 struct CMatrixPart { // описание границы подматрицы
@@ -129,6 +279,11 @@ struct CMatrixPart { // описание границы подматрицы
 
 ostream& operator<<( ostream& out, const CMatrixPart& matrixPart );
 
+// Прямоугольник [beginX, endX) x [beginY, endY), возможно пустой (конструктор CMatrixPart их не допускает).
+CMatrixPart Rectangle( size_t beginX, size_t endX, size_t beginY, size_t endY );
+// Общая часть прямоугольников, возможно пустая.
+CMatrixPart Intersection( const CMatrixPart& a, const CMatrixPart& b );
+
 ///////////////////////////////////////////////////////////////////////////////
 
 class CUniformPartition {
@@ -141,6 +296,8 @@ public:
 
 	NumericType BorderFunc( NumericType t );
 	void PartInit( NumericType p0, NumericType pN, size_t size, size_t begin, size_t end );
+	// Узлы [begin, end) из готового списка координат (например, прореженного для грубой сетки).
+	void PartInit( const vector<NumericType>& points, size_t begin, size_t end );
 	void Init( NumericType p0, NumericType pN, size_t N )
 	{
 		PartInit( p0, pN, N, 0, N );
@@ -162,13 +319,57 @@ public:
 	{
 		return ( Point( i + 1 ) - Point( i ) );
 	}
-	NumericType AverageStep( size_t i ) const
+	NumericType StepInverse( size_t i ) const // 1 / Step( i )
 	{
-		return ( Point( i + 1 ) - Point( i - 1 ) ) / static_cast<NumericType>( 2 );
+		return stepInverses[i];
 	}
+	NumericType AverageStep( size_t i ) const // на концах - половина крайнего шага
+	{
+		return averageSteps[i];
+	}
+
+	// Коэффициенты второй разностной производной во внутренней точке i:
+	// -u'' = Center( i ) * u[i] - Prev( i ) * u[i - 1] - Next( i ) * u[i + 1].
+	NumericType WeightPrev( size_t i ) const { return weightsPrev[i]; }
+	NumericType WeightNext( size_t i ) const { return weightsNext[i]; }
+	NumericType WeightCenter( size_t i ) const { return weightsPrev[i] + weightsNext[i]; }
+	// Те же коэффициенты массивами - для построчных ядер.
+	const NumericType* WeightsPrev() const { return &weightsPrev[0]; }
+	const NumericType* WeightsNext() const { return &weightsNext[0]; }
+	const NumericType* AverageSteps() const { return &averageSteps[0]; }
 
 private:
 	vector<NumericType> ps;
+	// Метрические коэффициенты, вычисляются один раз в PartInit.
+	vector<NumericType> stepInverses;
+	vector<NumericType> averageSteps;
+	vector<NumericType> weightsPrev;
+	vector<NumericType> weightsNext;
+
+	void initMetrics();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CBlockedAxis { // ось целиком и её разбиение на блоки процессов
+	vector<NumericType> Points; // координаты всех узлов оси
+	vector<size_t> Begins; // первые узлы блоков (без "заезда"), последний элемент - число узлов
+
+	size_t Size() const { return Points.size(); }
+	size_t Blocks() const { return Begins.size() - 1; }
+	size_t BlockSize( size_t block ) const { return Begins[block + 1] - Begins[block]; }
+	size_t MinBlockSize() const;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CStencilWeights { // коэффициенты пятиточечного шаблона во всех узлах, хранятся подряд для узла
+	NumericType Center;
+	NumericType West; // (x - 1, y)
+	NumericType East; // (x + 1, y)
+	NumericType North; // (x, y - 1)
+	NumericType South; // (x, y + 1)
+	NumericType Volume; // AverageStep( x ) * AverageStep( y ) - вес узла в скалярном произведении
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -176,6 +377,20 @@ private:
 struct CUniformGrid { // описание грида - по сути 2 вектора с вспомогательными методами
 	CUniformPartition X;
 	CUniformPartition Y;
+	// Полная таблица коэффициентов шаблона (X.Size() x Y.Size()), пустая - коэффициенты берутся по осям.
+	// Занимает 6 чисел на узел, но экономит сложения и обращения к двум осям.
+	vector<CStencilWeights> Weights;
+
+	void InitWeights(); // заполнить Weights по коэффициентам осей
+
+	const CStencilWeights& Weight( size_t x, size_t y ) const
+	{
+		return Weights[y * X.Size() + x];
+	}
+	NumericType Volume( size_t x, size_t y ) const // вес узла в скалярном произведении
+	{
+		return Weights.empty() ? X.AverageStep( x ) * Y.AverageStep( y ) : Weight( x, y ).Volume;
+	}
 
 	CMatrixPart Column( size_t x, size_t decreaseTop = 0, size_t decreaseBottom = 0 ) const
 	{
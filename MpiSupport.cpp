@@ -1,6 +1,7 @@
 #include <Std.h>
 #include <Errors.h>
 #include <MpiSupport.h>
+#include <SharedMemory.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -40,6 +41,7 @@ void CMpiSupport::Initialize(int *argc, char ***argv) {
 
 void CMpiSupport::Finalize() {
     checkInitialized(); // throw if not initialized
+    CSharedMemory::Finalize(); // окна обмена "заездами" по общей памяти
     MPI_Finalize();
 }
 
@@ -32,6 +32,11 @@ private:
 // Checking execution result of mpiFunctionName.
 void MpiCheck( const int mpiResult, const string& mpiFunctionName );
 
+// Тип MPI для значений типа T (NumericType или float матриц CMatrixT).
+template<typename T> MPI_Datatype MpiTypeOf();
+template<> inline MPI_Datatype MpiTypeOf<double>() { return MPI_DOUBLE; }
+template<> inline MPI_Datatype MpiTypeOf<float>() { return MPI_FLOAT; }
+
 ///////////////////////////////////////////////////////////////////////////////
 
 class CMpiSupport {
@@ -0,0 +1,397 @@
+#include <Std.h>
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <Problem.h>
+#include <MathFunctions.h>
+#include <StencilEngine.h>
+#include <Options.h>
+#include <Profiler.h>
+#include <Exchange.h>
+#include <Errors.h>
+#include <Multigrid.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CMultigridAxis::Coarsen(CMultigridAxis &coarse) const {
+    if (!CanCoarsen()) {
+        coarse = *this;
+        return;
+    }
+    const size_t coarseSize = Size() / 2 + 1;
+    coarse.Points.resize(coarseSize);
+    for (size_t j = 0; j < coarseSize; j++) {
+        coarse.Points[j] = Points[FineIndex(j)];
+    }
+    // Узел 2j принадлежит блоку, содержащему узел 2j мелкой оси; последний узел - последнему блоку.
+    coarse.Begins.resize(Begins.size());
+    for (size_t block = 0; block < Blocks(); block++) {
+        coarse.Begins[block] = (Begins[block] + 1) / 2;
+    }
+    coarse.Begins.back() = coarseSize;
+}
+
+size_t CMultigridAxis::FineIndex(size_t coarse) const {
+    if (!CanCoarsen()) {
+        return coarse;
+    }
+    return (coarse == Size() / 2) ? Size() - 1 : 2 * coarse;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Номер узла грубой оси, совпадающего с узлом index мелкой оси, или NoCoarsePoint.
+static const size_t NoCoarsePoint = numeric_limits<size_t>::max();
+
+static size_t CoarseIndex(const CMultigridAxis &fine, size_t index) {
+    if (!fine.CanCoarsen()) {
+        return index;
+    }
+    if (index == fine.Size() - 1) {
+        return fine.Size() / 2;
+    }
+    return (index % 2 == 0) ? index / 2 : NoCoarsePoint;
+}
+
+// Средний шаг во внутреннем узле - вес узла в скалярном произведении по оси.
+static NumericType AverageStep(const vector<NumericType> &points, size_t i) {
+    return (points[i + 1] - points[i - 1]) / 2;
+}
+
+// Веса переноса по оси между блоками [fineBegin, ...) мелкого и [coarseBegin, coarseBegin + coarseSize)
+// грубого уровня (глобальные номера первых узлов с "заездом"). prolongation - для внутренних узлов
+// мелкого блока, restriction - для внутренних узлов грубого.
+static void InitTransfer(const CMultigridAxis &fine, size_t fineBegin, size_t fineSize,
+                         const CMultigridAxis &coarse, size_t coarseBegin, size_t coarseSize,
+                         vector<CTransferWeights> &prolongation, vector<CTransferWeights> &restriction) {
+    const vector<NumericType> &x = fine.Points;
+    prolongation.assign(fineSize, CTransferWeights());
+    for (size_t i = 1; i + 1 < fineSize; i++) {
+        const size_t g = fineBegin + i;
+        const size_t c = CoarseIndex(fine, g);
+        if (c != NoCoarsePoint) {
+            prolongation[i].Add(c - coarseBegin, 1);
+        } else { // соседи нечётного узла - узлы грубой сетки
+            const NumericType a = (x[g + 1] - x[g]) / (x[g + 1] - x[g - 1]);
+            prolongation[i].Add(CoarseIndex(fine, g - 1) - coarseBegin, a);
+            prolongation[i].Add(CoarseIndex(fine, g + 1) - coarseBegin, 1 - a);
+        }
+        for (size_t k = 0; k < prolongation[i].Count; k++) {
+            assert(prolongation[i].Index[k] < coarseSize);
+        }
+    }
+
+    restriction.assign(coarseSize, CTransferWeights());
+    for (size_t j = 1; j + 1 < coarseSize; j++) {
+        const size_t global = coarseBegin + j;
+        const size_t g = fine.FineIndex(global);
+        const NumericType volume = AverageStep(coarse.Points, global);
+        restriction[j].Add(g - fineBegin, AverageStep(x, g) / volume);
+        // Нечётные соседи получают из узла global долю продолжения, на границе невязка равна нулю.
+        if (g > 1 && CoarseIndex(fine, g - 1) == NoCoarsePoint) {
+            const size_t i = g - 1;
+            const NumericType p = (x[i] - x[i - 1]) / (x[i + 1] - x[i - 1]);
+            restriction[j].Add(i - fineBegin, p * AverageStep(x, i) / volume);
+        }
+        if (g + 2 < fine.Size() && CoarseIndex(fine, g + 1) == NoCoarsePoint) {
+            const size_t i = g + 1;
+            const NumericType p = (x[i + 1] - x[i]) / (x[i + 1] - x[i - 1]);
+            restriction[j].Add(i - fineBegin, p * AverageStep(x, i) / volume);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CMultigridLevel { // уровень: блок процесса с "заездом" и матрицы уровня
+private:
+    CMultigridLevel(const CMultigridLevel &);
+
+    CMultigridLevel &operator=(const CMultigridLevel &);
+
+public:
+    CMultigridAxis X;
+    CMultigridAxis Y;
+    size_t RankX;
+    size_t RankY;
+    size_t OffsetX; // глобальные номера узла (0, 0) блока
+    size_t OffsetY;
+    CUniformGrid Grid;
+    CExchangeDefinitions Exchange;
+    CMatrix U; // грубые уровни: поправка
+    CMatrix F; // грубые уровни: сужение невязки
+    CMatrix R; // невязка A(u) - f
+    CMatrix T; // Якоби: следующее приближение
+    // Перенос со следующим уровнем: продолжение - для узлов этого блока, сужение - для узлов грубого.
+    vector<CTransferWeights> ProlongationX;
+    vector<CTransferWeights> ProlongationY;
+    vector<CTransferWeights> RestrictionX;
+    vector<CTransferWeights> RestrictionY;
+
+    CMultigridLevel(const CMultigridAxis &x, const CMultigridAxis &y, size_t rankX, size_t rankY, MPI_Comm comm,
+                    TExchangeMode mode, bool coarse) :
+            X(x), Y(y), RankX(rankX), RankY(rankY) {
+        OffsetX = X.Begins[RankX] - (RankX > 0 ? 1 : 0);
+        OffsetY = Y.Begins[RankY] - (RankY > 0 ? 1 : 0);
+        const size_t endX = X.Begins[RankX + 1] + (RankX + 1 < X.Blocks() ? 1 : 0);
+        const size_t endY = Y.Begins[RankY + 1] + (RankY + 1 < Y.Blocks() ? 1 : 0);
+        Grid.X.PartInit(X.Points, OffsetX, endX);
+        Grid.Y.PartInit(Y.Points, OffsetY, endY);
+        if (Grid.X.Size() < 3 || Grid.Y.Size() < 3) {
+            throw CException("Multigrid: a block has no inner points on a coarse level.");
+        }
+
+        const size_t processesX = X.Blocks();
+        Exchange.SetMode(mode);
+        Exchange.InitHalo(Grid,
+                          RankX > 0 ? static_cast<int>( RankY * processesX + RankX - 1 ) : -1,
+                          RankX + 1 < processesX ? static_cast<int>( RankY * processesX + RankX + 1 ) : -1,
+                          RankY > 0 ? static_cast<int>( (RankY - 1) * processesX + RankX ) : -1,
+                          RankY + 1 < Y.Blocks() ? static_cast<int>( (RankY + 1) * processesX + RankX ) : -1,
+                          comm);
+
+        if (coarse) {
+            U.Init(Grid.X.Size(), Grid.Y.Size());
+            F.Init(Grid.X.Size(), Grid.Y.Size());
+        }
+        R.Init(Grid.X.Size(), Grid.Y.Size());
+        T.Init(Grid.X.Size(), Grid.Y.Size());
+    }
+
+    void InitTransfer(const CMultigridLevel &coarse) {
+        ::InitTransfer(X, OffsetX, Grid.X.Size(), coarse.X, coarse.OffsetX, coarse.Grid.X.Size(),
+                       ProlongationX, RestrictionX);
+        ::InitTransfer(Y, OffsetY, Grid.Y.Size(), coarse.Y, coarse.OffsetY, coarse.Grid.Y.Size(),
+                       ProlongationY, RestrictionY);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// f = R r во внутренних узлах грубого блока.
+struct CRestrictionKernel : public CStencilKernel {
+    const CMultigridLevel &fine;
+    const CMatrix &r;
+    CMatrix &f;
+
+    CRestrictionKernel(const CMultigridLevel &fine, const CMatrix &r, CMatrix &f) : fine(fine), r(r), f(f) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        const CTransferWeights &wy = fine.RestrictionY[y];
+        for (size_t x = beginX; x < endX; x++) {
+            const CTransferWeights &wx = fine.RestrictionX[x];
+            NumericType sum = 0;
+            for (size_t b = 0; b < wy.Count; b++) {
+                NumericType row = 0;
+                for (size_t a = 0; a < wx.Count; a++) {
+                    row += wx.Weight[a] * r(wx.Index[a], wy.Index[b]);
+                }
+                sum += wy.Weight[b] * row;
+            }
+            f(x, y) = sum;
+        }
+    }
+};
+
+// u -= P e во внутренних узлах мелкого блока.
+struct CProlongationKernel : public CStencilKernel {
+    const CMultigridLevel &fine;
+    const CMatrix &e;
+    CMatrix &u;
+
+    CProlongationKernel(const CMultigridLevel &fine, const CMatrix &e, CMatrix &u) : fine(fine), e(e), u(u) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        const CTransferWeights &wy = fine.ProlongationY[y];
+        for (size_t x = beginX; x < endX; x++) {
+            const CTransferWeights &wx = fine.ProlongationX[x];
+            NumericType sum = 0;
+            for (size_t b = 0; b < wy.Count; b++) {
+                NumericType row = 0;
+                for (size_t a = 0; a < wx.Count; a++) {
+                    row += wx.Weight[a] * e(wx.Index[a], wy.Index[b]);
+                }
+                sum += wy.Weight[b] * row;
+            }
+            u(x, y) -= sum;
+        }
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+const NumericType CMultigrid::JacobiOmega = static_cast<NumericType>( 0.8 );
+
+CMultigrid::CMultigrid(const CBlockedAxis &x, const CBlockedAxis &y, size_t rankX, size_t rankY, MPI_Comm comm,
+                       const CSolverOptions &options) :
+        cycleType(options.MultigridCycle),
+        smoother(options.MultigridSmoother),
+        sweeps(options.MultigridSweeps),
+        comm(comm) {
+    const bool distributed = (x.Blocks() * y.Blocks() > 1);
+    levels.push_back(new CMultigridLevel(CMultigridAxis(x), CMultigridAxis(y), rankX, rankY, comm, options.ExchangeMode, false /* coarse */ ));
+    while (levels.back()->X.CanCoarsen() || levels.back()->Y.CanCoarsen()) {
+        CMultigridLevel &fine = *levels.back();
+        CMultigridAxis coarseX;
+        CMultigridAxis coarseY;
+        fine.X.Coarsen(coarseX);
+        fine.Y.Coarsen(coarseY);
+        // Агломерация: мелкие блоки дают больше обменов, чем вычислений, - дальше уровни целиком на каждом процессе.
+        const bool gather = distributed &&
+                            (coarseX.MinBlockSize() < GatherBlockSize || coarseY.MinBlockSize() < GatherBlockSize);
+        levels.push_back(new CMultigridLevel(coarseX, coarseY, rankX, rankY, comm, options.ExchangeMode, true));
+        fine.InitTransfer(*levels.back());
+        if (gather) {
+            coarseX.Begins.assign(1, 0);
+            coarseX.Begins.push_back(coarseX.Size());
+            coarseY.Begins.assign(1, 0);
+            coarseY.Begins.push_back(coarseY.Size());
+            redundant.reset(new CMultigrid(coarseX, coarseY, 0, 0, MPI_COMM_SELF, options));
+            break;
+        }
+    }
+
+    if (redundant.get() != 0) {
+        const CMultigridLevel &last = *levels.back();
+        size_t displacement = 0;
+        for (size_t by = 0; by < last.Y.Blocks(); by++) { // порядок ранков: by * processesX + bx
+            for (size_t bx = 0; bx < last.X.Blocks(); bx++) {
+                const size_t count = last.X.BlockSize(bx) * last.Y.BlockSize(by);
+                gatherCounts.push_back(static_cast<int>( count ));
+                gatherDisplacements.push_back(static_cast<int>( displacement ));
+                displacement += count;
+            }
+        }
+        gatherBuffer.resize(displacement);
+        gatherSend.resize(last.X.BlockSize(rankX) * last.Y.BlockSize(rankY));
+        gatheredF.Init(last.X.Size(), last.Y.Size());
+        gatheredU.Init(last.X.Size(), last.Y.Size());
+    }
+}
+
+CMultigrid::~CMultigrid() {
+    for (size_t i = 0; i < levels.size(); i++) {
+        delete levels[i];
+    }
+}
+
+void CMultigrid::Cycle(CMatrix &u, const CMatrix &f) {
+    if (levels.size() == 1) { // грубить некуда - не больше одной внутренней точки
+        smooth(*levels[0], u, f, MS_RedBlack, CoarsestSweeps, false);
+        return;
+    }
+    cycle(0, u, f);
+}
+
+void CMultigrid::Precondition(const CMatrix &r, CMatrix &z) {
+    z.Init(r.SizeX(), r.SizeY());
+    Cycle(z, r);
+}
+
+void CMultigrid::cycle(size_t level, CMatrix &u, const CMatrix &f) {
+    CMultigridLevel &fine = *levels[level];
+    CMultigridLevel &coarse = *levels[level + 1];
+
+    smooth(fine, u, f, smoother, sweeps, false);
+    fine.Exchange.Exchange(u);
+    CalcResidual(u, f, fine.Grid, fine.R);
+    fine.Exchange.Exchange(fine.R); // сужение берёт невязку из "заезда"
+    restrictResidual(fine, fine.R, coarse.F);
+
+    solve(level + 1);
+
+    coarse.Exchange.Exchange(coarse.U); // продолжение берёт поправку из "заезда"
+    prolongateCorrection(fine, coarse.U, u);
+    // Обратный порядок цветов делает цикл симметричным, что нужно предобусловливателю.
+    smooth(fine, u, f, smoother, sweeps, true);
+}
+
+void CMultigrid::solve(size_t level) {
+    CMultigridLevel &current = *levels[level];
+    current.U.Init(current.Grid.X.Size(), current.Grid.Y.Size());
+    if (level + 1 < levels.size()) {
+        const size_t cycles = (cycleType == MC_W) ? 2 : 1;
+        for (size_t i = 0; i < cycles; i++) {
+            cycle(level, current.U, current.F);
+        }
+    } else if (redundant.get() != 0) {
+        solveGathered(current);
+    } else {
+        smooth(current, current.U, current.F, MS_RedBlack, CoarsestSweeps, false);
+    }
+}
+
+void CMultigrid::solveGathered(CMultigridLevel &level) {
+    // Свои узлы блока (без "заезда") подряд по строкам.
+    const size_t beginX = level.X.Begins[level.RankX] - level.OffsetX;
+    const size_t beginY = level.Y.Begins[level.RankY] - level.OffsetY;
+    const size_t sizeX = level.X.BlockSize(level.RankX);
+    const size_t sizeY = level.Y.BlockSize(level.RankY);
+    {
+        CPhaseTimer timer(PP_CoarseGather, gatherBuffer.size());
+        for (size_t y = 0; y < sizeY; y++) {
+            for (size_t x = 0; x < sizeX; x++) {
+                gatherSend[y * sizeX + x] = level.F(beginX + x, beginY + y);
+            }
+        }
+        MpiCheck(MPI_Allgatherv(&gatherSend[0], static_cast<int>( gatherSend.size()), MpiNumericType,
+                                &gatherBuffer[0], &gatherCounts[0], &gatherDisplacements[0], MpiNumericType, comm),
+                 "MPI_Allgatherv");
+        size_t rank = 0;
+        for (size_t by = 0; by < level.Y.Blocks(); by++) {
+            for (size_t bx = 0; bx < level.X.Blocks(); bx++, rank++) {
+                const NumericType *values = &gatherBuffer[gatherDisplacements[rank]];
+                const size_t blockX = level.X.BlockSize(bx);
+                for (size_t y = 0; y < level.Y.BlockSize(by); y++) {
+                    for (size_t x = 0; x < blockX; x++) {
+                        gatheredF(level.X.Begins[bx] + x, level.Y.Begins[by] + y) = values[y * blockX + x];
+                    }
+                }
+            }
+        }
+    }
+
+    // Каждый процесс решает одну и ту же задачу, поэтому "заезд" берётся из общего решения без обмена.
+    gatheredU.Init(gatheredF.SizeX(), gatheredF.SizeY());
+    const size_t cycles = (cycleType == MC_W) ? 2 : 1;
+    for (size_t i = 0; i < cycles; i++) {
+        redundant->Cycle(gatheredU, gatheredF);
+    }
+    for (size_t y = 0; y < level.U.SizeY(); y++) {
+        for (size_t x = 0; x < level.U.SizeX(); x++) {
+            level.U(x, y) = gatheredU(level.OffsetX + x, level.OffsetY + y);
+        }
+    }
+}
+
+void CMultigrid::smooth(CMultigridLevel &level, CMatrix &u, const CMatrix &f, TMultigridSmoother method,
+                        size_t count, bool reverse) {
+    for (size_t sweep = 0; sweep < count; sweep++) {
+        if (method == MS_Jacobi) {
+            level.Exchange.Exchange(u);
+            CalcJacobi(u, f, JacobiOmega, level.Grid, level.T);
+            u.Swap(level.T);
+            continue;
+        }
+        for (size_t i = 0; i < 2; i++) {
+            // цвет узла - чётность глобальных номеров, у блока они сдвинуты на Offset
+            const size_t color = reverse ? 1 - i : i;
+            level.Exchange.Exchange(u);
+            CalcRedBlack(u, f, level.Grid, (color + level.OffsetX + level.OffsetY) % 2);
+        }
+    }
+}
+
+void CMultigrid::restrictResidual(const CMultigridLevel &fine, const CMatrix &r, CMatrix &f) const {
+    CPhaseTimer timer(PP_Restriction, InnerPart(f).Size());
+    CRestrictionKernel kernel(fine, r, f);
+    RunStencil(InnerPart(f), kernel);
+}
+
+void CMultigrid::prolongateCorrection(const CMultigridLevel &fine, const CMatrix &e, CMatrix &u) const {
+    CPhaseTimer timer(PP_Prolongation, InnerPart(u).Size());
+    CProlongationKernel kernel(fine, e, u);
+    RunStencil(InnerPart(u), kernel);
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,98 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Геометрический многосеточный метод для той же задачи: A u = f во внутренних точках,
+// на границе u задана (поправки на грубых уровнях - с нулевой границей).
+// Грубая сетка - каждый второй узел оси (и последний), неравномерность BorderFunc сохраняется:
+// узлы грубой сетки - подмножество узлов мелкой, операторы грубых уровней строятся заново по их узлам.
+// Продолжение - линейная интерполяция по координатам узлов, сужение - сопряжённое к нему
+// в скалярном произведении с весами узлов ( R = Vc^-1 P^T Vf ).
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CMultigridAxis : public CBlockedAxis { // ось уровня
+	CMultigridAxis() {}
+	explicit CMultigridAxis( const CBlockedAxis& axis ) : CBlockedAxis( axis ) {}
+
+	bool CanCoarsen() const { return Size() > 3; }
+	// Грубая ось: узлы с чётными номерами и последний. Если прореживать нечего - копия.
+	void Coarsen( CMultigridAxis& coarse ) const;
+	// Номер узла мелкой оси, совпадающего с узлом coarse грубой оси.
+	size_t FineIndex( size_t coarse ) const;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CTransferWeights { // строка оператора переноса по одной оси: до трёх узлов с весами
+	size_t Count;
+	size_t Index[3]; // локальные номера узлов другого уровня
+	NumericType Weight[3];
+
+	CTransferWeights() : Count( 0 ) {}
+
+	void Add( size_t index, NumericType weight )
+	{
+		assert( Count < 3 );
+		Index[Count] = index;
+		Weight[Count] = weight;
+		Count++;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CMultigridLevel;
+
+class CMultigrid {
+private:
+	CMultigrid( const CMultigrid& );
+	CMultigrid& operator=( const CMultigrid& );
+
+public:
+	// x, y - уровень 0 (узлы и блоки процессов), блок этого процесса - ( rankX, rankY ),
+	// ранк процесса блока ( bx, by ) в comm равен by * x.Blocks() + bx.
+	CMultigrid( const CBlockedAxis& x, const CBlockedAxis& y, size_t rankX, size_t rankY, MPI_Comm comm,
+		const CSolverOptions& options );
+	~CMultigrid();
+
+	// Один цикл для A u = f на блоке уровня 0 (u и f - с "заездом", "заезд" u не обязан быть свежим).
+	void Cycle( CMatrix& u, const CMatrix& f );
+	// Предобусловливатель: z = цикл для A z = r с нулевым приближением и нулевой границей.
+	void Precondition( const CMatrix& r, CMatrix& z );
+
+	size_t Levels() const { return levels.size(); } // включая уровень, собранный на всех процессах
+
+private:
+	// Если блок на следующем уровне меньше этого числа узлов по какой-нибудь оси,
+	// грубая задача собирается целиком на каждом процессе (MPI_Allgatherv) и решается без обменов.
+	static const size_t GatherBlockSize = 8;
+	static const NumericType JacobiOmega; // 4/5 - лучшее сглаживание для пятиточечного шаблона
+	static const size_t CoarsestSweeps = 4; // на последнем уровне не больше одной внутренней точки
+
+	const TMultigridCycle cycleType;
+	const TMultigridSmoother smoother;
+	const size_t sweeps;
+	MPI_Comm comm;
+	vector<CMultigridLevel*> levels;
+	// Грубые уровни, собранные на каждом процессе (MPI_COMM_SELF), 0 - собирать не нужно.
+	unique_ptr<CMultigrid> redundant;
+	// Сбор последнего уровня: сколько узлов и откуда у каждого ранка.
+	vector<int> gatherCounts;
+	vector<int> gatherDisplacements;
+	vector<NumericType> gatherSend; // свои узлы последнего уровня
+	vector<NumericType> gatherBuffer; // узлы всех ранков подряд
+	CMatrix gatheredF;
+	CMatrix gatheredU;
+
+	void cycle( size_t level, CMatrix& u, const CMatrix& f );
+	void solve( size_t level ); // U = приближённое решение A U = F уровня level > 0
+	void solveGathered( CMultigridLevel& level );
+	// count итераций сглаживателя method; reverse - цвета в обратном порядке (после грубого уровня).
+	void smooth( CMultigridLevel& level, CMatrix& u, const CMatrix& f, TMultigridSmoother method, size_t count,
+		bool reverse );
+	void restrictResidual( const CMultigridLevel& fine, const CMatrix& r, CMatrix& f ) const;
+	void prolongateCorrection( const CMultigridLevel& fine, const CMatrix& e, CMatrix& u ) const; // u -= P e
+};
+
+///////////////////////////////////////////////////////////////////////////////
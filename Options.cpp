@@ -0,0 +1,341 @@
+#include <Std.h>
+#include <Errors.h>
+#include <Definitions.h>
+#include <Options.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char *const OptionsUsage =
+        "Options:\n"
+        "  --iteration=classic|fused|pipelined|multigrid|direct|mixed|chebyshev  iteration kernels\n"
+        "                             (default: classic); pipelined CG overlaps its single MPI_Iallreduce\n"
+        "                             with the stencil, multigrid runs V/W cycles until the update is\n"
+        "                             below eps, direct solves by fast diagonalization (dense transforms\n"
+        "                             per axis), mixed corrects the double residual by CG iterations in\n"
+        "                             float, chebyshev steps by the spectrum bounds of the operator with\n"
+        "                             no dot products: reductions are left only to --convergence checks\n"
+        "  --mixed-iterations=N       inner float iterations per correction at most (default: 10000)\n"
+        "  --mixed-reduction=R        stop the inner iterations once their step is R times the largest\n"
+        "                             one (default: 0.0001) or below eps\n"
+        "  --preconditioner=none|multigrid  precondition the classic iteration with one cycle\n"
+        "  --mg-cycle=v|w             multigrid cycle (default: v)\n"
+        "  --mg-smoother=jacobi|rbgs  weighted Jacobi or red-black Gauss-Seidel (default: jacobi)\n"
+        "  --mg-sweeps=N              smoothing sweeps before and after the coarse grid (default: 2)\n"
+        "  --tile=auto|XxY            grid traversal tile size in points (default: auto)\n"
+        "  --weights=axis|full        stencil coefficients per axis or per grid point (default: axis)\n"
+        "  --rhs=eager|lazy           fill the F table before iterating or in the first residual pass\n"
+        "  --problem=FILE             read area, F and Phi tables from FILE instead of Definitions.h\n"
+        "  --simd=auto|scalar|avx2|avx512  instruction set of row kernels (default: auto, by CPUID)\n"
+        "  --deterministic            sum reductions in a fixed tile order, independent of threads\n"
+        "  --norm=l2|max              norm of the iteration difference compared with eps (default: l2)\n"
+        "  --convergence=every|periodic|adaptive  reduce the difference norm over processes every\n"
+        "                             iteration, every k iterations, or at intervals of up to k adapted\n"
+        "                             to the convergence rate; periodic and adaptive use a non-blocking\n"
+        "                             reduction completed one iteration later (default: periodic for\n"
+        "                             --iteration=chebyshev, every otherwise); periodic may run up to\n"
+        "                             k extra iterations, adaptive about one\n"
+        "  --convergence-period=K     k of periodic and adaptive checks (default: 10)\n"
+        "  --overlap                  compute the block interior while the halo exchange is in flight\n"
+        "  --exchange=buffered|datatype|shared|rma  halo exchange through copy buffers, MPI derived\n"
+        "                             datatypes with persistent requests, MPI-3 shared memory windows\n"
+        "                             read directly by the ranks of a node, or one-sided MPI_Put into\n"
+        "                             the neighbors' halos with post/start/complete/wait epochs\n"
+        "                             (default: buffered)\n"
+        "  --halo=S                   halo width: chebyshev exchanges p and its direction once every S\n"
+        "                             sweeps (corners included) and computes the overlap redundantly\n"
+        "                             (default: 1)\n"
+        "  --topology=world|cart      ranks of MPI_COMM_WORLD or a reordered MPI_Cart_create grid\n"
+        "  --first-touch              place matrix pages from the threads that sweep them (NUMA)\n"
+        "  --affinity                 print the core and OpenMP place of every rank and thread\n"
+        "  --output=binary|text       DUMP_FILENAME format: one binary file written with MPI-IO\n"
+        "                             (default) or text files DUMP_FILENAME<rank> with halos\n"
+        "  --checkpoint=FILE          save the iteration state to FILE with MPI-IO in the background\n"
+        "  --checkpoint-every=N       save every N iterations (default: 100 unless --checkpoint-seconds)\n"
+        "  --checkpoint-seconds=T     save every T seconds of wall time\n"
+        "  --restart=FILE             continue from a checkpoint, on any number of processes\n"
+        "  --initial=FILE             start from a binary DUMP_FILENAME of any grid over the same area,\n"
+        "                             interpolated onto this grid\n"
+        "  --nested=N                 start from the solution on a grid coarsened twice per axis, found\n"
+        "                             the same way with N-1 levels (full multigrid style, default: 0)\n"
+        "  --profile[=text|json|csv]  time the kernels, halo exchanges, reductions and file output and\n"
+        "                             print min/avg/max over processes, GB/s and GFLOP/s at the end\n"
+        "  --profile-file=FILE        write the profile to FILE instead of the standard output\n"
+        "  --log-every=N              print every N-th iteration, buffered and written by a background\n"
+        "                             thread (default: every iteration, flushed each time)\n"
+        "  --log-seconds=T            print an iteration at most every T seconds of wall time\n"
+        "  --history=FILE             write iteration, difference and wall time of every iteration to FILE\n"
+        "  --history-format=csv|binary  format of the history file (default: csv)\n";
+
+static void SplitOption(const string &argument, string &name, string &value) { // --name=value -> name, value
+    const size_t equal = argument.find('=');
+    name = argument.substr(2, equal == string::npos ? string::npos : equal - 2);
+    value = (equal == string::npos) ? string() : argument.substr(equal + 1);
+}
+
+void ParseOption(const string &argument, CSolverOptions &options) {
+    if (argument.compare(0, 2, "--") != 0) {
+        throw CException("invalid option `" + argument + "`");
+    }
+    string name;
+    string value;
+    SplitOption(argument, name, value);
+
+    if (name == "iteration") {
+        if (value == "classic") {
+            options.IterationMode = IM_Classic;
+        } else if (value == "fused") {
+            options.IterationMode = IM_Fused;
+        } else if (value == "pipelined") {
+            options.IterationMode = IM_Pipelined;
+        } else if (value == "multigrid") {
+            options.IterationMode = IM_Multigrid;
+        } else if (value == "direct") {
+            options.IterationMode = IM_Direct;
+        } else if (value == "mixed") {
+            options.IterationMode = IM_Mixed;
+        } else if (value == "chebyshev") {
+            options.IterationMode = IM_Chebyshev;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "tile") {
+        if (value == "auto") {
+            options.TileX = 0;
+            options.TileY = 0;
+        } else {
+            char *end = 0;
+            options.TileX = strtoul(value.c_str(), &end, 10);
+            if (*end != 'x' || options.TileX == 0) {
+                throw CException("invalid value of option `" + argument + "`");
+            }
+            options.TileY = strtoul(end + 1, &end, 10);
+            if (*end != 0 || options.TileY == 0) {
+                throw CException("invalid value of option `" + argument + "`");
+            }
+        }
+    } else if (name == "weights") {
+        if (value == "axis") {
+            options.FullWeights = false;
+        } else if (value == "full") {
+            options.FullWeights = true;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "rhs") {
+        if (value == "eager") {
+            options.LazyRightHandSide = false;
+        } else if (value == "lazy") {
+            options.LazyRightHandSide = true;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "problem") {
+        if (value.empty()) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.ProblemFilename = value;
+    } else if (name == "simd") {
+        if (value == "auto") {
+            options.SimdLevel = SL_Auto;
+        } else if (value == "scalar") {
+            options.SimdLevel = SL_Scalar;
+        } else if (value == "avx2") {
+            options.SimdLevel = SL_Avx2;
+        } else if (value == "avx512") {
+            options.SimdLevel = SL_Avx512;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "deterministic") {
+        options.Deterministic = true;
+    } else if (name == "overlap") {
+        options.Overlap = true;
+    } else if (name == "preconditioner") {
+        if (value == "none") {
+            options.Preconditioner = PC_None;
+        } else if (value == "multigrid") {
+            options.Preconditioner = PC_Multigrid;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "mg-cycle") {
+        if (value == "v") {
+            options.MultigridCycle = MC_V;
+        } else if (value == "w") {
+            options.MultigridCycle = MC_W;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "mg-smoother") {
+        if (value == "jacobi") {
+            options.MultigridSmoother = MS_Jacobi;
+        } else if (value == "rbgs") {
+            options.MultigridSmoother = MS_RedBlack;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "mg-sweeps") {
+        const unsigned long sweeps = strtoul(value.c_str(), 0, 10);
+        if (sweeps == 0) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.MultigridSweeps = sweeps;
+    } else if (name == "first-touch") {
+        options.FirstTouch = true;
+    } else if (name == "affinity") {
+        options.ReportPlacement = true;
+    } else if (name == "output") {
+        if (value == "binary") {
+            options.OutputFormat = OF_Binary;
+        } else if (value == "text") {
+            options.OutputFormat = OF_Text;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "topology") {
+        if (value == "world") {
+            options.CartesianTopology = false;
+        } else if (value == "cart") {
+            options.CartesianTopology = true;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "exchange") {
+        if (value == "buffered") {
+            options.ExchangeMode = EM_Buffered;
+        } else if (value == "datatype") {
+            options.ExchangeMode = EM_Datatype;
+        } else if (value == "shared") {
+            options.ExchangeMode = EM_Shared;
+        } else if (value == "rma") {
+            options.ExchangeMode = EM_Rma;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "checkpoint") {
+        if (value.empty()) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.CheckpointFilename = value;
+    } else if (name == "checkpoint-every") {
+        const unsigned long every = strtoul(value.c_str(), 0, 10);
+        if (every == 0) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.CheckpointEvery = every;
+    } else if (name == "checkpoint-seconds") {
+        char *end = 0;
+        const double seconds = strtod(value.c_str(), &end);
+        if (value.empty() || *end != 0 || !(seconds > 0)) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.CheckpointSeconds = seconds;
+    } else if (name == "restart") {
+        if (value.empty()) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.RestartFilename = value;
+    } else if (name == "initial") {
+        if (value.empty()) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.InitialFilename = value;
+    } else if (name == "nested") {
+        char *end = 0;
+        options.NestedLevels = strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != 0) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "mixed-iterations") {
+        const unsigned long iterations = strtoul(value.c_str(), 0, 10);
+        if (iterations == 0) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.MixedIterations = iterations;
+    } else if (name == "mixed-reduction") {
+        char *end = 0;
+        const double reduction = strtod(value.c_str(), &end);
+        if (value.empty() || *end != 0 || !(reduction > 0 && reduction < 1)) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.MixedReduction = static_cast<NumericType>( reduction );
+    } else if (name == "profile") {
+        if (value.empty() || value == "text") {
+            options.ProfileFormat = PF_Text;
+        } else if (value == "json") {
+            options.ProfileFormat = PF_Json;
+        } else if (value == "csv") {
+            options.ProfileFormat = PF_Csv;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "profile-file") {
+        if (value.empty()) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.ProfileFilename = value;
+    } else if (name == "log-every") {
+        char *end = 0;
+        const unsigned long every = strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != 0 || every == 0) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.LogEvery = every;
+    } else if (name == "log-seconds") {
+        char *end = 0;
+        const double seconds = strtod(value.c_str(), &end);
+        if (value.empty() || *end != 0 || !(seconds > 0)) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.LogSeconds = seconds;
+    } else if (name == "history") {
+        if (value.empty()) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.HistoryFilename = value;
+    } else if (name == "history-format") {
+        if (value == "csv") {
+            options.HistoryFormat = HF_Csv;
+        } else if (value == "binary") {
+            options.HistoryFormat = HF_Binary;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "convergence") {
+        if (value == "every") {
+            options.ConvergenceCheck = CC_Every;
+        } else if (value == "periodic") {
+            options.ConvergenceCheck = CC_Periodic;
+        } else if (value == "adaptive") {
+            options.ConvergenceCheck = CC_Adaptive;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else if (name == "halo") {
+        char *end = 0;
+        const unsigned long width = strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != 0 || width == 0) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.HaloWidth = width;
+    } else if (name == "convergence-period") {
+        char *end = 0;
+        const unsigned long period = strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != 0 || period == 0) {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+        options.ConvergencePeriod = period;
+    } else if (name == "norm") {
+        if (value == "l2") {
+            options.Norm = N_Euclidean;
+        } else if (value == "max") {
+            options.Norm = N_Max;
+        } else {
+            throw CException("invalid value of option `" + argument + "`");
+        }
+    } else {
+        throw CException("unknown option `" + argument + "`");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,159 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Способ выполнения итерации.
+enum TIterationMode {
+	IM_Classic, // отдельные проходы CalcR/CalcAlpha/CalcG/CalcTau/CalcP
+	IM_Fused, // слитная итерация: два потоковых прохода по сетке
+	IM_Pipelined, // конвейерный метод сопряжённых градиентов: одна неблокирующая редукция на итерацию
+	IM_Multigrid, // многосеточные циклы (Multigrid.h) как самостоятельный метод
+	IM_Direct, // быстрая диагонализация (FastDiagonalization.h): p = p - A^-1 r, сходится за две итерации
+	IM_Mixed, // смешанная точность: поправка e из A e = r внутренними итерациями во float, r и p - в NumericType
+	IM_Chebyshev // полуитерации Чебышёва по границам спектра A: без скалярных произведений, один обмен p
+};
+
+// Формат файла результата.
+enum TOutputFormat {
+	OF_Binary, // один двоичный файл (BinaryDump.h), все процессы пишут свои блоки через MPI-IO
+	OF_Text // строки "x y значение", у каждого процесса свой файл с суффиксом-ранком, с "заездом"
+};
+
+// Предобусловливатель классической итерации.
+enum TPreconditioner {
+	PC_None,
+	PC_Multigrid // направление строится по z = M r, M - один многосеточный цикл
+};
+
+// Тип многосеточного цикла: сколько раз решается задача на следующем уровне.
+enum TMultigridCycle {
+	MC_V, // один раз
+	MC_W // дважды
+};
+
+// Сглаживатель многосеточного метода.
+enum TMultigridSmoother {
+	MS_Jacobi, // взвешенный Якоби, omega = 4/5
+	MS_RedBlack // красно-чёрный Гаусс - Зейдель (после спуска - в обратном порядке цветов)
+};
+
+// Способ обмена "заездами" между процессами.
+enum TExchangeMode {
+	EM_Buffered, // копирование полос в буферы, MPI_Isend/MPI_Irecv на каждом обмене
+	EM_Datatype, // производные типы MPI над CMatrix и постоянные запросы, без копирования
+	EM_Shared, // соседи по узлу читают полосы из окна общей памяти MPI-3, с другими узлами - как EM_Buffered
+	EM_Rma // односторонний MPI_Put полос в "заезд" соседа, синхронизация post/start/complete/wait с соседями
+};
+
+// Когда норма изменения p собирается со всех процессов для проверки сходимости (Convergence.h).
+enum TConvergenceCheck {
+	CC_Auto, // по умолчанию: CC_Periodic для IM_Chebyshev, у которой других редукций нет, иначе CC_Every
+	CC_Every, // на каждой итерации, блокирующим MPI_Allreduce
+	CC_Periodic, // раз в k итераций, MPI_Iallreduce завершается на следующей итерации
+	CC_Adaptive // как CC_Periodic, k подбирается по скорости сходимости, не больше заданного
+};
+
+// Набор инструкций для построчных ядер (SimdKernels.h).
+enum TSimdLevel {
+	SL_Auto, // лучший из поддерживаемых процессором (CPUID)
+	SL_Scalar, // переносимый скалярный код
+	SL_Avx2, // AVX2 + FMA, 4 числа double
+	SL_Avx512 // AVX-512F, 8 чисел double
+};
+
+// Формат сводки замеров по фазам (Profiler.h).
+enum TProfileFormat {
+	PF_None, // замеры выключены
+	PF_Text, // таблица для чтения
+	PF_Json,
+	PF_Csv
+};
+
+// Формат файла истории сходимости (IterationLog.h).
+enum THistoryFormat {
+	HF_Csv,
+	HF_Binary
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CSolverOptions { // параметры решателя, задаваемые в командной строке
+	TIterationMode IterationMode;
+	size_t TileX; // размер блока обхода матриц, 0 - автоматически
+	size_t TileY;
+	bool FullWeights; // хранить коэффициенты шаблона во всех узлах (CUniformGrid::Weights)
+	bool LazyRightHandSide; // заполнять таблицу F в первом проходе невязки, а не заранее
+	string ProblemFilename; // файл с таблицами F и Phi (CTableProblem), пусто - задача из Definitions.h
+	TSimdLevel SimdLevel; // набор инструкций построчных ядер
+	bool Deterministic; // суммы не зависят от числа потоков (CStencilEngine::SetDeterministic)
+	TNorm Norm; // норма изменения p для проверки сходимости
+	TConvergenceCheck ConvergenceCheck;
+	size_t ConvergencePeriod; // k для CC_Periodic, наибольший k для CC_Adaptive
+	bool Overlap; // считать глубину блока, пока идёт обмен "заездами" (только MPI)
+	TExchangeMode ExchangeMode; // способ обмена "заездами" (только MPI)
+	size_t HaloWidth; // ширина "заезда": обмен раз в HaloWidth проходов шаблона (больше 1 - только IM_Chebyshev)
+	bool CartesianTopology; // MPI_Cart_create: библиотека может перенумеровать процессы под топологию узлов
+	bool FirstTouch; // размещать страницы матриц из потоков, которые их обходят (CMatrix::SetFirstTouch)
+	bool ReportPlacement; // напечатать привязку процессов и потоков к ядрам при запуске
+	TOutputFormat OutputFormat;
+	TPreconditioner Preconditioner; // только для IM_Classic
+	TMultigridCycle MultigridCycle;
+	TMultigridSmoother MultigridSmoother;
+	size_t MultigridSweeps; // итераций сглаживателя до и после перехода на грубый уровень
+	string CheckpointFilename; // файл контрольной точки (Checkpoint.h), пусто - не сохранять
+	size_t CheckpointEvery; // сохранять каждые N итераций, 0 - не по числу итераций
+	double CheckpointSeconds; // сохранять каждые T секунд, 0 - не по времени
+	string RestartFilename; // продолжить с контрольной точки, пусто - начать с нулевой итерации
+	string InitialFilename; // начальное приближение из файла результата (InitialGuess.h), пусто - нули
+	size_t NestedLevels; // начальное приближение с грубой сетки: сколько раз сетка огрубляется вдвое
+	size_t MixedIterations; // IM_Mixed: не больше стольких внутренних итераций на одну поправку
+	NumericType MixedReduction; // IM_Mixed: внутренние итерации идут, пока шаг не станет во столько раз меньше наибольшего или меньше eps
+	TProfileFormat ProfileFormat; // сводка замеров по фазам (Profiler.h), PF_None - без замеров
+	string ProfileFilename; // файл сводки, пусто - стандартный вывод
+	size_t LogEvery; // журнал итераций (CLoggingIterationCallback): строка раз в N итераций, 0 - не по числу итераций
+	double LogSeconds; // строка раз в T секунд, 0 - не по времени; оба 0 - строка на каждую итерацию
+	string HistoryFilename; // история сходимости (IterationLog.h), пусто - не записывать
+	THistoryFormat HistoryFormat;
+
+	CSolverOptions() :
+		IterationMode( IM_Classic ),
+		TileX( 0 ),
+		TileY( 0 ),
+		FullWeights( false ),
+		LazyRightHandSide( false ),
+		SimdLevel( SL_Auto ),
+		Deterministic( false ),
+		Norm( N_Euclidean ),
+		ConvergenceCheck( CC_Auto ),
+		ConvergencePeriod( 10 ),
+		Overlap( false ),
+		ExchangeMode( EM_Buffered ),
+		HaloWidth( 1 ),
+		CartesianTopology( false ),
+		FirstTouch( false ),
+		ReportPlacement( false ),
+		OutputFormat( OF_Binary ),
+		Preconditioner( PC_None ),
+		MultigridCycle( MC_V ),
+		MultigridSmoother( MS_Jacobi ),
+		MultigridSweeps( 2 ),
+		CheckpointEvery( 0 ),
+		CheckpointSeconds( 0 ),
+		NestedLevels( 0 ),
+		MixedIterations( 10000 ),
+		MixedReduction( static_cast<NumericType>( 1e-4 ) ),
+		ProfileFormat( PF_None ),
+		LogEvery( 0 ),
+		LogSeconds( 0 ),
+		HistoryFormat( HF_Csv )
+	{
+	}
+};
+
+// Разбор одного параметра вида --name=value (или --name).
+void ParseOption( const string& argument, CSolverOptions& options );
+
+// Текст подсказки по параметрам.
+extern const char* const OptionsUsage;
+
+///////////////////////////////////////////////////////////////////////////////
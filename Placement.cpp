@@ -0,0 +1,89 @@
+#include <Std.h>
+#include <sched.h>
+#ifndef DIRCH_NO_OPENMP
+#include <omp.h>
+#endif
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <Placement.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CThreadPlacement { // где выполняется поток
+    int Cpu; // sched_getcpu, -1 - неизвестно
+    int Place; // omp_get_place_num, -1 - поток не привязан к месту
+};
+
+#ifndef DIRCH_NO_OPENMP
+static const char *ProcBindName(omp_proc_bind_t bind) {
+    switch (bind) {
+        case omp_proc_bind_false:
+            return "false";
+        case omp_proc_bind_true:
+            return "true";
+        case omp_proc_bind_master:
+            return "master";
+        case omp_proc_bind_close:
+            return "close";
+        case omp_proc_bind_spread:
+            return "spread";
+        default:
+            return "unknown";
+    }
+}
+#endif
+
+// Строки отчёта этого процесса.
+static string LocalPlacement() {
+    char host[MPI_MAX_PROCESSOR_NAME] = "";
+    int hostLength = 0;
+    MpiCheck(MPI_Get_processor_name(host, &hostLength), "MPI_Get_processor_name");
+
+    ostringstream out;
+    out << "(" << CMpiSupport::Rank() << ") host " << host;
+#ifndef DIRCH_NO_OPENMP
+    vector<CThreadPlacement> threads(omp_get_max_threads());
+#pragma omp parallel
+    {
+        CThreadPlacement &thread = threads[omp_get_thread_num()];
+        thread.Cpu = sched_getcpu();
+        thread.Place = omp_get_place_num();
+    }
+    const bool bound = (omp_get_proc_bind() != omp_proc_bind_false);
+    out << ", proc_bind " << ProcBindName(omp_get_proc_bind()) << ", places " << omp_get_num_places()
+        << ", threads " << threads.size() << "\n";
+    for (size_t i = 0; i < threads.size(); i++) {
+        out << "(" << CMpiSupport::Rank() << ")   thread " << i << ": cpu " << threads[i].Cpu
+            << ", place " << threads[i].Place << "\n";
+    }
+    if (!bound && CMatrix::FirstTouch()) {
+        out << "(" << CMpiSupport::Rank() << ")   warning: threads are not bound (set OMP_PROC_BIND and OMP_PLACES),"
+            << " first-touch placement is lost when a thread migrates\n";
+    }
+#else
+    out << ", cpu " << sched_getcpu() << ", no OpenMP\n";
+#endif
+    return out.str();
+}
+
+void ReportPlacement(ostream &out) {
+    const string local = LocalPlacement();
+    const int size = static_cast<int>( CMpiSupport::NumberOfProccess());
+    int length = static_cast<int>( local.size());
+    vector<int> lengths(size);
+    MpiCheck(MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, MPI_COMM_WORLD), "MPI_Gather");
+
+    vector<int> offsets(size, 0);
+    for (int i = 1; i < size; i++) {
+        offsets[i] = offsets[i - 1] + lengths[i - 1];
+    }
+    vector<char> text(size > 0 ? offsets[size - 1] + lengths[size - 1] + 1 : 1, '\0');
+    MpiCheck(MPI_Gatherv(const_cast<char *>( local.data()), length, MPI_CHAR,
+                         text.data(), lengths.data(), offsets.data(), MPI_CHAR, 0, MPI_COMM_WORLD), "MPI_Gatherv");
+    if (CMpiSupport::Rank() == 0) {
+        out << text.data() << flush;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,10 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Привязка процессов и потоков OpenMP к ядрам: для каждого ранка - узел, политика OMP_PROC_BIND,
+// число мест OMP_PLACES и для каждого потока ядро (sched_getcpu) и место (omp_get_place_num).
+// Коллективная операция: строки собираются на ранке 0 и печатаются в out в порядке ранков.
+void ReportPlacement( ostream& out );
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,97 @@
+#include <Std.h>
+#include <Errors.h>
+#include <Definitions.h>
+#include <Problem.h>
+#include <StencilEngine.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+CTableProblem::CTableProblem(const string &filename) :
+        area(0, 0, 0, 0) {
+    ifstream file(filename.c_str());
+    if (!file) {
+        throw CException("CTableProblem: cannot open `" + filename + "`");
+    }
+    stringstream input; // содержимое файла без комментариев
+    string line;
+    while (getline(file, line)) {
+        input << line.substr(0, line.find('#')) << '\n';
+    }
+
+    bool hasArea = false;
+    string section;
+    while (input >> section) {
+        if (section == "area") {
+            input >> area.X0 >> area.Xn >> area.Y0 >> area.Yn;
+            hasArea = true;
+        } else if (section == "f") {
+            readTable(input, f);
+        } else if (section == "phi") {
+            readTable(input, phi);
+        } else {
+            throw CException("CTableProblem: unknown section `" + section + "` in `" + filename + "`");
+        }
+        if (!input) {
+            throw CException("CTableProblem: bad section `" + section + "` in `" + filename + "`");
+        }
+    }
+    if (!hasArea || f.Values.empty() || phi.Values.empty()) {
+        throw CException("CTableProblem: `" + filename + "` must contain area, f and phi");
+    }
+    if (!(area.X0 < area.Xn && area.Y0 < area.Yn)) {
+        throw CException("CTableProblem: bad area in `" + filename + "`");
+    }
+}
+
+void CTableProblem::readTable(istream &input, CTable &table) {
+    input >> table.SizeX >> table.SizeY;
+    if (!input || table.SizeX < 2 || table.SizeY < 2) {
+        throw CException("CTableProblem: table must have at least 2 x 2 values");
+    }
+    table.Values.resize(table.SizeX * table.SizeY);
+    for (size_t i = 0; i < table.Values.size() && input; i++) {
+        input >> table.Values[i];
+    }
+}
+
+NumericType CTableProblem::CTable::Value(const CArea &area, NumericType x, NumericType y) const {
+    // положение точки в узлах таблицы, за пределами области - значение на краю
+    const NumericType tx = min(max((x - area.X0) / (area.Xn - area.X0), NumericType(0)), NumericType(1)) * (SizeX - 1);
+    const NumericType ty = min(max((y - area.Y0) / (area.Yn - area.Y0), NumericType(0)), NumericType(1)) * (SizeY - 1);
+    const size_t i = min(static_cast<size_t>( tx ), SizeX - 2);
+    const size_t j = min(static_cast<size_t>( ty ), SizeY - 2);
+    const NumericType u = tx - i;
+    const NumericType v = ty - j;
+    const NumericType *row = &Values[j * SizeX + i];
+    return (1 - v) * ((1 - u) * row[0] + u * row[1]) + v * ((1 - u) * row[SizeX] + u * row[SizeX + 1]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CFillRightHandSideKernel : public CStencilKernel {
+    const IProblem &problem;
+    const CUniformGrid &grid;
+    CRightHandSide &rhs;
+
+    CFillRightHandSideKernel(const IProblem &problem, const CUniformGrid &grid, CRightHandSide &rhs) :
+            problem(problem), grid(grid), rhs(rhs) {}
+
+    void Row(size_t y, size_t beginX, size_t endX) {
+        for (size_t x = beginX; x < endX; x++) {
+            rhs(x, y) = problem.F(grid.X[x], grid.Y[y]);
+        }
+    }
+};
+
+void CRightHandSide::Init(const IProblem &_problem, const CUniformGrid &grid, bool lazy) {
+    problem = &_problem;
+    values.Init(grid.X.Size(), grid.Y.Size());
+    ready = false;
+    if (!lazy) {
+        CFillRightHandSideKernel kernel(*problem, grid, *this);
+        RunStencil(InnerPart(values), kernel);
+        ready = true;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
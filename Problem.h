@@ -0,0 +1,98 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+class IProblem { // abstract class: задача u''xx + u''yy + F = 0, u = Phi на границе Area
+public:
+	virtual ~IProblem() {}
+
+	// Область решения задачи.
+	virtual CArea Area() const = 0;
+	// Правая часть.
+	virtual NumericType F( NumericType x, NumericType y ) const = 0;
+	// Граничная функция.
+	virtual NumericType Phi( NumericType x, NumericType y ) const = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CDefaultProblem : public IProblem { // implementation 1: задача из Definitions.h
+public:
+	virtual CArea Area() const { return ::Area; }
+	virtual NumericType F( NumericType x, NumericType y ) const { return ::F( x, y ); }
+	virtual NumericType Phi( NumericType x, NumericType y ) const { return ::Phi( x, y ); }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// implementation 2: F и Phi заданы таблицами на равномерной сетке области, между узлами -
+// билинейная интерполяция. Формат файла (текст, # - комментарий до конца строки):
+//   area X0 Xn Y0 Yn
+//   f NX NY
+//   NX * NY значений по строкам (y - внешний цикл)
+//   phi NX NY
+//   NX * NY значений
+class CTableProblem : public IProblem {
+public:
+	explicit CTableProblem( const string& filename );
+
+	virtual CArea Area() const { return area; }
+	virtual NumericType F( NumericType x, NumericType y ) const { return f.Value( area, x, y ); }
+	virtual NumericType Phi( NumericType x, NumericType y ) const { return phi.Value( area, x, y ); }
+
+private:
+	struct CTable {
+		size_t SizeX;
+		size_t SizeY;
+		vector<NumericType> Values;
+
+		CTable() : SizeX( 0 ), SizeY( 0 ) {}
+		NumericType Value( const CArea& area, NumericType x, NumericType y ) const;
+	};
+
+	CArea area;
+	CTable f;
+	CTable phi;
+
+	static void readTable( istream& input, CTable& table );
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CRightHandSide { // значения правой части F во внутренних узлах сетки, считаются один раз
+private:
+	CRightHandSide( const CRightHandSide& );
+	CRightHandSide& operator=( const CRightHandSide& );
+
+public:
+	CRightHandSide() :
+		problem( 0 ),
+		ready( false )
+	{
+	}
+	CRightHandSide( const IProblem& problem, const CUniformGrid& grid, bool lazy )
+	{
+		Init( problem, grid, lazy );
+	}
+
+	// lazy == false - таблица заполняется сразу, параллельно;
+	// lazy == true - в первом проходе вычисления невязки, без отдельного прохода по сетке.
+	void Init( const IProblem& problem, const CUniformGrid& grid, bool lazy );
+
+	const IProblem& Problem() const { return *problem; }
+	// false - значения ещё не посчитаны, их надо взять из Problem() и записать.
+	bool IsReady() const { return ready; }
+	void SetReady() { ready = true; }
+
+	NumericType& operator()( size_t x, size_t y ) { return values( x, y ); }
+	NumericType operator()( size_t x, size_t y ) const { return values( x, y ); }
+	const NumericType* Pointer( size_t x, size_t y ) const { return values.Pointer( x, y ); }
+	const CMatrix& Values() const { return values; } // таблица целиком (после заполнения)
+
+private:
+	const IProblem* problem;
+	CMatrix values;
+	bool ready;
+};
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,197 @@
+#include <Std.h>
+#include <iomanip>
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <Options.h>
+#include <Profiler.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Порядок - как в TProfilePhase. Для проходов значение - узел сетки, операции посчитаны
+// по скалярному коду SimdRow.h: оператор Лапласа - 12 операций, сумма с весом узла - 3.
+static const CPhaseModel PhaseModels[PP_Count] = {
+        {"CalcR", 3, 13}, // p, F -> r
+        {"CalcAlpha", 2, 30}, // r, g
+        {"CalcG", 3, 2}, // r, g -> g
+        {"CalcTau", 2, 18}, // r, g
+        {"CalcP", 3, 5}, // g, p -> p и нормы изменения
+        {"CalcResidual", 3, 13}, // u, f -> r
+        {"CalcJacobi", 3, 16}, // u, f -> result
+        {"CalcRedBlack", 3, 16}, // u, f -> u в узлах одного цвета
+        {"CalcDifference", 2, 4}, // a, b
+        {"CalcOperator", 2, 12}, // u -> result
+        {"CalcPipelined", 13, 24}, // 7 векторов читаются, 6 пишутся
+        {"CalcFusedR", 6, 20}, // p, g, Ag, F -> pNext, r
+        {"CalcFusedG", 5, 28}, // r, g, Ag -> g, Ag
+        {"Restriction", 5, 24}, // узел грубого уровня: 4 узла r мелкого -> f, до 3 x 3 весов
+        {"Prolongation", 3, 9}, // узел мелкого уровня: u, e -> u, в среднем 1.5 x 1.5 весов
+        {"Transform", 0, 2}, // значение - умножение-сложение плотного произведения, трафик не считается
+        {"ExchangeStart", 1, 0}, // отправляемые и принимаемые значения
+        {"ExchangeWait", 1, 0},
+        {"Allreduce", 1, 0},
+        {"CoarseGather", 1, 0}, // собранные значения
+        {"Transpose", 1, 0}, // отправляемые и принимаемые значения
+        {"Output", 1, 0},
+        {"Checkpoint", 1, 0}
+};
+
+bool CProfiler::enabled = false;
+double CProfiler::startTime = 0;
+CProfiler::CPhaseTotals CProfiler::totals[PP_Count];
+
+void CProfiler::Enable() {
+    enabled = true;
+    startTime = Now();
+}
+
+double CProfiler::Now() {
+    return MPI_Wtime();
+}
+
+const CPhaseModel &CProfiler::Model(TProfilePhase phase) {
+    return PhaseModels[phase];
+}
+
+void CProfiler::Add(TProfilePhase phase, double seconds, size_t values, size_t valueSize) {
+    CPhaseTotals &phaseTotals = totals[phase];
+    phaseTotals.Seconds += seconds;
+    phaseTotals.Calls += 1;
+    phaseTotals.Bytes += PhaseModels[phase].Values * static_cast<double>( values * valueSize );
+    phaseTotals.Flops += PhaseModels[phase].Flops * static_cast<double>( values );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CPhaseSummary { // фаза по всем процессам
+    string Name;
+    double Calls; // максимум по процессам
+    double Min;
+    double Average;
+    double Max;
+    double Bytes; // сумма по процессам
+    double Flops;
+
+    double Imbalance() const { return (Average > 0) ? Max / Average : 1; }
+
+    // Процессы работают одновременно: объём всех процессов за среднее время процесса.
+    double GigabytesPerSecond() const { return (Average > 0) ? Bytes / Average * 1e-9 : 0; }
+
+    double GigaflopsPerSecond() const { return (Average > 0) ? Flops / Average * 1e-9 : 0; }
+};
+
+static void WriteText(const vector<CPhaseSummary> &phases, size_t processes, ostream &out) {
+    const CPhaseSummary &total = phases.back();
+    out << "Profile (" << processes << " processes, seconds per process):\n";
+    out << left << setw(16) << "phase" << right << setw(10) << "calls" << setw(11) << "min" << setw(11) << "avg"
+        << setw(11) << "max" << setw(8) << "max/avg" << setw(8) << "share" << setw(10) << "GB/s"
+        << setw(10) << "GFLOP/s" << '\n';
+    for (size_t i = 0; i < phases.size(); i++) {
+        const CPhaseSummary &phase = phases[i];
+        if (phase.Calls == 0 && i + 1 < phases.size()) {
+            continue;
+        }
+        out << left << setw(16) << phase.Name << right << setw(10) << static_cast<unsigned long>( phase.Calls )
+            << fixed << setprecision(4) << setw(11) << phase.Min << setw(11) << phase.Average << setw(11)
+            << phase.Max << setprecision(2) << setw(8) << phase.Imbalance() << setprecision(1) << setw(7)
+            << (total.Average > 0 ? 100 * phase.Average / total.Average : 0) << '%'
+            << setprecision(2) << setw(10) << phase.GigabytesPerSecond() << setw(10)
+            << phase.GigaflopsPerSecond() << '\n';
+        out.unsetf(ios::floatfield);
+    }
+    out << flush;
+}
+
+static void WriteJson(const vector<CPhaseSummary> &phases, size_t processes, ostream &out) {
+    out << "{\n  \"processes\": " << processes << ",\n  \"phases\": [\n";
+    out << setprecision(9);
+    for (size_t i = 0; i < phases.size(); i++) {
+        const CPhaseSummary &phase = phases[i];
+        out << "    {\"name\": \"" << phase.Name << "\", \"calls\": " << phase.Calls
+            << ", \"min\": " << phase.Min << ", \"avg\": " << phase.Average << ", \"max\": " << phase.Max
+            << ", \"imbalance\": " << phase.Imbalance() << ", \"bytes\": " << phase.Bytes
+            << ", \"flops\": " << phase.Flops << ", \"gbps\": " << phase.GigabytesPerSecond()
+            << ", \"gflops\": " << phase.GigaflopsPerSecond() << "}" << (i + 1 < phases.size() ? "," : "") << '\n';
+    }
+    out << "  ]\n}\n" << flush;
+}
+
+static void WriteCsv(const vector<CPhaseSummary> &phases, size_t processes, ostream &out) {
+    out << "phase,processes,calls,min,avg,max,imbalance,bytes,flops,gbps,gflops\n";
+    out << setprecision(9);
+    for (size_t i = 0; i < phases.size(); i++) {
+        const CPhaseSummary &phase = phases[i];
+        out << phase.Name << ',' << processes << ',' << phase.Calls << ',' << phase.Min << ',' << phase.Average
+            << ',' << phase.Max << ',' << phase.Imbalance() << ',' << phase.Bytes << ',' << phase.Flops << ','
+            << phase.GigabytesPerSecond() << ',' << phase.GigaflopsPerSecond() << '\n';
+    }
+    out << flush;
+}
+
+void CProfiler::Report(TProfileFormat format, const string &filename) {
+    if (!enabled) {
+        return;
+    }
+    // Последнее значение каждого массива - общее время процесса с Enable.
+    const int count = PP_Count + 1;
+    vector<double> seconds(count);
+    vector<double> sums(3 * count); // время, байты, операции
+    vector<double> calls(count);
+    for (int i = 0; i < PP_Count; i++) {
+        seconds[i] = totals[i].Seconds;
+        sums[3 * i] = totals[i].Seconds;
+        sums[3 * i + 1] = totals[i].Bytes;
+        sums[3 * i + 2] = totals[i].Flops;
+        calls[i] = totals[i].Calls;
+    }
+    seconds[PP_Count] = Now() - startTime;
+    sums[3 * PP_Count] = seconds[PP_Count];
+    calls[PP_Count] = 1;
+
+    vector<double> minimums(count);
+    vector<double> maximums(count);
+    vector<double> totalSums(3 * count);
+    vector<double> maxCalls(count);
+    MpiCheck(MPI_Reduce(&seconds[0], &minimums[0], count, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD), "MPI_Reduce");
+    MpiCheck(MPI_Reduce(&seconds[0], &maximums[0], count, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD), "MPI_Reduce");
+    MpiCheck(MPI_Reduce(&sums[0], &totalSums[0], 3 * count, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD), "MPI_Reduce");
+    MpiCheck(MPI_Reduce(&calls[0], &maxCalls[0], count, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD), "MPI_Reduce");
+    if (CMpiSupport::Rank() != 0) {
+        return;
+    }
+
+    const size_t processes = CMpiSupport::NumberOfProccess();
+    vector<CPhaseSummary> phases(count);
+    for (int i = 0; i < count; i++) {
+        CPhaseSummary &phase = phases[i];
+        phase.Name = (i < PP_Count) ? PhaseModels[i].Name : "Total";
+        phase.Calls = maxCalls[i];
+        phase.Min = minimums[i];
+        phase.Average = totalSums[3 * i] / processes;
+        phase.Max = maximums[i];
+        phase.Bytes = totalSums[3 * i + 1];
+        phase.Flops = totalSums[3 * i + 2];
+    }
+
+    ofstream file;
+    if (!filename.empty()) {
+        file.open(filename.c_str());
+        if (!file) {
+            throw CException("cannot open `" + filename + "`");
+        }
+    }
+    ostream &out = filename.empty() ? cout : file;
+    switch (format) {
+        case PF_Json:
+            WriteJson(phases, processes, out);
+            break;
+        case PF_Csv:
+            WriteCsv(phases, processes, out);
+            break;
+        case PF_Text:
+        case PF_None:
+            WriteText(phases, processes, out);
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,110 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Замеры времени по фазам решения (--profile): каждый процесс копит своё время, число вызовов,
+// байты и операции по фазам, сводка собирается одной редукцией в конце. Барьеров нет:
+// время обмена и редукции включает ожидание соседей, из него и видна несбалансированность.
+// Выключенный замер стоит одной проверки флага на вызов прохода.
+
+enum TProfilePhase {
+	PP_CalcR,
+	PP_CalcAlpha,
+	PP_CalcG,
+	PP_CalcTau,
+	PP_CalcP,
+	PP_Residual, // CalcResidual
+	PP_Jacobi,
+	PP_RedBlack,
+	PP_Difference,
+	PP_Operator,
+	PP_Pipelined,
+	PP_FusedR,
+	PP_FusedG,
+	PP_Restriction, // многосеточный метод: сужение невязки на грубый уровень
+	PP_Prolongation, // многосеточный метод: продолжение поправки на мелкий уровень
+	PP_Transform, // быстрая диагонализация: умножение полос на матрицы собственных векторов оси
+	PP_ExchangeStart, // упаковка и отправка "заезда"
+	PP_ExchangeWait, // ожидание и распаковка "заезда"
+	PP_Allreduce, // суммы и нормы по всем процессам, для конвейерного метода - только ожидание
+	PP_CoarseGather, // многосеточный метод: сбор грубой задачи на каждом процессе (MPI_Allgatherv)
+	PP_Transpose, // быстрая диагонализация: перестановка полос между процессами (MPI_Alltoallv)
+	PP_Output, // файл результата
+	PP_Checkpoint, // запуск и окончание записи, чтение контрольной точки
+	PP_Count
+};
+
+struct CPhaseModel { // имя фазы и модель её трафика памяти и арифметики на одно значение
+	const char* Name;
+	double Values; // сколько значений читается и пишется (соседи по шаблону - из кэша)
+	double Flops;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CProfiler {
+private:
+	CProfiler();
+
+public:
+	// Начать замеры; от этого момента считается общее время процесса.
+	static void Enable();
+	static bool Enabled() { return enabled; }
+
+	static double Now(); // MPI_Wtime
+
+	// Модель фазы, по которой считаются ГБ/с и ГФлоп/с (её же берёт микробенчмарк).
+	static const CPhaseModel& Model( TProfilePhase phase );
+
+	// Учесть вызов фазы: values - сколько значений размера valueSize обработано
+	// (узлов для проходов, значений для обменов и файлов).
+	static void Add( TProfilePhase phase, double seconds, size_t values, size_t valueSize );
+
+	// Коллективная операция по MPI_COMM_WORLD: минимум, среднее и максимум времени по процессам,
+	// несбалансированность max / avg, ГБ/с и ГФлоп/с всех процессов вместе.
+	// Ранк 0 пишет сводку в файл filename (пусто - в cout).
+	static void Report( TProfileFormat format, const string& filename );
+
+private:
+	struct CPhaseTotals {
+		double Seconds;
+		double Calls;
+		double Bytes;
+		double Flops;
+	};
+
+	static bool enabled;
+	static double startTime;
+	static CPhaseTotals totals[PP_Count];
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CPhaseTimer { // замер одного вызова фазы, от конструктора до деструктора
+private:
+	CPhaseTimer( const CPhaseTimer& );
+	CPhaseTimer& operator=( const CPhaseTimer& );
+
+public:
+	explicit CPhaseTimer( TProfilePhase phase, size_t values = 0, size_t valueSize = sizeof( NumericType ) ) :
+		phase( phase ),
+		values( values ),
+		valueSize( valueSize ),
+		startTime( CProfiler::Enabled() ? CProfiler::Now() : 0 )
+	{
+	}
+	~CPhaseTimer()
+	{
+		if( CProfiler::Enabled() ) {
+			CProfiler::Add( phase, CProfiler::Now() - startTime, values, valueSize );
+		}
+	}
+
+private:
+	const TProfilePhase phase;
+	const size_t values;
+	const size_t valueSize;
+	const double startTime;
+};
+
+///////////////////////////////////////////////////////////////////////////////
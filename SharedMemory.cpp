@@ -0,0 +1,79 @@
+#include <Std.h>
+#include <MpiSupport.h>
+#include <SharedMemory.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+MPI_Comm CSharedMemory::nodeComm = MPI_COMM_NULL;
+map<const void *, MPI_Win> CSharedMemory::windows;
+vector<MPI_Win> CSharedMemory::created;
+
+MPI_Comm CSharedMemory::NodeComm() {
+    if (nodeComm == MPI_COMM_NULL) {
+        MpiCheck(MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm),
+                 "MPI_Comm_split_type");
+    }
+    return nodeComm;
+}
+
+int CSharedMemory::NodeSize() {
+    int size = 0;
+    MpiCheck(MPI_Comm_size(NodeComm(), &size), "MPI_Comm_size");
+    return size;
+}
+
+int CSharedMemory::NodeRank(MPI_Comm comm, int rank) {
+    MPI_Group group;
+    MPI_Group nodeGroup;
+    MpiCheck(MPI_Comm_group(comm, &group), "MPI_Comm_group");
+    MpiCheck(MPI_Comm_group(NodeComm(), &nodeGroup), "MPI_Comm_group");
+    int nodeRank = MPI_UNDEFINED;
+    MpiCheck(MPI_Group_translate_ranks(group, 1, &rank, nodeGroup, &nodeRank), "MPI_Group_translate_ranks");
+    MPI_Group_free(&nodeGroup);
+    MPI_Group_free(&group);
+    return nodeRank;
+}
+
+void *CSharedMemory::Place(void *values, size_t bytes, MPI_Win &window) {
+    map<const void *, MPI_Win>::const_iterator found = windows.find(values);
+    if (found != windows.end()) {
+        window = found->second;
+        return values;
+    }
+    // Несмежные сегменты: каждый процесс может разместить свой сегмент на своём узле памяти.
+    MPI_Info info;
+    MpiCheck(MPI_Info_create(&info), "MPI_Info_create");
+    MpiCheck(MPI_Info_set(info, const_cast<char *>( "alloc_shared_noncontig" ), const_cast<char *>( "true" )),
+             "MPI_Info_set");
+    void *base = 0;
+    const int result = MPI_Win_allocate_shared(static_cast<MPI_Aint>( bytes ), 1, info, NodeComm(), &base,
+                                               &window);
+    MPI_Info_free(&info);
+    MpiCheck(result, "MPI_Win_allocate_shared");
+    MpiCheck(MPI_Win_lock_all(MPI_MODE_NOCHECK, window), "MPI_Win_lock_all");
+    windows[base] = window;
+    created.push_back(window);
+    return base;
+}
+
+void *CSharedMemory::Segment(MPI_Win window, int nodeRank) {
+    MPI_Aint size = 0;
+    int unit = 0;
+    void *base = 0;
+    MpiCheck(MPI_Win_shared_query(window, nodeRank, &size, &unit, &base), "MPI_Win_shared_query");
+    return base;
+}
+
+void CSharedMemory::Finalize() {
+    for (vector<MPI_Win>::iterator window = created.begin(); window != created.end(); ++window) {
+        MPI_Win_unlock_all(*window);
+        MPI_Win_free(&*window);
+    }
+    created.clear();
+    windows.clear();
+    if (nodeComm != MPI_COMM_NULL) {
+        MPI_Comm_free(&nodeComm);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,39 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Окна общей памяти MPI-3 для обмена "заездами" между процессами одного узла (EM_Shared):
+// матрица переносится в свой сегмент окна, соседи по узлу читают её полосы прямо оттуда.
+// Окна создаются по процессам узла MPI_COMM_WORLD и живут до CMpiSupport::Finalize, так что
+// одну и ту же матрицу могут обменивать разные списки обменов (решатель и многосеточный метод).
+// В каждом окне открыта пассивная эпоха MPI_Win_lock_all: MPI_Win_sync - барьер памяти.
+class CSharedMemory {
+private:
+	CSharedMemory();
+
+public:
+	// Процессы узла: MPI_Comm_split_type( MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED ), создаётся при первом вызове.
+	static MPI_Comm NodeComm();
+	static int NodeSize();
+
+	// Ранк процесса rank коммуникатора comm в NodeComm, MPI_UNDEFINED - процесс на другом узле.
+	static int NodeRank( MPI_Comm comm, int rank );
+
+	// Окно, в котором лежат bytes байт с адреса values. Если values ещё не начало сегмента окна,
+	// окно выделяется коллективно по NodeComm - все процессы узла вызывают Place в одном порядке -
+	// и возвращается начало своего сегмента: туда нужно перенести значения. Иначе возвращается values.
+	static void* Place( void* values, size_t bytes, MPI_Win& window );
+
+	// Начало сегмента процесса nodeRank в окне window.
+	static void* Segment( MPI_Win window, int nodeRank );
+
+	// Освободить окна и NodeComm (коллективно по узлу). Матрицы в окнах после этого не читаются.
+	static void Finalize();
+
+private:
+	static MPI_Comm nodeComm;
+	static map<const void*, MPI_Win> windows; // по началу своего сегмента
+	static vector<MPI_Win> created; // в порядке создания: MPI_Win_free коллективен
+};
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,75 @@
+#include <Std.h>
+#include <Definitions.h>
+#include <Options.h>
+#include <SimdKernels.h>
+
+// Всё ниже собирается под AVX2 + FMA; вызывается только после проверки CPUID в CSimd::Select.
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include <immintrin.h>
+#include <SimdRow.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct CAvx2Ops { // 4 числа double
+    typedef __m256d Type;
+    static const size_t Size = 4;
+
+    static Type Load(const double *p) { return _mm256_loadu_pd(p); }
+    static Type Load(const float *p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+    static void Store(double *p, Type a) { _mm256_storeu_pd(p, a); }
+    static void Store(float *p, Type a) { _mm_storeu_ps(p, _mm256_cvtpd_ps(a)); }
+    static Type Set(double a) { return _mm256_set1_pd(a); }
+    static Type Add(Type a, Type b) { return _mm256_add_pd(a, b); }
+    static Type Sub(Type a, Type b) { return _mm256_sub_pd(a, b); }
+    static Type Mul(Type a, Type b) { return _mm256_mul_pd(a, b); }
+    static Type MulAdd(Type a, Type b, Type c) { return _mm256_fmadd_pd(a, b, c); }
+    static Type NegMulAdd(Type a, Type b, Type c) { return _mm256_fnmadd_pd(a, b, c); }
+    static Type Abs(Type a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); } // сбрасываем знаковый бит
+    static Type Max(Type a, Type b) { return _mm256_max_pd(a, b); }
+    static double Sum(Type a) { // фиксированный порядок: (0 + 2) + (1 + 3)
+        const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    }
+    static double MaxOf(Type a) {
+        const __m128d half = _mm_max_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+        return _mm_cvtsd_f64(_mm_max_sd(half, _mm_unpackhi_pd(half, half)));
+    }
+};
+
+} // namespace
+
+const CRowKernels *Avx2RowKernels() {
+    static const CRowKernels kernels = CRowKernelsT<CAvx2Ops>::Table("avx2");
+    return &kernels;
+}
+
+const CFloatRowKernels *Avx2FloatRowKernels() {
+    static const CFloatRowKernels kernels = CRowKernelsT<CAvx2Ops>::FloatTable("avx2");
+    return &kernels;
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#else
+
+const CRowKernels *Avx2RowKernels() {
+    return 0;
+}
+
+const CFloatRowKernels *Avx2FloatRowKernels() {
+    return 0;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
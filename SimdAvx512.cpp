@@ -0,0 +1,88 @@
+#include <Std.h>
+#include <Definitions.h>
+#include <Options.h>
+#include <SimdKernels.h>
+
+// Всё ниже собирается под AVX-512F; вызывается только после проверки CPUID в CSimd::Select.
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f")
+#endif
+
+#include <immintrin.h>
+#include <SimdRow.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct CAvx512Ops { // 8 чисел double
+    typedef __m512d Type;
+    static const size_t Size = 8;
+
+    static Type Load(const double *p) { return _mm512_loadu_pd(p); }
+    // Преобразования float <-> double - тоже с полной маской, как Max.
+    static Type Load(const float *p) { return _mm512_mask_cvtps_pd(_mm512_setzero_pd(), 0xFF, _mm256_loadu_ps(p)); }
+    static void Store(double *p, Type a) { _mm512_storeu_pd(p, a); }
+    static void Store(float *p, Type a) { _mm256_storeu_ps(p, _mm512_mask_cvtpd_ps(_mm256_setzero_ps(), 0xFF, a)); }
+    static Type Set(double a) { return _mm512_set1_pd(a); }
+    static Type Add(Type a, Type b) { return _mm512_add_pd(a, b); }
+    static Type Sub(Type a, Type b) { return _mm512_sub_pd(a, b); }
+    static Type Mul(Type a, Type b) { return _mm512_mul_pd(a, b); }
+    static Type MulAdd(Type a, Type b, Type c) { return _mm512_fmadd_pd(a, b, c); }
+    static Type NegMulAdd(Type a, Type b, Type c) { return _mm512_fnmadd_pd(a, b, c); }
+    static Type Abs(Type a) { return _mm512_abs_pd(a); }
+    // Полная маска и определённый операнд вместо неопределённого в _mm512_max_pd (-Wmaybe-uninitialized).
+    static Type Max(Type a, Type b) { return _mm512_mask_max_pd(a, 0xFF, a, b); }
+    // Свёртки без _mm512_reduce_*_pd и без выделения половин регистра: в GCC они идут через
+    // _mm512_extractf64x4_pd с неопределённым операндом и дают -Wuninitialized.
+    // Порядок как у _mm512_reduce_*_pd: половины, четверти, затем пара.
+    static double Sum(Type a) {
+        double lanes[Size];
+        _mm512_storeu_pd(lanes, a);
+        const double quarter[4] = {lanes[4] + lanes[0], lanes[5] + lanes[1], lanes[6] + lanes[2],
+                                   lanes[7] + lanes[3]};
+        return (quarter[2] + quarter[0]) + (quarter[3] + quarter[1]);
+    }
+    static double MaxOf(Type a) {
+        double lanes[Size];
+        _mm512_storeu_pd(lanes, a);
+        double result = lanes[0];
+        for (size_t i = 1; i < Size; i++) {
+            result = max(result, lanes[i]);
+        }
+        return result;
+    }
+};
+
+} // namespace
+
+const CRowKernels *Avx512RowKernels() {
+    static const CRowKernels kernels = CRowKernelsT<CAvx512Ops>::Table("avx512");
+    return &kernels;
+}
+
+const CFloatRowKernels *Avx512FloatRowKernels() {
+    static const CFloatRowKernels kernels = CRowKernelsT<CAvx512Ops>::FloatTable("avx512");
+    return &kernels;
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#else
+
+const CRowKernels *Avx512RowKernels() {
+    return 0;
+}
+
+const CFloatRowKernels *Avx512FloatRowKernels() {
+    return 0;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,54 @@
+#include <Std.h>
+#include <Errors.h>
+#include <Definitions.h>
+#include <Options.h>
+#include <SimdKernels.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+const CRowKernels *CSimd::kernels = ScalarRowKernels(); // до Select - переносимый код
+const CFloatRowKernels *CSimd::floatKernels = ScalarFloatRowKernels();
+
+bool CSimd::Supported(TSimdLevel level) {
+    switch (level) {
+        case SL_Auto:
+        case SL_Scalar:
+            return true;
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+        case SL_Avx2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case SL_Avx512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+void CSimd::Select(TSimdLevel level) {
+    if (level == SL_Auto) {
+        level = Supported(SL_Avx512) ? SL_Avx512 : (Supported(SL_Avx2) ? SL_Avx2 : SL_Scalar);
+    }
+    if (!Supported(level)) {
+        throw CException("CSimd: the instruction set is not supported by this processor");
+    }
+    if (sizeof(NumericType) != sizeof(double)) {
+        level = SL_Scalar; // векторные ядра написаны для double
+    }
+    switch (level) {
+        case SL_Avx2:
+            kernels = Avx2RowKernels();
+            floatKernels = Avx2FloatRowKernels();
+            break;
+        case SL_Avx512:
+            kernels = Avx512RowKernels();
+            floatKernels = Avx512FloatRowKernels();
+            break;
+        default:
+            kernels = ScalarRowKernels();
+            floatKernels = ScalarFloatRowKernels();
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,111 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+struct CStencilRowT { // отрезок строки матрицы для пятиточечного шаблона, указатели - на первый узел
+	const T* Center; // u(x, y)
+	const T* Up; // u(x, y - 1)
+	const T* Down; // u(x, y + 1)
+};
+
+typedef CStencilRowT<NumericType> CStencilRow;
+typedef CStencilRowT<float> CFloatStencilRow;
+
+struct CRowMetrics { // коэффициенты шаблона для отрезка строки
+	const NumericType* PrevX; // X.WeightPrev( x ), указатели - на первый узел
+	const NumericType* NextX; // X.WeightNext( x )
+	const NumericType* AverageStepX; // X.AverageStep( x )
+	NumericType PrevY; // Y.WeightPrev( y )
+	NumericType NextY; // Y.WeightNext( y )
+	NumericType AverageStepY; // Y.AverageStep( y )
+};
+
+struct CPipelinedRow { // отрезки строк векторов конвейерного метода, указатели - на первый узел
+	NumericType* P; // приближение
+	NumericType* R; // невязка r = A(p) - f
+	NumericType* Ar; // A r
+	NumericType* G; // направление g
+	NumericType* Ag; // A g
+	NumericType* Aag; // A(A g)
+	const NumericType* Aar; // A(A r), посчитанный ядром Apply
+};
+
+// Построчные ядра одного набора инструкций. Во всех n - длина отрезка, суммы прибавляются к sums.
+// Векторные реализации отличаются от скалярной только округлением (FMA и суммирование
+// по векторным дорожкам): суммы совпадают с относительной точностью порядка n * 1e-16,
+// итерации - с той же точностью, число итераций до DefaultEps может отличаться на 1-2.
+struct CRowKernels {
+	const char* Name;
+	// r = A(p) - f
+	void ( *Residual )( const CStencilRow& p, const CRowMetrics& m, const NumericType* f, size_t n,
+		NumericType* r );
+	// g = r - alpha * g
+	void ( *Direction )( const NumericType* r, NumericType alpha, size_t n, NumericType* g );
+	// p = p - tau * g; norms[0] += сумма квадратов изменений, norms[1] = max( norms[1], max |изменение| )
+	void ( *Update )( const NumericType* g, NumericType tau, size_t n, NumericType* p, NumericType* norms );
+	// sums[0] += (Ar, g), sums[1] += (Ag, g) с весами узлов
+	void ( *AlphaSums )( const CStencilRow& r, const CStencilRow& g, const CRowMetrics& m, size_t n,
+		NumericType* sums );
+	// sums[0] += (r, g), sums[1] += (Ag, g) с весами узлов
+	void ( *TauSums )( const NumericType* r, const CStencilRow& g, const CRowMetrics& m, size_t n,
+		NumericType* sums );
+	// pNext = p - tau * g, r = A(p) - tau * ag - f, возвращает (r, ag) с весами узлов
+	NumericType ( *FusedR )( const CStencilRow& p, const NumericType* g, const NumericType* ag,
+		NumericType tau, const CRowMetrics& m, const NumericType* f, size_t n,
+		NumericType* pNext, NumericType* r );
+	// g = r - alpha * g, ag = A(r) - alpha * ag;
+	// sums[0] += (r, g), sums[1] += (ag, g) с весами узлов, sums[2] += (g, g), sums[3] = max( sums[3], max |g| )
+	void ( *FusedG )( const CStencilRow& r, NumericType alpha, const CRowMetrics& m, size_t n,
+		NumericType* g, NumericType* ag, NumericType* sums );
+	// result = A(u)
+	void ( *Apply )( const CStencilRow& u, const CRowMetrics& m, size_t n, NumericType* result );
+	// Конвейерный метод: aag = aar + beta * aag, ag = ar + beta * ag, g = r + beta * g,
+	// p = p - alpha * g, r = r - alpha * ag, ar = ar - alpha * aag;
+	// sums[0] += (r, r), sums[1] += (ar, r) с весами узлов, sums[2] += (g, g), sums[3] = max( sums[3], max |g| )
+	void ( *Pipelined )( const CPipelinedRow& row, NumericType alpha, NumericType beta, const CRowMetrics& m,
+		size_t n, NumericType* sums );
+};
+
+// Ядра для матриц float (смешанная точность): значения читаются и пишутся во float,
+// арифметика и суммы идут в NumericType. Смысл - как у одноимённых ядер CRowKernels.
+struct CFloatRowKernels {
+	const char* Name;
+	void ( *Residual )( const CFloatStencilRow& p, const CRowMetrics& m, const float* f, size_t n, float* r );
+	void ( *Direction )( const float* r, NumericType alpha, size_t n, float* g );
+	void ( *Update )( const float* g, NumericType tau, size_t n, float* p, NumericType* norms );
+	void ( *AlphaSums )( const CFloatStencilRow& r, const CFloatStencilRow& g, const CRowMetrics& m, size_t n,
+		NumericType* sums );
+	void ( *TauSums )( const float* r, const CFloatStencilRow& g, const CRowMetrics& m, size_t n,
+		NumericType* sums );
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CSimd { // выбор набора инструкций при запуске
+private:
+	CSimd();
+
+public:
+	// Выбрать реализацию; бросает CException, если процессор не поддерживает level.
+	static void Select( TSimdLevel level );
+	static const CRowKernels& Kernels() { return *kernels; }
+	static const CFloatRowKernels& FloatKernels() { return *floatKernels; }
+
+	static bool Supported( TSimdLevel level );
+
+private:
+	static const CRowKernels* kernels;
+	static const CFloatRowKernels* floatKernels;
+};
+
+// Реализации, определены в SimdScalar.cpp, SimdAvx2.cpp, SimdAvx512.cpp
+// (векторные возвращают 0, если собраны не для x86).
+const CRowKernels* ScalarRowKernels();
+const CRowKernels* Avx2RowKernels();
+const CRowKernels* Avx512RowKernels();
+const CFloatRowKernels* ScalarFloatRowKernels();
+const CFloatRowKernels* Avx2FloatRowKernels();
+const CFloatRowKernels* Avx512FloatRowKernels();
+
+///////////////////////////////////////////////////////////////////////////////
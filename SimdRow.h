@@ -0,0 +1,309 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Шаблоны построчных ядер над операциями V с вектором из V::Size чисел NumericType:
+//   Type, Load, Store, Set, Add, Sub, Mul, MulAdd( a, b, c ) = a * b + c,
+//   NegMulAdd( a, b, c ) = c - a * b, Abs, Max, Sum( a ) и MaxOf( a ) - сумма и максимум дорожек.
+// Load и Store есть и для float: значения матриц float расширяются до NumericType при чтении
+// и округляются при записи, поэтому ядра с параметром T читают вдвое меньше памяти для float.
+// Основной цикл идёт векторами V, хвост отрезка - скалярно.
+// Файл подключается в SimdScalar.cpp, SimdAvx2.cpp и SimdAvx512.cpp после выбора набора
+// инструкций, поэтому всё здесь - в безымянном пространстве имён: каждая единица трансляции
+// получает свою копию, и компоновщик не подставит AVX-версию в скалярный код.
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CScalarOps {
+	typedef NumericType Type;
+	static const size_t Size = 1;
+
+	static Type Load( const NumericType* p ) { return *p; }
+	static Type Load( const float* p ) { return *p; }
+	static void Store( NumericType* p, Type a ) { *p = a; }
+	static void Store( float* p, Type a ) { *p = static_cast<float>( a ); }
+	static Type Set( NumericType a ) { return a; }
+	static Type Add( Type a, Type b ) { return a + b; }
+	static Type Sub( Type a, Type b ) { return a - b; }
+	static Type Mul( Type a, Type b ) { return a * b; }
+	static Type MulAdd( Type a, Type b, Type c ) { return a * b + c; }
+	static Type NegMulAdd( Type a, Type b, Type c ) { return c - a * b; }
+	static Type Abs( Type a ) { return fabs( a ); }
+	static Type Max( Type a, Type b ) { return ( a < b ) ? b : a; }
+	static NumericType Sum( Type a ) { return a; }
+	static NumericType MaxOf( Type a ) { return a; }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<class V, typename T>
+inline typename V::Type SimdLaplas( const CStencilRowT<T>& u, const CRowMetrics& m, size_t i,
+	typename V::Type prevY, typename V::Type nextY )
+{
+	const typename V::Type prevX = V::Load( m.PrevX + i );
+	const typename V::Type nextX = V::Load( m.NextX + i );
+	const typename V::Type centerWeight = V::Add( V::Add( prevX, nextX ), V::Add( prevY, nextY ) );
+	typename V::Type result = V::Mul( centerWeight, V::Load( u.Center + i ) );
+	result = V::NegMulAdd( prevX, V::Load( u.Center + i - 1 ), result );
+	result = V::NegMulAdd( nextX, V::Load( u.Center + i + 1 ), result );
+	result = V::NegMulAdd( prevY, V::Load( u.Up + i ), result );
+	result = V::NegMulAdd( nextY, V::Load( u.Down + i ), result );
+	return result;
+}
+
+// Обработать [i, n) векторами V, пока они помещаются; возвращает, где остановились.
+
+template<class V, typename T>
+size_t ResidualPart( const CStencilRowT<T>& p, const CRowMetrics& m, const T* f, size_t i, size_t n, T* r )
+{
+	const typename V::Type prevY = V::Set( m.PrevY );
+	const typename V::Type nextY = V::Set( m.NextY );
+	for( ; i + V::Size <= n; i += V::Size ) {
+		V::Store( r + i, V::Sub( SimdLaplas<V>( p, m, i, prevY, nextY ), V::Load( f + i ) ) );
+	}
+	return i;
+}
+
+template<class V, typename T>
+size_t DirectionPart( const T* r, NumericType alpha, size_t i, size_t n, T* g )
+{
+	const typename V::Type a = V::Set( alpha );
+	for( ; i + V::Size <= n; i += V::Size ) {
+		V::Store( g + i, V::NegMulAdd( a, V::Load( g + i ), V::Load( r + i ) ) );
+	}
+	return i;
+}
+
+template<class V, typename T>
+size_t UpdatePart( const T* g, NumericType tau, size_t i, size_t n, T* p, NumericType* norms )
+{
+	const typename V::Type t = V::Set( tau );
+	typename V::Type sum = V::Set( 0 );
+	typename V::Type maximum = V::Set( 0 );
+	for( ; i + V::Size <= n; i += V::Size ) {
+		const typename V::Type step = V::Mul( t, V::Load( g + i ) );
+		V::Store( p + i, V::Sub( V::Load( p + i ), step ) );
+		sum = V::MulAdd( step, step, sum );
+		maximum = V::Max( maximum, V::Abs( step ) );
+	}
+	norms[0] += V::Sum( sum );
+	norms[1] = max( norms[1], V::MaxOf( maximum ) );
+	return i;
+}
+
+template<class V, typename T>
+size_t AlphaPart( const CStencilRowT<T>& r, const CStencilRowT<T>& g, const CRowMetrics& m, size_t i, size_t n,
+	NumericType* sums )
+{
+	const typename V::Type prevY = V::Set( m.PrevY );
+	const typename V::Type nextY = V::Set( m.NextY );
+	const typename V::Type stepY = V::Set( m.AverageStepY );
+	typename V::Type numerator = V::Set( 0 );
+	typename V::Type denominator = V::Set( 0 );
+	for( ; i + V::Size <= n; i += V::Size ) {
+		const typename V::Type common =
+			V::Mul( V::Load( g.Center + i ), V::Mul( V::Load( m.AverageStepX + i ), stepY ) );
+		numerator = V::MulAdd( SimdLaplas<V>( r, m, i, prevY, nextY ), common, numerator );
+		denominator = V::MulAdd( SimdLaplas<V>( g, m, i, prevY, nextY ), common, denominator );
+	}
+	sums[0] += V::Sum( numerator );
+	sums[1] += V::Sum( denominator );
+	return i;
+}
+
+template<class V, typename T>
+size_t TauPart( const T* r, const CStencilRowT<T>& g, const CRowMetrics& m, size_t i, size_t n,
+	NumericType* sums )
+{
+	const typename V::Type prevY = V::Set( m.PrevY );
+	const typename V::Type nextY = V::Set( m.NextY );
+	const typename V::Type stepY = V::Set( m.AverageStepY );
+	typename V::Type numerator = V::Set( 0 );
+	typename V::Type denominator = V::Set( 0 );
+	for( ; i + V::Size <= n; i += V::Size ) {
+		const typename V::Type common =
+			V::Mul( V::Load( g.Center + i ), V::Mul( V::Load( m.AverageStepX + i ), stepY ) );
+		numerator = V::MulAdd( V::Load( r + i ), common, numerator );
+		denominator = V::MulAdd( SimdLaplas<V>( g, m, i, prevY, nextY ), common, denominator );
+	}
+	sums[0] += V::Sum( numerator );
+	sums[1] += V::Sum( denominator );
+	return i;
+}
+
+template<class V>
+size_t FusedRPart( const CStencilRow& p, const NumericType* g, const NumericType* ag, NumericType tau,
+	const CRowMetrics& m, const NumericType* f, size_t i, size_t n, NumericType* pNext, NumericType* r,
+	NumericType& numerator )
+{
+	const typename V::Type prevY = V::Set( m.PrevY );
+	const typename V::Type nextY = V::Set( m.NextY );
+	const typename V::Type stepY = V::Set( m.AverageStepY );
+	const typename V::Type t = V::Set( tau );
+	typename V::Type sum = V::Set( 0 );
+	for( ; i + V::Size <= n; i += V::Size ) {
+		const typename V::Type agi = V::Load( ag + i );
+		V::Store( pNext + i, V::NegMulAdd( t, V::Load( g + i ), V::Load( p.Center + i ) ) );
+		const typename V::Type residual =
+			V::Sub( V::NegMulAdd( t, agi, SimdLaplas<V>( p, m, i, prevY, nextY ) ), V::Load( f + i ) );
+		V::Store( r + i, residual );
+		sum = V::MulAdd( V::Mul( residual, agi ), V::Mul( V::Load( m.AverageStepX + i ), stepY ), sum );
+	}
+	numerator += V::Sum( sum );
+	return i;
+}
+
+template<class V>
+size_t FusedGPart( const CStencilRow& r, NumericType alpha, const CRowMetrics& m, size_t i, size_t n,
+	NumericType* g, NumericType* ag, NumericType* sums )
+{
+	const typename V::Type prevY = V::Set( m.PrevY );
+	const typename V::Type nextY = V::Set( m.NextY );
+	const typename V::Type stepY = V::Set( m.AverageStepY );
+	const typename V::Type a = V::Set( alpha );
+	typename V::Type numerator = V::Set( 0 );
+	typename V::Type denominator = V::Set( 0 );
+	typename V::Type squares = V::Set( 0 );
+	typename V::Type maximum = V::Set( 0 );
+	for( ; i + V::Size <= n; i += V::Size ) {
+		const typename V::Type ri = V::Load( r.Center + i );
+		const typename V::Type gi = V::NegMulAdd( a, V::Load( g + i ), ri );
+		const typename V::Type agi = V::NegMulAdd( a, V::Load( ag + i ), SimdLaplas<V>( r, m, i, prevY, nextY ) );
+		V::Store( g + i, gi );
+		V::Store( ag + i, agi );
+		const typename V::Type common = V::Mul( gi, V::Mul( V::Load( m.AverageStepX + i ), stepY ) );
+		numerator = V::MulAdd( ri, common, numerator );
+		denominator = V::MulAdd( agi, common, denominator );
+		squares = V::MulAdd( gi, gi, squares );
+		maximum = V::Max( maximum, V::Abs( gi ) );
+	}
+	sums[0] += V::Sum( numerator );
+	sums[1] += V::Sum( denominator );
+	sums[2] += V::Sum( squares );
+	sums[3] = max( sums[3], V::MaxOf( maximum ) );
+	return i;
+}
+
+template<class V>
+size_t ApplyPart( const CStencilRow& u, const CRowMetrics& m, size_t i, size_t n, NumericType* result )
+{
+	const typename V::Type prevY = V::Set( m.PrevY );
+	const typename V::Type nextY = V::Set( m.NextY );
+	for( ; i + V::Size <= n; i += V::Size ) {
+		V::Store( result + i, SimdLaplas<V>( u, m, i, prevY, nextY ) );
+	}
+	return i;
+}
+
+template<class V>
+size_t PipelinedPart( const CPipelinedRow& row, NumericType alpha, NumericType beta, const CRowMetrics& m,
+	size_t i, size_t n, NumericType* sums )
+{
+	const typename V::Type stepY = V::Set( m.AverageStepY );
+	const typename V::Type a = V::Set( alpha );
+	const typename V::Type b = V::Set( beta );
+	typename V::Type rr = V::Set( 0 );
+	typename V::Type arr = V::Set( 0 );
+	typename V::Type squares = V::Set( 0 );
+	typename V::Type maximum = V::Set( 0 );
+	for( ; i + V::Size <= n; i += V::Size ) {
+		const typename V::Type aag = V::MulAdd( b, V::Load( row.Aag + i ), V::Load( row.Aar + i ) );
+		const typename V::Type ag = V::MulAdd( b, V::Load( row.Ag + i ), V::Load( row.Ar + i ) );
+		const typename V::Type g = V::MulAdd( b, V::Load( row.G + i ), V::Load( row.R + i ) );
+		const typename V::Type r = V::NegMulAdd( a, ag, V::Load( row.R + i ) );
+		const typename V::Type ar = V::NegMulAdd( a, aag, V::Load( row.Ar + i ) );
+		V::Store( row.Aag + i, aag );
+		V::Store( row.Ag + i, ag );
+		V::Store( row.G + i, g );
+		V::Store( row.P + i, V::NegMulAdd( a, g, V::Load( row.P + i ) ) );
+		V::Store( row.R + i, r );
+		V::Store( row.Ar + i, ar );
+		const typename V::Type common = V::Mul( r, V::Mul( V::Load( m.AverageStepX + i ), stepY ) );
+		rr = V::MulAdd( r, common, rr );
+		arr = V::MulAdd( ar, common, arr );
+		squares = V::MulAdd( g, g, squares );
+		maximum = V::Max( maximum, V::Abs( g ) );
+	}
+	sums[0] += V::Sum( rr );
+	sums[1] += V::Sum( arr );
+	sums[2] += V::Sum( squares );
+	sums[3] = max( sums[3], V::MaxOf( maximum ) );
+	return i;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Полные ядра отрезка: векторная часть V и скалярный хвост.
+// Ядра с параметром T входят и в таблицу CRowKernels (T = NumericType), и в CFloatRowKernels (T = float).
+template<class V>
+struct CRowKernelsT {
+	template<typename T>
+	static void Residual( const CStencilRowT<T>& p, const CRowMetrics& m, const T* f, size_t n, T* r )
+	{
+		ResidualPart<CScalarOps>( p, m, f, ResidualPart<V>( p, m, f, 0, n, r ), n, r );
+	}
+	template<typename T>
+	static void Direction( const T* r, NumericType alpha, size_t n, T* g )
+	{
+		DirectionPart<CScalarOps>( r, alpha, DirectionPart<V>( r, alpha, 0, n, g ), n, g );
+	}
+	template<typename T>
+	static void Update( const T* g, NumericType tau, size_t n, T* p, NumericType* norms )
+	{
+		UpdatePart<CScalarOps>( g, tau, UpdatePart<V>( g, tau, 0, n, p, norms ), n, p, norms );
+	}
+	template<typename T>
+	static void AlphaSums( const CStencilRowT<T>& r, const CStencilRowT<T>& g, const CRowMetrics& m, size_t n,
+		NumericType* sums )
+	{
+		AlphaPart<CScalarOps>( r, g, m, AlphaPart<V>( r, g, m, 0, n, sums ), n, sums );
+	}
+	template<typename T>
+	static void TauSums( const T* r, const CStencilRowT<T>& g, const CRowMetrics& m, size_t n,
+		NumericType* sums )
+	{
+		TauPart<CScalarOps>( r, g, m, TauPart<V>( r, g, m, 0, n, sums ), n, sums );
+	}
+	static NumericType FusedR( const CStencilRow& p, const NumericType* g, const NumericType* ag,
+		NumericType tau, const CRowMetrics& m, const NumericType* f, size_t n,
+		NumericType* pNext, NumericType* r )
+	{
+		NumericType numerator = 0;
+		const size_t i = FusedRPart<V>( p, g, ag, tau, m, f, 0, n, pNext, r, numerator );
+		FusedRPart<CScalarOps>( p, g, ag, tau, m, f, i, n, pNext, r, numerator );
+		return numerator;
+	}
+	static void FusedG( const CStencilRow& r, NumericType alpha, const CRowMetrics& m, size_t n,
+		NumericType* g, NumericType* ag, NumericType* sums )
+	{
+		FusedGPart<CScalarOps>( r, alpha, m, FusedGPart<V>( r, alpha, m, 0, n, g, ag, sums ), n, g, ag, sums );
+	}
+
+	static void Apply( const CStencilRow& u, const CRowMetrics& m, size_t n, NumericType* result )
+	{
+		ApplyPart<CScalarOps>( u, m, ApplyPart<V>( u, m, 0, n, result ), n, result );
+	}
+	static void Pipelined( const CPipelinedRow& row, NumericType alpha, NumericType beta, const CRowMetrics& m,
+		size_t n, NumericType* sums )
+	{
+		PipelinedPart<CScalarOps>( row, alpha, beta, m, PipelinedPart<V>( row, alpha, beta, m, 0, n, sums ), n, sums );
+	}
+
+	static CRowKernels Table( const char* name )
+	{
+		CRowKernels kernels = { name, Residual<NumericType>, Direction<NumericType>, Update<NumericType>,
+			AlphaSums<NumericType>, TauSums<NumericType>, FusedR, FusedG, Apply, Pipelined };
+		return kernels;
+	}
+	static CFloatRowKernels FloatTable( const char* name )
+	{
+		CFloatRowKernels kernels = { name, Residual<float>, Direction<float>, Update<float>, AlphaSums<float>,
+			TauSums<float> };
+		return kernels;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // namespace
@@ -0,0 +1,19 @@
+#include <Std.h>
+#include <Definitions.h>
+#include <Options.h>
+#include <SimdKernels.h>
+#include <SimdRow.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+const CRowKernels *ScalarRowKernels() {
+    static const CRowKernels kernels = CRowKernelsT<CScalarOps>::Table("scalar");
+    return &kernels;
+}
+
+const CFloatRowKernels *ScalarFloatRowKernels() {
+    static const CFloatRowKernels kernels = CRowKernelsT<CScalarOps>::FloatTable("scalar");
+    return &kernels;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,64 @@
+#include <Std.h>
+#include <unistd.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <StencilEngine.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+CTileSize CStencilEngine::tileSize; // по умолчанию - автоматический подбор
+bool CStencilEngine::deterministic = false;
+
+size_t CStencilEngine::cacheSize() {
+    static size_t size = 0;
+    if (size == 0) {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        const long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        size = (l2 > 0) ? static_cast<size_t>( l2 ) : 0;
+#endif
+        if (size == 0) {
+            size = 256 * 1024; // неизвестно - берём типичный размер
+        }
+    }
+    return size;
+}
+
+CTileSize CStencilEngine::TileSize(size_t sizeX, size_t sizeY) {
+    // Ядра читают до четырёх матриц, у шаблона - по три строки. Половина L2 должна вмещать
+    // три строки блока каждой матрицы, тогда соседние строки шаблона не вытесняются из кэша.
+    const size_t streams = 4;
+    const size_t budget = cacheSize() / 2;
+    CTileSize tile = tileSize;
+    if (tile.X == 0) {
+        tile.X = max<size_t>(64, budget / (3 * streams * sizeof(NumericType)));
+    }
+    if (tile.Y == 0) {
+        tile.Y = max<size_t>(1, budget / (min(tile.X, sizeX) * streams * sizeof(NumericType)));
+    }
+    tile.X = min(tile.X, sizeX);
+    tile.Y = min(tile.Y, sizeY);
+    return tile;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SplitInnerPart(const CMatrixPart &inner, CMatrixPart &deep, vector<CMatrixPart> &ring) {
+    ring.clear();
+    if (inner.SizeX() < 3 || inner.SizeY() < 3) {
+        deep = CMatrixPart();
+        ring.push_back(inner);
+        return;
+    }
+    deep = CMatrixPart(inner.BeginX + 1, inner.EndX - 1, inner.BeginY + 1, inner.EndY - 1);
+    CMatrixPart strip;
+    strip.SetRow(inner.BeginX, inner.EndX, inner.BeginY); // верхняя строка целиком
+    ring.push_back(strip);
+    strip.SetColumn(inner.BeginX, deep.BeginY, deep.EndY); // левый и правый столбцы без углов
+    ring.push_back(strip);
+    strip.SetColumn(inner.EndX - 1, deep.BeginY, deep.EndY);
+    ring.push_back(strip);
+    strip.SetRow(inner.BeginX, inner.EndX, inner.EndY - 1); // нижняя строка целиком
+    ring.push_back(strip);
+}
+
+///////////////////////////////////////////////////////////////////////////////
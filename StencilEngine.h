@@ -0,0 +1,119 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CTileSize { // размер блока обхода в узлах сетки (0 - подбирается автоматически)
+	size_t X;
+	size_t Y;
+
+	explicit CTileSize( size_t x = 0, size_t y = 0 ) :
+		X( x ), Y( y )
+	{
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CStencilEngine { // параметры обхода матриц блоками
+private:
+	CStencilEngine();
+
+public:
+	// Задать размер блока; нулевые размеры подбираются по размеру кэша.
+	static void SetTileSize( const CTileSize& size ) { tileSize = size; }
+	// Размер блока для обхода области sizeX x sizeY.
+	static CTileSize TileSize( size_t sizeX, size_t sizeY );
+
+	// Детерминированное суммирование: суммы каждого блока складываются в порядке блоков,
+	// результат не зависит от числа потоков и от того, какой поток какой блок обработал.
+	static void SetDeterministic( bool value ) { deterministic = value; }
+	static bool Deterministic() { return deterministic; }
+
+private:
+	static CTileSize tileSize;
+	static bool deterministic;
+
+	static size_t cacheSize(); // размер кэша L2 на ядро в байтах
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CStencilKernel { // база ядер без сумм
+public:
+	void Join( const CStencilKernel& ) {}
+};
+
+// Обработать блок номер t.
+template<class TKernel>
+inline void RunTile( const CMatrixPart& part, const CTileSize& tile, long tilesX, long t, TKernel& kernel )
+{
+	const size_t beginY = part.BeginY + static_cast<size_t>( t / tilesX ) * tile.Y;
+	const size_t endY = min( beginY + tile.Y, part.EndY );
+	const size_t beginX = part.BeginX + static_cast<size_t>( t % tilesX ) * tile.X;
+	const size_t endX = min( beginX + tile.X, part.EndX );
+	for( size_t y = beginY; y < endY; y++ ) {
+		kernel.Row( y, beginX, endX );
+	}
+}
+
+// Обход области part блоками в порядке хранения CMatrix (y - внешний цикл, x - внутренний).
+// Ядро должно уметь:
+//   void Row( size_t y, size_t beginX, size_t endX ) - обработать отрезок строки [beginX, endX);
+//   void Join( const TKernel& other ) - прибавить суммы, накопленные копией ядра в другом потоке.
+// Каждый поток (блок при детерминированном суммировании) работает со своей копией ядра,
+// поэтому суммы в kernel до вызова должны быть нулевыми.
+template<class TKernel>
+void RunStencil( const CMatrixPart& part, TKernel& kernel )
+{
+	if( part.Size() == 0 ) {
+		return;
+	}
+	const CTileSize tile = CStencilEngine::TileSize( part.SizeX(), part.SizeY() );
+	const long tilesX = static_cast<long>( ( part.SizeX() + tile.X - 1 ) / tile.X );
+	const long tilesY = static_cast<long>( ( part.SizeY() + tile.Y - 1 ) / tile.Y );
+	const long tiles = tilesX * tilesY;
+	if( CStencilEngine::Deterministic() ) {
+		vector<TKernel> partials( tiles, kernel );
+#ifndef DIRCH_NO_OPENMP
+#pragma omp parallel for schedule( static )
+#endif
+		for( long t = 0; t < tiles; t++ ) {
+			RunTile( part, tile, tilesX, t, partials[t] );
+		}
+		for( long t = 0; t < tiles; t++ ) {
+			kernel.Join( partials[t] );
+		}
+		return;
+	}
+#ifndef DIRCH_NO_OPENMP
+#pragma omp parallel
+#endif
+	{
+		TKernel local( kernel );
+#ifndef DIRCH_NO_OPENMP
+		// static - то же распределение блоков по потокам на каждом проходе
+#pragma omp for schedule( static )
+#endif
+		for( long t = 0; t < tiles; t++ ) {
+			RunTile( part, tile, tilesX, t, local );
+		}
+#ifndef DIRCH_NO_OPENMP
+#pragma omp critical
+#endif
+		kernel.Join( local );
+	}
+}
+
+// Внутренние точки матрицы.
+template<typename T>
+inline CMatrixPart InnerPart( const CMatrixT<T>& matrix )
+{
+	return CMatrixPart( 1, matrix.SizeX() - 1, 1, matrix.SizeY() - 1 );
+}
+
+// Разбиение внутренних точек inner на глубину deep, шаблон которой не задевает "заезд",
+// и кольцо ring шириной в один узел вдоль "заезда" (до 4 полос).
+// Если inner уже трёх узлов, deep пуста, а ring - вся inner.
+void SplitInnerPart( const CMatrixPart& inner, CMatrixPart& deep, vector<CMatrixPart>& ring );
+
+///////////////////////////////////////////////////////////////////////////////
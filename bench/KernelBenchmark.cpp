@@ -0,0 +1,369 @@
+// Микробенчмарк проходов и обменов на одном процессе: для каждой сетки N x N из --sizes каждый замер
+// повторяется, пока не наберётся --min-time секунд. Результат - CSV со столбцами
+//   version,benchmark,points_x,points_y,threads,simd,seconds,ns_per_value,gbps,gflops
+// seconds - время одного вызова. Значение для проходов - внутренний узел сетки, для обменов - отправленное
+// или принятое число "заезда". ГБ/с и ГФлоп/с - по модели фаз CProfiler (Profiler.h).
+// Проходы смешанной точности над матрицами float - с суффиксом Float, ГБ/с - по 4 байта на значение.
+// Обмен ExchangeRma замеряется только с --exchange=rma. Файлы двух версий сравнивает bench/compare.sh.
+//
+//   dirch-bench [--sizes=64,128,...] [--min-time=SECONDS] [--label=VERSION] [--output=FILE] [OPTIONS dirch]
+
+#include <Std.h>
+#include <iomanip>
+#ifndef DIRCH_NO_OPENMP
+#include <omp.h>
+#endif
+#include <MpiSupport.h>
+#include <Definitions.h>
+#include <MathObjects.h>
+#include <Problem.h>
+#include <MathFunctions.h>
+#include <StencilEngine.h>
+#include <Options.h>
+#include <SimdKernels.h>
+#include <Profiler.h>
+#include <Exchange.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CBenchData { // сетка и матрицы одного размера, общие для всех замеров
+    CUniformGrid grid;
+    CRightHandSide rhs;
+    CMatrix p;
+    CMatrix r;
+    CMatrix g;
+    CMatrix ag;
+    CFloatMatrix floatP; // те же значения во float
+    CFloatMatrix floatR;
+    CFloatMatrix floatG;
+    CFloatMatrix floatS;
+
+    CBenchData(const IProblem &problem, size_t points, bool fullWeights) {
+        const CArea area = problem.Area();
+        grid.X.Init(area.X0, area.Xn, points);
+        grid.Y.Init(area.Y0, area.Yn, points);
+        if (fullWeights) {
+            grid.InitWeights();
+        }
+        rhs.Init(problem, grid, false);
+        p.Init(points, points);
+        r.Init(points, points);
+        g.Init(points, points);
+        ag.Init(points, points);
+        for (size_t y = 0; y < points; y++) { // гладкие ненулевые значения: без денормализованных чисел
+            for (size_t x = 0; x < points; x++) {
+                p(x, y) = problem.Phi(grid.X[x], grid.Y[y]);
+                r(x, y) = static_cast<NumericType>( 1 + 0.5 * sin(0.01 * (x + 2 * y)));
+                g(x, y) = static_cast<NumericType>( 1 + 0.5 * cos(0.01 * (2 * x + y)));
+            }
+        }
+        ConvertMatrix(p, floatP);
+        ConvertMatrix(r, floatR);
+        ConvertMatrix(g, floatG);
+        floatS.Init(points, points);
+    }
+};
+
+class IBenchmark { // один замер: Run вызывается много раз
+public:
+    virtual ~IBenchmark() {}
+
+    virtual const char *Name() const = 0;
+
+    virtual CPhaseModel Model() const = 0; // значения и операции на одно значение
+
+    virtual size_t Values() const = 0; // сколько значений обрабатывает один вызов
+
+    virtual size_t ValueBytes() const { return sizeof(NumericType); }
+
+    virtual void Run() = 0;
+};
+
+// Проход над внутренними узлами сетки с моделью фазы профилировщика.
+class CKernelBenchmark : public IBenchmark {
+public:
+    CKernelBenchmark(CBenchData &data, TProfilePhase phase) : data(data), phase(phase) {}
+
+    virtual const char *Name() const { return CProfiler::Model(phase).Name; }
+
+    virtual CPhaseModel Model() const { return CProfiler::Model(phase); }
+
+    virtual size_t Values() const { return InnerPart(data.p).Size(); }
+
+    virtual void Run() {
+        switch (phase) {
+            case PP_CalcR:
+                CalcR(data.p, data.grid, data.rhs, data.r);
+                break;
+            case PP_CalcAlpha:
+                sink += CalcAlpha(data.r, data.g, data.grid).Numerator;
+                break;
+            case PP_CalcTau:
+                sink += CalcTau(data.r, data.g, data.grid).Numerator;
+                break;
+            case PP_CalcG: // g = r - 0 * g: значения не растут от вызова к вызову
+                CalcG(data.r, 0, data.g);
+                break;
+            case PP_CalcP: // p = p - 0 * g
+                sink += CalcP(data.g, 0, data.p).Squares;
+                break;
+            case PP_Operator:
+                CalcOperator(data.r, data.grid, data.ag);
+                break;
+            default:
+                throw CException("no benchmark for this phase");
+        }
+    }
+
+    static volatile NumericType sink; // результаты сумм, чтобы проходы не выбрасывались
+
+private:
+    CBenchData &data;
+    const TProfilePhase phase;
+};
+
+volatile NumericType CKernelBenchmark::sink = 0;
+
+// Те же проходы над матрицами float (внутренние итерации --iteration=mixed).
+class CFloatKernelBenchmark : public IBenchmark {
+public:
+    CFloatKernelBenchmark(CBenchData &data, TProfilePhase phase) : data(data), phase(phase) {
+        name = string(CProfiler::Model(phase).Name) + "Float";
+    }
+
+    virtual const char *Name() const { return name.c_str(); }
+
+    virtual CPhaseModel Model() const { return CProfiler::Model(phase); }
+
+    virtual size_t Values() const { return InnerPart(data.floatP).Size(); }
+
+    virtual size_t ValueBytes() const { return sizeof(float); }
+
+    virtual void Run() {
+        switch (phase) {
+            case PP_Residual:
+                CalcResidual(data.floatP, data.floatR, data.grid, data.floatS);
+                break;
+            case PP_CalcAlpha:
+                CKernelBenchmark::sink += CalcAlpha(data.floatR, data.floatG, data.grid).Numerator;
+                break;
+            case PP_CalcTau:
+                CKernelBenchmark::sink += CalcTau(data.floatR, data.floatG, data.grid).Numerator;
+                break;
+            case PP_CalcG:
+                CalcG(data.floatR, 0, data.floatG);
+                break;
+            case PP_CalcP:
+                CKernelBenchmark::sink += CalcP(data.floatG, 0, data.floatP).Squares;
+                break;
+            default:
+                throw CException("no benchmark for this phase");
+        }
+    }
+
+private:
+    CBenchData &data;
+    const TProfilePhase phase;
+    string name;
+};
+
+// Поточечный LaplasOperator, как в ядрах с полной таблицей коэффициентов, без потоков.
+class CLaplasBenchmark : public IBenchmark {
+public:
+    explicit CLaplasBenchmark(CBenchData &data) : data(data) {}
+
+    virtual const char *Name() const { return "LaplasOperator"; }
+
+    virtual CPhaseModel Model() const {
+        const CPhaseModel model = {"LaplasOperator", 1, 13}; // чтение u, оператор и сумма
+        return model;
+    }
+
+    virtual size_t Values() const { return InnerPart(data.p).Size(); }
+
+    virtual void Run() {
+        NumericType sum = 0;
+        for (size_t y = 1; y + 1 < data.p.SizeY(); y++) {
+            for (size_t x = 1; x + 1 < data.p.SizeX(); x++) {
+                sum += LaplasOperator(data.p, data.grid, x, y);
+            }
+        }
+        CKernelBenchmark::sink += sum;
+    }
+
+private:
+    CBenchData &data;
+};
+
+// Обмен "заездом" с самим собой по всем четырём сторонам: упаковка, MPI и распаковка без сети.
+// EM_Rma - только по --exchange=rma: окно над MPI_COMM_SELF создают не все сборки MPI
+// (Open MPI с UCX - с OMPI_MCA_osc=sm,pt2pt), а ошибка окна завершает процесс.
+class CExchangeBenchmark : public IBenchmark {
+public:
+    CExchangeBenchmark(CBenchData &data, TExchangeMode mode) : data(data), mode(mode) {
+        definitions.SetMode(mode);
+        definitions.InitHalo(data.grid, 0, 0, 0, 0, MPI_COMM_SELF);
+    }
+
+    virtual const char *Name() const {
+        switch (mode) {
+            case EM_Datatype:
+                return "ExchangeDatatype";
+            case EM_Rma:
+                return "ExchangeRma";
+            default:
+                return "ExchangeBuffered";
+        }
+    }
+
+    virtual CPhaseModel Model() const { return CProfiler::Model(PP_ExchangeStart); }
+
+    virtual size_t Values() const {
+        size_t values = 0;
+        for (size_t i = 0; i < definitions.size(); i++) {
+            values += definitions[i].SendPart().Size() + definitions[i].RecvPart().Size();
+        }
+        return values;
+    }
+
+    virtual void Run() { definitions.Exchange(data.p); }
+
+private:
+    CBenchData &data;
+    const TExchangeMode mode;
+    CExchangeDefinitions definitions;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CBenchOptions {
+    vector<size_t> Sizes;
+    double MinTime;
+    string Label;
+    string OutputFilename;
+    CSolverOptions Solver;
+
+    CBenchOptions() : MinTime(0.2), Label("-") {}
+};
+
+static void ParseBenchArguments(int argc, char **argv, CBenchOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        const string argument(argv[i]);
+        const size_t equal = argument.find('=');
+        const string name = argument.substr(0, equal);
+        const string value = (equal == string::npos) ? string() : argument.substr(equal + 1);
+        if (name == "--sizes") {
+            istringstream sizes(value);
+            string size;
+            while (getline(sizes, size, ',')) {
+                const unsigned long points = strtoul(size.c_str(), 0, 10);
+                if (points < 3) {
+                    throw CException("invalid value of option `" + argument + "`");
+                }
+                options.Sizes.push_back(points);
+            }
+        } else if (name == "--min-time") {
+            options.MinTime = strtod(value.c_str(), 0);
+            if (!(options.MinTime > 0)) {
+                throw CException("invalid value of option `" + argument + "`");
+            }
+        } else if (name == "--label") {
+            options.Label = value;
+        } else if (name == "--output") {
+            options.OutputFilename = value;
+        } else {
+            ParseOption(argument, options.Solver); // --simd, --tile, --weights, --deterministic, --first-touch
+        }
+    }
+    if (options.Sizes.empty()) {
+        for (size_t points = 64; points <= 2048; points *= 2) {
+            options.Sizes.push_back(points);
+        }
+    }
+}
+
+// Секунды на вызов: вызовов всё больше, пока их общее время не превысит minTime.
+static double Measure(IBenchmark &benchmark, double minTime) {
+    benchmark.Run(); // прогрев: страницы размещены, правая часть посчитана
+    for (size_t calls = 1;; calls *= 2) {
+        const double start = MPI_Wtime();
+        for (size_t i = 0; i < calls; i++) {
+            benchmark.Run();
+        }
+        const double elapsed = MPI_Wtime() - start;
+        if (elapsed >= minTime) {
+            return elapsed / calls;
+        }
+    }
+}
+
+static void RunBenchmarks(const CBenchOptions &options, ostream &out) {
+    int threads = 1;
+#ifndef DIRCH_NO_OPENMP
+    threads = omp_get_max_threads();
+#endif
+    CDefaultProblem problem;
+    out << "version,benchmark,points_x,points_y,threads,simd,seconds,ns_per_value,gbps,gflops\n";
+    for (size_t s = 0; s < options.Sizes.size(); s++) {
+        const size_t points = options.Sizes[s];
+        CBenchData data(problem, points, options.Solver.FullWeights);
+        vector<IBenchmark *> benchmarks;
+        benchmarks.push_back(new CLaplasBenchmark(data));
+        benchmarks.push_back(new CKernelBenchmark(data, PP_CalcR));
+        benchmarks.push_back(new CKernelBenchmark(data, PP_CalcAlpha));
+        benchmarks.push_back(new CKernelBenchmark(data, PP_CalcTau));
+        benchmarks.push_back(new CKernelBenchmark(data, PP_CalcG));
+        benchmarks.push_back(new CKernelBenchmark(data, PP_CalcP));
+        benchmarks.push_back(new CKernelBenchmark(data, PP_Operator));
+        benchmarks.push_back(new CFloatKernelBenchmark(data, PP_Residual));
+        benchmarks.push_back(new CFloatKernelBenchmark(data, PP_CalcAlpha));
+        benchmarks.push_back(new CFloatKernelBenchmark(data, PP_CalcTau));
+        benchmarks.push_back(new CFloatKernelBenchmark(data, PP_CalcG));
+        benchmarks.push_back(new CFloatKernelBenchmark(data, PP_CalcP));
+        benchmarks.push_back(new CExchangeBenchmark(data, EM_Buffered));
+        benchmarks.push_back(new CExchangeBenchmark(data, EM_Datatype));
+        if (options.Solver.ExchangeMode == EM_Rma) { // --exchange=rma
+            benchmarks.push_back(new CExchangeBenchmark(data, EM_Rma));
+        }
+        for (size_t b = 0; b < benchmarks.size(); b++) {
+            IBenchmark &benchmark = *benchmarks[b];
+            const double seconds = Measure(benchmark, options.MinTime);
+            const CPhaseModel model = benchmark.Model();
+            const double values = static_cast<double>( benchmark.Values());
+            out << options.Label << ',' << benchmark.Name() << ',' << points << ',' << points << ',' << threads
+                << ',' << CSimd::Kernels().Name << ',' << setprecision(6) << seconds << ','
+                << seconds / values * 1e9 << ',' << model.Values * values * benchmark.ValueBytes() / seconds * 1e-9
+                << ',' << model.Flops * values / seconds * 1e-9 << endl;
+            delete benchmarks[b];
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    try {
+        CMpiSupport::Initialize(&argc, &argv);
+        CBenchOptions options;
+        ParseBenchArguments(argc, argv, options);
+        CStencilEngine::SetTileSize(CTileSize(options.Solver.TileX, options.Solver.TileY));
+        CStencilEngine::SetDeterministic(options.Solver.Deterministic);
+        CMatrix::SetFirstTouch(options.Solver.FirstTouch);
+        CSimd::Select(options.Solver.SimdLevel);
+        if (CMpiSupport::Rank() == 0) { // замеры одного процесса; остальные ранки только ждут
+            if (options.OutputFilename.empty()) {
+                RunBenchmarks(options, cout);
+            } else {
+                ofstream output(options.OutputFilename.c_str());
+                if (!output) {
+                    throw CException("cannot open `" + options.OutputFilename + "`");
+                }
+                RunBenchmarks(options, output);
+            }
+        }
+        CMpiSupport::Finalize();
+    } catch (exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        CMpiSupport::Abort(1);
+        return 1;
+    }
+    return 0;
+}
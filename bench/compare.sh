@@ -0,0 +1,56 @@
+#!/bin/sh
+# Сравнение двух файлов результатов одного вида (dirch-bench или bench/scaling.sh) по времени:
+#   bench/compare.sh OLD.csv NEW.csv [THRESHOLD]
+# Строки сопоставляются по столбцам конфигурации до seconds, кроме version и iterations: изменившееся
+# число итераций печатается рядом со временем. Замедление больше THRESHOLD процентов (по умолчанию 5) -
+# регрессия. Код возврата 1, если регрессии есть, заголовки файлов различаются или строки одного файла
+# не нашлись в другом.
+
+set -e
+
+if [ $# -lt 2 ] || [ $# -gt 3 ]; then
+    echo "usage: $0 OLD.csv NEW.csv [THRESHOLD]" >&2
+    exit 2
+fi
+old=$1
+new=$2
+threshold=${3:-5}
+
+if [ "$(head -n 1 "$old")" != "$(head -n 1 "$new")" ]; then
+    echo "$old and $new have different columns" >&2
+    exit 1
+fi
+
+awk -F, -v threshold="$threshold" '
+    FNR == 1 {
+        seconds = 0
+        for (i = 1; i <= NF; i++) {
+            if ($i == "seconds") seconds = i
+            if ($i == "version") version = i
+            if ($i == "iterations") iterations = i
+        }
+        if (seconds == 0) { print FILENAME ": no seconds column" > "/dev/stderr"; failed = 1; exit }
+        next
+    }
+    {
+        key = ""
+        for (i = 1; i < seconds; i++) {
+            if (i != version && i != iterations) key = key (key == "" ? "" : ",") $i
+        }
+        if (FILENAME == ARGV[1]) { before[key] = $seconds; if (iterations) steps[key] = $iterations; next }
+        if (!(key in before)) { print "new:        " key; unmatched++; next }
+        change = (before[key] > 0) ? 100 * ($seconds - before[key]) / before[key] : 0
+        status = (change > threshold) ? "REGRESSION" : (change < -threshold) ? "faster" : "same"
+        note = (iterations && $iterations != steps[key]) ? "  iterations " steps[key] " -> " $iterations : ""
+        printf "%-10s  %s  %.6g -> %.6g  %+.1f%%%s\n", status, key, before[key], $seconds, change, note
+        if (change > threshold) regressions++
+        seen[key] = 1
+    }
+    END {
+        if (failed) exit 1
+        for (key in before) if (!(key in seen)) { print "missing:    " key; unmatched++ }
+        if (regressions > 0) print regressions " regression(s) above " threshold "%"
+        if (unmatched > 0) print unmatched " row(s) without a pair"
+        if (regressions > 0 || unmatched > 0) exit 1
+    }
+' "$old" "$new"
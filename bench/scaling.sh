@@ -0,0 +1,75 @@
+#!/bin/sh
+# Сильное и слабое масштабирование решателя под локальным mpirun: по каждой паре (ранки, потоки)
+# из RANKS x THREADS один запуск с --profile=csv, строка результата - в CSV:
+#   version,mode,ranks,threads,points_x,points_y,iterations,seconds,compute,exchange,allreduce
+# iterations - последняя итерация из журнала решателя, seconds - максимум общего времени по процессам,
+# compute/exchange/allreduce - среднее по процессам: проходы по сетке, обмены и сбор данных, редукции.
+# Файлы двух версий сравнивает bench/compare.sh.
+#
+# Параметры - переменные окружения:
+#   DIRCH    решатель (по умолчанию ./build/dirch)
+#   MPIRUN   команда запуска (mpirun --oversubscribe); OMP_NUM_THREADS экспортируется, Open MPI
+#            передаёт его на другие узлы только с "-x OMP_NUM_THREADS" в MPIRUN
+#   RANKS    числа процессов ("1 2 4")
+#   THREADS  числа потоков OpenMP ("1")
+#   MODE     strong - сетка POINTS x POINTS при любом числе процессов,
+#            weak - POINTS x POINTS на процесс, сетка растёт как sqrt(ranks)
+#   POINTS   размер сетки (1000)
+#   ARGS     остальные параметры решателя, например "--iteration=pipelined --simd=avx2"
+#   OUTPUT   файл результата (пусто - стандартный вывод)
+#   VERSION  метка версии (git describe --always --dirty)
+#
+#   MODE=weak RANKS="1 4 16" POINTS=500 OUTPUT=weak.csv bench/scaling.sh
+
+set -e
+
+DIRCH=${DIRCH:-./build/dirch}
+MPIRUN=${MPIRUN:-mpirun --oversubscribe}
+RANKS=${RANKS:-1 2 4}
+THREADS=${THREADS:-1}
+MODE=${MODE:-strong}
+POINTS=${POINTS:-1000}
+ARGS=${ARGS:-}
+OUTPUT=${OUTPUT:-}
+VERSION=${VERSION:-$(git describe --always --dirty 2>/dev/null || echo unknown)}
+
+case $MODE in
+    strong|weak) ;;
+    *) echo "MODE must be strong or weak" >&2; exit 1 ;;
+esac
+
+profile=$(mktemp)
+log=$(mktemp)
+trap 'rm -f "$profile" "$log"' EXIT
+
+run() {
+    echo "version,mode,ranks,threads,points_x,points_y,iterations,seconds,compute,exchange,allreduce"
+    for ranks in $RANKS; do
+        for threads in $THREADS; do
+            points=$POINTS
+            if [ "$MODE" = weak ]; then
+                points=$(awk -v n="$POINTS" -v r="$ranks" 'BEGIN { printf "%d", n * sqrt(r) + 0.5 }')
+            fi
+            echo "$MODE: $ranks ranks x $threads threads, $points x $points" >&2
+            export OMP_NUM_THREADS=$threads
+            # Журнал - только последняя итерация, если ARGS не просят большего.
+            $MPIRUN -np "$ranks" "$DIRCH" "$points" "$points" --log-every=1000000000 $ARGS \
+                --profile=csv --profile-file="$profile" >"$log"
+            iterations=$(sed -n 's/^(0) Iteration #\([0-9]*\) finished.*/\1/p' "$log" | tail -n 1)
+            awk -F, -v prefix="$VERSION,$MODE,$ranks,$threads,$points,$points" -v iterations="$iterations" '
+                NR == 1 { next }
+                $1 ~ /^Calc/ || $1 == "Restriction" || $1 == "Prolongation" || $1 == "Transform" { compute += $5 }
+                $1 ~ /^Exchange/ || $1 == "CoarseGather" || $1 == "Transpose" { exchange += $5 }
+                $1 == "Allreduce" { allreduce = $5 }
+                $1 == "Total" { seconds = $6 }
+                END { printf "%s,%d,%.6f,%.6f,%.6f,%.6f\n", prefix, iterations, seconds, compute, exchange, allreduce }
+            ' "$profile"
+        done
+    done
+}
+
+if [ -n "$OUTPUT" ]; then
+    run > "$OUTPUT"
+else
+    run
+fi
@@ -3,117 +3,22 @@
 #include <MpiSupport.h>
 #include <Definitions.h>
 #include <MathObjects.h>
+#include <Problem.h>
 #include <MathFunctions.h>
+#include <StencilEngine.h>
+#include <Options.h>
+#include <SimdKernels.h>
+#include <Profiler.h>
 #include <IterationCallback.h>
-
-///////////////////////////////////////////////////////////////////////////////
-
-class CExchangeDefinition { // описание одного обмена
-public:
-    CExchangeDefinition(size_t rank, // ранк того, кому посылаем. откуда == текущий процесс
-                        const CMatrixPart &sendPart, // отправляемая часть матрицы
-                        const CMatrixPart &recvPart) : // получаемая часть матрицы
-            rank(rank),
-            sendPart(sendPart),
-            recvPart(recvPart) {
-        sendBuffer.reserve(sendPart.Size()); // вектор-переменная для обмена
-        recvBuffer.reserve(recvPart.Size()); // вектор-переменная для обмена
-    }
-
-    const CMatrixPart &SendPart() const { return sendPart; } // getter
-
-    const CMatrixPart &RecvPart() const { return recvPart; } // getter
-
-    void DoExchange(CMatrix &matrix); // асинхронный обмен
-
-    void Wait(CMatrix &matrix); // дождаться обмена
-
-private:
-    size_t rank;
-
-    CMatrixPart sendPart; // отправляемая часть матрицы
-    MPI_Request sendRequest;
-    vector <NumericType> sendBuffer; // вектор-переменная для обмена/ данные запроса на отправку данных в другой процесс
-
-    CMatrixPart recvPart; // получаемая часть матрицы
-    MPI_Request recvRequest; // данные запроса на отправку данных в другой процесс
-    vector <NumericType> recvBuffer; // вектор-переменная для обмена/ данные запроса на получения данных в другой процесс
-};
-
-///////////////////////////////////////////////////////////////////////////////
-
-void CExchangeDefinition::DoExchange(CMatrix &matrix) {
-    sendBuffer.clear(); // Очищаем значения, которые посылали в прошлый раз (это вектор)
-    for (size_t x = sendPart.BeginX;
-         x < sendPart.EndX; x++) { // пушим в буффер для отправки нужную часть матрицы (часть колонки или стобца)
-        for (size_t y = sendPart.BeginY; y < sendPart.EndY; y++) {
-            sendBuffer.push_back(matrix(x, y));
-        }
-    }
-
-    MpiCheck( // проверить на 0 и выбросить excepion
-            MPI_Isend( // возвращает код ошибки или 0
-                    sendBuffer.data(), // адресс начала данных
-                    sendBuffer.size(), // кол-во данных
-                    MpiNumericType, // тип данных
-                    rank, // адресс отправки
-                    0, // id сообщения
-                    MPI_COMM_WORLD, // коммуникатор
-                    &sendRequest) // OUT - "запрос обмена".
-            , "MPI_Isend"); // текс exceptionа
-
-    recvBuffer.resize(recvPart.Size());
-    MpiCheck( // проверить на 0 и выбросить excepion
-            MPI_Irecv( // возвращает код ошибки или 0
-                    recvBuffer.data(), // адресс начала данных
-                    recvBuffer.size(), // кол-во данных
-                    MpiNumericType, // тип данных
-                    rank, // адресс отправки
-                    0, // id сообщения
-                    MPI_COMM_WORLD, // коммуникатор
-                    &recvRequest), // OUT - "запрос обмена".
-            "MPI_Irecv"); // текс exceptionа
-}
-
-void CExchangeDefinition::Wait(CMatrix &matrix) {
-    MpiCheck( // проверить на 0 и выбросить excepion
-            MPI_Wait( // блокируемся, пока не получим
-                    &recvRequest, // переменная, отвечающая за текущий запрос
-                     MPI_STATUS_IGNORE), // Mpi_status field будет проигнорирован (передается в Iresv для синхронных операций),
-            // иначе можно указатель, куда записывать указать
-            "MPI_Wait"); // текс exceptionа
-
-    vector<NumericType>::const_iterator value = recvBuffer.begin(); // Копируем данные в матрицу в текущий процесс
-    for (size_t x = recvPart.BeginX; x < recvPart.EndX; x++) {
-        for (size_t y = recvPart.BeginY; y < recvPart.EndY; y++) {
-            matrix(x, y) = *value;
-            ++value;
-        }
-    }
-
-    MpiCheck( // проверить на 0 и выбросить excepion
-            MPI_Wait( // блокируемся, пока не отправим
-                    &sendRequest, // переменная, отвечающая за текущий запрос
-                    MPI_STATUS_IGNORE),  // Mpi_status field будет проигнорирован (передается в Iresv для синхронных операций),
-            // иначе можно указатель, куда записывать указать
-            "MPI_Wait"); // текс exceptionа
-}
-
-///////////////////////////////////////////////////////////////////////////////
-
-class CExchangeDefinitions : public vector<CExchangeDefinition> { // список обменов
-public:
-    CExchangeDefinitions() {}
-
-    void Exchange(CMatrix &matrix) { // процедуа выполнения обмена
-        for (vector<CExchangeDefinition>::iterator i = begin(); i != end(); ++i) {
-            i->DoExchange(matrix); // асинхронный метод обмена
-        }
-        for (vector<CExchangeDefinition>::iterator i = begin(); i != end(); ++i) {
-            i->Wait(matrix); // ждем окончания обмена
-        }
-    }
-};
+#include <IterationLog.h>
+#include <Exchange.h>
+#include <Multigrid.h>
+#include <FastDiagonalization.h>
+#include <BinaryDump.h>
+#include <Checkpoint.h>
+#include <Convergence.h>
+#include <InitialGuess.h>
+#include <Placement.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -129,13 +34,32 @@ void GetBeginEndPoints(const size_t numberOfPoints, const size_t numberOfBlocks
     }
 }
 
+// Ось целиком и её разбиение на numberOfBlocks блоков - для решателей, которым нужна вся сетка.
+CBlockedAxis BlockedAxis(NumericType p0, NumericType pN, size_t numberOfPoints, size_t numberOfBlocks) {
+    CUniformPartition partition;
+    partition.Init(p0, pN, numberOfPoints);
+    CBlockedAxis axis;
+    for (size_t i = 0; i < partition.Size(); i++) {
+        axis.Points.push_back(partition[i]);
+    }
+    for (size_t block = 0; block < numberOfBlocks; block++) {
+        size_t begin;
+        size_t end;
+        GetBeginEndPoints(numberOfPoints, numberOfBlocks, block, begin, end);
+        axis.Begins.push_back(begin);
+    }
+    axis.Begins.push_back(numberOfPoints);
+    return axis;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
-NumericType TotalError(const CMatrix &p, const CUniformGrid &grid) { // Считаем невязку
+NumericType TotalError(const CMatrix &p, const CUniformGrid &grid, const IProblem &problem) { // Считаем невязку
     NumericType squares = 0;
-    for (size_t x = 1; x < p.SizeX() - 1; x++) {
-        for (size_t y = 1; y < p.SizeY() - 1; y++) { // Считаем сумму квадратов
-            squares += (Phi(grid.X[x], grid.Y[y]) - p(x, y)) * (Phi(grid.X[x], grid.Y[y]) - p(x, y));
+    for (size_t y = 1; y < p.SizeY() - 1; y++) { // обходим в порядке хранения матрицы
+        for (size_t x = 1; x < p.SizeX() - 1; x++) { // Считаем сумму квадратов
+            const NumericType error = problem.Phi(grid.X[x], grid.Y[y]) - p(x, y);
+            squares += error * error;
         }
     }
     return static_cast<NumericType> (pow(squares, 0.5));
@@ -145,9 +69,9 @@ NumericType TotalError(const CMatrix &p, const CUniformGrid &grid) { // Счит
 
 // Вывод результатов (матрицы) в файл
 void DumpMatrix(const CMatrix &matrix, const CUniformGrid &grid, ostream &output) {
-    for (size_t x = 0; x < matrix.SizeX(); x++) {
-        for (size_t y = 0; y < matrix.SizeY(); y++) {
-            output << grid.X[x] << '\t' << grid.Y[y] << '\t' << matrix(x, y) << endl;
+    for (size_t y = 0; y < matrix.SizeY(); y++) { // обходим в порядке хранения матрицы
+        for (size_t x = 0; x < matrix.SizeX(); x++) {
+            output << grid.X[x] << '\t' << grid.Y[y] << '\t' << matrix(x, y) << '\n';
         }
     }
 }
@@ -156,12 +80,13 @@ void DumpMatrix(const CMatrix &matrix, const CUniformGrid &grid, ostream &output
 
 class CProgram {
 public:
-    static void Run(size_t pointsX, size_t pointsY, const CArea &area,
+    static void Run(size_t pointsX, size_t pointsY, const IProblem &problem, const CSolverOptions &options,
                     IIterationCallback &callback, const string &dumpFilename);
 
 private:
     const size_t numberOfProcesses;
-    const size_t rank;
+    MPI_Comm comm; // MPI_COMM_WORLD или декартова решётка процессов
+    size_t rank; // ранк в comm
     const size_t pointsX; // число узлов сетки
     const size_t pointsY;
     size_t processesX; // число MPI процессов "обрабатывающих оси"
@@ -174,13 +99,57 @@ private:
     size_t endY;
     CExchangeDefinitions exchangeDefinitions; // С кем и чем обменивается процесс
     CUniformGrid grid;
+    const IProblem &problem; // F, Phi и область
+    CRightHandSide rhs; // Значения F в узлах, считаются один раз
     CMatrix p; // Приближение
     CMatrix r; // Направление движения к следующему приближжению на 1 итерации
     CMatrix g; // Направление движения к следующему приближжению
+    const TNorm norm; // Норма изменения p, по которой проверяется сходимость
+    unique_ptr<CConvergenceMonitor> convergence; // Когда норма изменения редуцируется для difference
     NumericType difference; // Невязка
-    NumericType difference_2; // Сумма квадратов разниц (для AllReduceDifference)
-
-    CProgram(size_t pointsX, size_t pointsY, const CArea &area);
+    CMatrix pNext; // Слитная итерация: следующее приближение (меняется местами с p)
+    CMatrix ag; // Слитная итерация: A g - оператор Лапласа от g во внутренних точках
+    NumericType pendingTau; // Слитная итерация: шаг p = p - tau * g, отложенный до следующего прохода
+    NumericType gAg; // Слитная итерация: (Ag, g) - знаменатель alpha, равный знаменателю прошлого tau
+    const bool overlap; // Считать глубину блока во время обмена "заездами"
+    const size_t halo; // Ширина "заезда" со стороны соседей
+    CMatrixPart interiorPart; // Глубина блока: шаблон не задевает "заезд" (только при overlap)
+    vector<CMatrixPart> afterExchangeParts; // Что считается после обмена: кольцо у "заезда" или все внутренние точки
+    CMatrix ar; // Конвейерный метод: A r
+    CMatrix aar; // Конвейерный метод: A(A r), считается, пока идёт редукция
+    CMatrix aag; // Конвейерный метод: A(A g)
+    CPipelinedSums pipelinedSums; // Конвейерный метод: локальные суммы для следующей редукции
+    NumericType previousRR; // Конвейерный метод: (r, r) прошлой итерации, 0 - прошлой итерации нет
+    NumericType previousAlpha; // Конвейерный метод: шаг прошлой итерации
+    MPI_Datatype pipelinedType; // Четыре суммы конвейерного метода как один элемент редукции
+    MPI_Op pipelinedOp; // Сложение трёх сумм и максимум четвёртой
+    unique_ptr<CMultigrid> multigrid; // Многосеточный метод или предобусловливатель, 0 - не используется
+    CMatrix z; // Предобусловленная невязка z = M r
+    CMatrix pPrevious; // Многосеточный метод: p до цикла
+    unique_ptr<CFastDiagonalization> direct; // Прямой решатель, 0 - не используется
+    CFloatExchangeDefinitions floatExchangeDefinitions; // Смешанная точность: те же обмены для матриц float
+    CFloatMatrix floatR; // Смешанная точность: невязка r во float - правая часть A e = r
+    CFloatMatrix floatE; // Смешанная точность: поправка e, на границе области 0
+    CFloatMatrix floatS; // Смешанная точность: невязка внутренней задачи A e - r
+    CFloatMatrix floatG; // Смешанная точность: направление внутренних итераций
+    const size_t mixedIterations; // Смешанная точность: предел внутренних итераций
+    const NumericType mixedReduction; // Смешанная точность: во сколько раз должен уменьшиться шаг e
+    NumericType chebyshevCenter; // Чебышёв: середина отрезка спектра A
+    NumericType chebyshevRadius; // Чебышёв: половина длины отрезка спектра
+    NumericType chebyshevRho; // Чебышёв: rho прошлой итерации
+    NumericType chebyshevTau; // Чебышёв: шаг прошлой итерации, 0 - прошлой итерации нет
+    CExchangeDefinitions directionExchange; // Чебышёв с "заездом" шире 1: обмен g вместе с p
+    size_t sweeps; // Чебышёв с "заездом" шире 1: проходов после последнего обмена
+    const TIterationMode iterationMode;
+    size_t iterations; // сколько итераций (с нулевой) выполнено, с учётом контрольной точки
+    unique_ptr<CCheckpoint> checkpoint; // Запись и чтение контрольных точек, 0 - не используются
+    const string checkpointFilename;
+
+    CProgram(size_t pointsX, size_t pointsY, const IProblem &problem, const CSolverOptions &options);
+
+    ~CProgram();
+
+    bool solve(const CSolverOptions &options, IIterationCallback &callback); // false - callback прервал решение
 
     bool hasLeftNeighbor() const { return (rankX > 0); }
 
@@ -192,173 +161,483 @@ private:
 
     size_t rankByXY(size_t x, size_t y) const { return (y * processesX + x); }
 
-    void setProcessXY(); // узнаем, сколько процессов будет по абциссе, сколько по ординате, деля их число на 2...
+    void setProcessXY(); // раскладываем число процессов на processesX * processesY с наименьшим "заездом"
 
-    void setExchangeDefinitions(); // Заполняем список соседей с которыми будем обмениваться данными и описываем сами данные.
+    void setCommunicator(bool cartesian); // comm, rank, rankX и rankY
+
+    // Заполняем список соседей с которыми будем обмениваться данными и описываем сами данные.
+    template<typename T>
+    void setExchangeDefinitions(CExchangeDefinitionsT<T> &definitions);
+
+    void allReduceSums(NumericType *buffer, int count); // суммирование по всем процессам на месте
 
     void allReduceFraction(CFraction &fraction);
 
-    void allReduceDifference();
+    NumericType allReduceNorm(CUpdateNorms norms); // общая норма изменения по всем процессам
+
+    // Норма изменения p после итерации iterations -> difference, по расписанию convergence:
+    // difference может быть значением одной из прошлых итераций.
+    void allReduceDifference(CUpdateNorms norms);
+
+    void setComputeParts(); // Разбиваем внутренние точки на глубину и кольцо у "заезда"
+
+    // Обмен "заездом" и проход, которому он нужен. При overlap глубина блока считается,
+    // пока сообщения в пути, кольцо - после Finish.
+    void exchangeAndCalcR(); // обмен p, r = Ap - F
+    CFraction exchangeAndCalcAlpha(CMatrix &residual); // обмен residual (r или z), суммы alpha по (residual, g)
+    CFraction exchangeAndCalcTau(CMatrix &direction); // обмен direction, суммы tau по (r, direction)
 
     void iteration0(); // итерация 0 == инициализация матрицы
 
+    // Внутренние точки p по решению на другой сетке: из файла или с грубой сетки (вложенные итерации).
+    void initialGuess(const CSolverOptions &options);
+
     void iteration1(); // итерация 1, выполняется по отдельной формуле
 
     void iteration2(); // остальные итерации, для ускорения, см. методичку
+
+    void fusedInit(); // подготовка слитной итерации: g = Ag = 0, отложенного шага нет
+
+    void fusedIteration(); // слитная итерация: два прохода по сетке, один обмен (r) вместо трёх
+
+    void fusedFinish(); // выполнить отложенное обновление p
+
+    void pipelinedInit(); // конвейерный метод: r = Ap - F, Ar и суммы для первой редукции
+
+    void pipelinedIteration(); // конвейерная итерация: редукция идёт, пока считается A(Ar)
+
+    void pipelinedFinish(); // обновить "заезд" p, освободить тип и операцию редукции
+
+    CMatrix &preconditioned(); // r или z = M r, если задан предобусловливатель
+
+    void multigridInit(); // r = Ap - F: заполнить правую часть, если она считается при первом проходе
+
+    void multigridIteration(); // один цикл, difference - норма изменения p
+
+    void multigridFinish(); // обновить "заезд" p
+
+    void directIteration(); // p = p - A^-1 r: первая итерация решает задачу, вторая уточняет решение
+
+    void mixedInit(); // матрицы float и их обмены
+
+    // p = p - e: r = Ap - F в NumericType, A e = r - сопряжёнными градиентами во float.
+    // Ошибка округления float остаётся в поправке e и исправляется следующей невязкой.
+    void mixedIteration();
+
+    void mixedSolve(); // внутренние итерации: floatE по floatR
+
+    void chebyshevInit(); // отрезок спектра A по осям, первой итерации нет
+
+    // p = p - tau * g, g = r + beta * g: коэффициенты - из многочленов Чебышёва на отрезке спектра,
+    // глобальные суммы нужны только проверкам сходимости.
+    void chebyshevIteration();
+
+    // Проход Чебышёва с "заездом" ширины halo: после обмена p и g верны во всей матрице, каждый проход
+    // сужает область, где они верны, на узел со стороны соседей, и через halo проходов нужен обмен.
+    // "Заезд" пересчитывается так же, как его считают соседи; нормы изменения p - по своим узлам.
+    CUpdateNorms chebyshevSweep(NumericType alpha, NumericType tau);
+
+    CMatrixPart haloPart(size_t depth) const; // внутренние точки без depth узлов со стороны соседей
+
+    // Матрицы и числа, которых достаточно, чтобы продолжить итерации метода iterationMode.
+    // Первое число - всегда difference.
+    void checkpointState(vector<CMatrix *> &matrices, vector<NumericType *> &scalars);
+
+    // Конец итерации: сообщить difference и, если пора, начать запись контрольной точки.
+    void endIteration(IIterationCallback &callback);
+
+    // Восстановить состояние после подготовки метода (fusedInit, pipelinedInit и т.д.).
+    void restore(const string &filename, IIterationCallback &callback);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void CProgram::Run(size_t pointsX, size_t pointsY, const CArea &area,
+void CProgram::Run(size_t pointsX, size_t pointsY, const IProblem &problem, const CSolverOptions &options,
                    IIterationCallback &callback, const string &dumpFilename = "") {
-    CProgram program(pointsX, pointsY, area); // Конструктор запускаем
-
-    // Выполняем нулевую итерацию (инициализацию).
-    if (!callback.BeginIteration()) {
+    CProgram program(pointsX, pointsY, problem, options); // Конструктор запускаем
+    if (!program.solve(options, callback)) {
         return;
     }
-    program.iteration0(); // Заполняем границы, если границы общей области принадлежат области, обрабатываемой процессом
-    callback.EndIteration(program.difference); // Значение difference по умолчанию задается в конструкторе program
 
-    // Выполняем первую итерацию.
-    if (!callback.BeginIteration()) {
+    if (dumpFilename.empty()) {
         return;
     }
-    program.iteration1();
-    callback.EndIteration(program.difference);
+    CPhaseTimer timer(PP_Output, program.p.SizeX() * program.p.SizeY());
+    if (options.OutputFormat == OF_Text) {
+        ostringstream name; // данные текущего процесса записываются в файл с именем +  mpi-ранк процесса
+        name << dumpFilename << CMpiSupport::Rank();
+        ofstream outputFile(name.str().c_str());
+        DumpMatrix(program.p, program.grid, outputFile); // выводим нашу матрицу
+    } else {
+        const CArea area = problem.Area();
+        WriteBinaryDump(dumpFilename, program.p,
+                        BlockedAxis(area.X0, area.Xn, pointsX, program.processesX),
+                        BlockedAxis(area.Y0, area.Yn, pointsY, program.processesY),
+                        program.rankX, program.rankY, program.comm, program.halo);
+    }
+}
 
-    // Выполняем остальные итерации.
-    while (callback.BeginIteration()) { // проверяем невязку
-        program.iteration2(); // выполняем итерацию
-        callback.EndIteration(program.difference); // проставляем невязку и логгируем итерацию
+bool CProgram::solve(const CSolverOptions &options, IIterationCallback &callback) {
+    // Выполняем нулевую итерацию (инициализацию).
+    if (!callback.BeginIteration()) {
+        return false;
     }
+    iteration0(); // Заполняем границы, если границы общей области принадлежат области, обрабатываемой процессом
+    initialGuess(options);
+    // При продолжении с контрольной точки метод готовится как обычно, затем его состояние читается из файла.
+    const string &restart = options.RestartFilename;
+    if (restart.empty()) {
+        endIteration(callback); // Значение difference по умолчанию задается в конструкторе program
+    }
+
+    if (options.IterationMode == IM_Fused) {
+        // Первая слитная итерация отличается от остальных только нулевыми g, Ag и alpha.
+        fusedInit();
+        if (!restart.empty()) {
+            restore(restart, callback);
+        }
+        while (callback.BeginIteration()) {
+            fusedIteration();
+            endIteration(callback);
+        }
+        fusedFinish();
+    } else if (options.IterationMode == IM_Pipelined) {
+        // Изменение p становится известно со следующей редукцией, поэтому difference
+        // отстаёт на одну итерацию, а первая итерация сообщает максимальное значение.
+        pipelinedInit();
+        if (!restart.empty()) {
+            restore(restart, callback);
+        }
+        while (callback.BeginIteration()) {
+            pipelinedIteration();
+            endIteration(callback);
+        }
+        pipelinedFinish();
+    } else if (options.IterationMode == IM_Multigrid) {
+        multigridInit();
+        if (!restart.empty()) {
+            restore(restart, callback);
+        }
+        while (callback.BeginIteration()) {
+            multigridIteration();
+            endIteration(callback);
+        }
+        multigridFinish();
+    } else if (options.IterationMode == IM_Direct) {
+        r.Init(grid.X.Size(), grid.Y.Size());
+        z.Init(grid.X.Size(), grid.Y.Size());
+        if (!restart.empty()) {
+            restore(restart, callback);
+        }
+        while (callback.BeginIteration()) {
+            directIteration();
+            endIteration(callback);
+        }
+        exchangeDefinitions.Exchange(p);
+    } else if (options.IterationMode == IM_Mixed) {
+        mixedInit();
+        if (!restart.empty()) {
+            restore(restart, callback);
+        }
+        while (callback.BeginIteration()) {
+            mixedIteration();
+            endIteration(callback);
+        }
+        exchangeDefinitions.Exchange(p);
+    } else if (options.IterationMode == IM_Chebyshev) {
+        chebyshevInit();
+        if (!restart.empty()) {
+            restore(restart, callback);
+        }
+        while (callback.BeginIteration()) {
+            chebyshevIteration();
+            endIteration(callback);
+        }
+        exchangeDefinitions.Exchange(p);
+    } else {
+        if (restart.empty()) {
+            // Выполняем первую итерацию.
+            if (!callback.BeginIteration()) {
+                return false;
+            }
+            iteration1();
+            endIteration(callback);
+        } else { // первая итерация уже выполнена до контрольной точки
+            r.Init(grid.X.Size(), grid.Y.Size());
+            g.Init(grid.X.Size(), grid.Y.Size());
+            restore(restart, callback);
+        }
 
-    char num[5];
-    snprintf(num, 5, "%d", (int) CMpiSupport::Rank()); // данные текущего процесса записываются в файл с именем +  mpi-ранк процесса
-    ofstream outputFile((dumpFilename + string(num)).c_str());
-    DumpMatrix(program.p, program.grid, outputFile); // выводим нашу матрицу
+        // Выполняем остальные итерации.
+        while (callback.BeginIteration()) { // проверяем невязку
+            iteration2(); // выполняем итерацию
+            endIteration(callback); // проставляем невязку и логгируем итерацию
+        }
+    }
+    convergence->Finish();
+    if (checkpoint.get() != 0) {
+        checkpoint->Finish();
+    }
+    return true;
 }
 
-CProgram::CProgram(size_t pointsX, size_t pointsY, const CArea &area) :
+CProgram::CProgram(size_t pointsX, size_t pointsY, const IProblem &problem, const CSolverOptions &options) :
         numberOfProcesses(CMpiSupport::NumberOfProccess()),
+        comm(MPI_COMM_WORLD),
         rank(CMpiSupport::Rank()),
         pointsX(pointsX), pointsY(pointsY),
-        difference(numeric_limits<NumericType>::max()) {
+        problem(problem),
+        norm(options.Norm),
+        difference(numeric_limits<NumericType>::max()),
+        pendingTau(0), gAg(0),
+        overlap(options.Overlap),
+        halo(options.HaloWidth),
+        previousRR(0), previousAlpha(0),
+        mixedIterations(options.MixedIterations),
+        mixedReduction(options.MixedReduction),
+        chebyshevCenter(0), chebyshevRadius(0), chebyshevRho(0), chebyshevTau(0), sweeps(0),
+        iterationMode(options.IterationMode),
+        iterations(0),
+        checkpointFilename(options.CheckpointFilename) {
     setProcessXY(); // сколько процессов "по горизонтали и вертикали" (для 8 4:2)
-    rankX = rank % processesX; // какую часть обрабатывает этот процесс
-    rankY = rank / processesX;
+    setCommunicator(options.CartesianTopology); // какую часть обрабатывает этот процесс
+    if (pointsX / processesX < halo || pointsY / processesY < halo) { // "заезд" - свои узлы соседа
+        throw CException("--halo is wider than the blocks of processes");
+    }
+    convergence.reset(new CConvergenceMonitor(options.ConvergenceCheck, options.ConvergencePeriod, norm,
+                                              DefaultEps, comm));
     GetBeginEndPoints(pointsX, processesX, rankX, beginX,
                       endX); // Считаем начало и конец отрезка, обрабатываемого процессом
     GetBeginEndPoints(pointsY, processesY, rankY, beginY,
                       endY); // Считаем начало и конец отрезка, обрабатываемого процессом
 
     if (hasLeftNeighbor()) { // Корректируем концы, чтобы было с "заездом" на чужую территорию
-        beginX--;
+        beginX -= halo;
     }
     if (hasRightNeighbor()) {
-        endX++;
+        endX += halo;
     }
     if (hasTopNeighbor()) {
-        beginY--;
+        beginY -= halo;
     }
     if (hasBottomNeighbor()) {
-        endY++;
+        endY += halo;
     }
 
     // Инициализируем grid.
+    const CArea area = problem.Area();
     grid.X.PartInit(area.X0, area.Xn, pointsX, beginX, endX); // У каждого процесса свой грид
     grid.Y.PartInit(area.Y0, area.Yn, pointsY, beginY, endY);
+    if (options.FullWeights) {
+        grid.InitWeights();
+    }
+    rhs.Init(problem, grid, options.LazyRightHandSide);
 
     // Заполняем список соседей с которыми будем обмениваться данными и описываем сами данные.
-    setExchangeDefinitions();
+    exchangeDefinitions.SetMode(options.ExchangeMode);
+    setExchangeDefinitions(exchangeDefinitions);
+    setComputeParts();
+    if (options.IterationMode == IM_Mixed) {
+        floatExchangeDefinitions.SetMode(options.ExchangeMode);
+        setExchangeDefinitions(floatExchangeDefinitions);
+    }
+    if (options.IterationMode == IM_Chebyshev && halo > 1) {
+        directionExchange.SetMode(options.ExchangeMode);
+        setExchangeDefinitions(directionExchange);
+    }
+
+    if (options.IterationMode == IM_Multigrid || options.Preconditioner == PC_Multigrid) {
+        multigrid.reset(new CMultigrid(BlockedAxis(area.X0, area.Xn, pointsX, processesX),
+                                       BlockedAxis(area.Y0, area.Yn, pointsY, processesY),
+                                       rankX, rankY, comm, options));
+    }
+    if (options.IterationMode == IM_Direct) {
+        direct.reset(new CFastDiagonalization(BlockedAxis(area.X0, area.Xn, pointsX, processesX),
+                                              BlockedAxis(area.Y0, area.Yn, pointsY, processesY),
+                                              rankX, rankY, comm));
+    }
+    if (!options.CheckpointFilename.empty() || !options.RestartFilename.empty()) {
+        // Оси разбиты на блоки текущего запуска: файл хранит сетку целиком, поэтому
+        // контрольную точку можно прочитать при другом числе процессов.
+        checkpoint.reset(new CCheckpoint(BlockedAxis(area.X0, area.Xn, pointsX, processesX),
+                                         BlockedAxis(area.Y0, area.Yn, pointsY, processesY),
+                                         rankX, rankY, comm, halo));
+        if (!options.CheckpointFilename.empty()) {
+            const size_t every = (options.CheckpointEvery == 0 && options.CheckpointSeconds == 0) ?
+                                 100 : options.CheckpointEvery;
+            checkpoint->SetSchedule(every, options.CheckpointSeconds);
+        }
+    }
 }
 
-void CProgram::setProcessXY() { // узнаем, сколько процессов будет по абциссе, сколько по ординате, деля их число на 2...
-    size_t power = 0;
-    {
-        size_t i = 1;
-        while (i < numberOfProcesses) {
-            i *= 2;
-            power++;
+CProgram::~CProgram() {
+    checkpoint.reset(); // запись и рассылка расписания идут в comm
+    convergence.reset();
+    if (comm != MPI_COMM_WORLD) {
+        MPI_Comm_free(&comm);
+    }
+}
+
+void CProgram::setProcessXY() {
+    // Перебираем разложения numberOfProcesses = processesX * processesY. Обмен каждого процесса
+    // пропорционален полупериметру самого большого блока, при равенстве берём меньшую общую длину разрезов.
+    // Блок должен иметь хотя бы три узла по каждой оси, иначе у него нет внутренних точек между "заездами".
+    const size_t minBlock = 3;
+    size_t bestPerimeter = numeric_limits<size_t>::max();
+    size_t bestCuts = numeric_limits<size_t>::max();
+    processesX = 0;
+    processesY = 0;
+    for (size_t pX = 1; pX <= numberOfProcesses; pX++) {
+        if (numberOfProcesses % pX != 0) {
+            continue;
+        }
+        const size_t pY = numberOfProcesses / pX;
+        if (pointsX / pX < minBlock || pointsY / pY < minBlock) {
+            continue;
         }
-        if (i != numberOfProcesses) {
-            throw CException("The number of processes must be power of 2.");
+        const size_t perimeter = (pointsX + pX - 1) / pX + (pointsY + pY - 1) / pY;
+        const size_t cuts = (pX - 1) * pointsY + (pY - 1) * pointsX;
+        if (perimeter < bestPerimeter || (perimeter == bestPerimeter && cuts < bestCuts)) {
+            bestPerimeter = perimeter;
+            bestCuts = cuts;
+            processesX = pX;
+            processesY = pY;
         }
     }
+    if (processesX == 0) {
+        throw CException("Too many processes for the grid: every block needs at least 3 points per axis.");
+    }
+}
+
+void CProgram::setCommunicator(bool cartesian) {
+    if (!cartesian) {
+        rankX = rank % processesX;
+        rankY = rank / processesX;
+        return;
+    }
+    // Измерения в порядке (y, x): построчная нумерация решётки совпадает с rankByXY.
+    int dims[2] = {static_cast<int>( processesY ), static_cast<int>( processesX )};
+    const int periods[2] = {0, 0};
+    MpiCheck(MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1 /* reorder */, &comm), "MPI_Cart_create");
+    int cartRank = 0;
+    MpiCheck(MPI_Comm_rank(comm, &cartRank), "MPI_Comm_rank");
+    int coords[2] = {0, 0};
+    MpiCheck(MPI_Cart_coords(comm, cartRank, 2, coords), "MPI_Cart_coords");
+    rank = static_cast<size_t>( cartRank );
+    rankY = static_cast<size_t>( coords[0] );
+    rankX = static_cast<size_t>( coords[1] );
+    assert(rankByXY(rankX, rankY) == rank);
+}
 
-    float pX = static_cast<float>( pointsX );
-    float pY = static_cast<float>( pointsY );
+template<typename T>
+void CProgram::setExchangeDefinitions(CExchangeDefinitionsT<T> &definitions) {
+    // Углы "заезда" нужны, только когда между обменами идёт несколько проходов шаблона.
+    const bool corners = (halo > 1);
+    definitions.InitHalo(grid, halo,
+                                 hasLeftNeighbor() ? static_cast<int>( rankByXY(rankX - 1, rankY)) : -1,
+                                 hasRightNeighbor() ? static_cast<int>( rankByXY(rankX + 1, rankY)) : -1,
+                                 hasTopNeighbor() ? static_cast<int>( rankByXY(rankX, rankY - 1)) : -1,
+                                 hasBottomNeighbor() ? static_cast<int>( rankByXY(rankX, rankY + 1)) : -1,
+                                 corners && hasLeftNeighbor() && hasTopNeighbor() ?
+                                 static_cast<int>( rankByXY(rankX - 1, rankY - 1)) : -1,
+                                 corners && hasRightNeighbor() && hasTopNeighbor() ?
+                                 static_cast<int>( rankByXY(rankX + 1, rankY - 1)) : -1,
+                                 corners && hasLeftNeighbor() && hasBottomNeighbor() ?
+                                 static_cast<int>( rankByXY(rankX - 1, rankY + 1)) : -1,
+                                 corners && hasRightNeighbor() && hasBottomNeighbor() ?
+                                 static_cast<int>( rankByXY(rankX + 1, rankY + 1)) : -1,
+                                 comm);
+}
 
-    size_t powerX = 0;
-    size_t powerY = 0;
-    for (size_t i = 0; i < power; i++) {
-        if (pX > pY) {
-            pX = pX / 2;
-            powerX++;
-        } else {
-            pY = pY / 2;
-            powerY++;
-        }
+void CProgram::setComputeParts() {
+    const CMatrixPart inner(1, grid.X.Size() - 1, 1, grid.Y.Size() - 1);
+    afterExchangeParts.clear();
+    if (overlap) {
+        SplitInnerPart(inner, interiorPart, afterExchangeParts);
+    } else {
+        afterExchangeParts.push_back(inner);
     }
+}
 
-    processesX = 1 << powerX;
-    processesY = 1 << powerY;
+void CProgram::exchangeAndCalcR() {
+    exchangeDefinitions.Start(p);
+    if (overlap) {
+        CalcR(p, grid, rhs, r, interiorPart);
+    }
+    exchangeDefinitions.Finish(p);
+    for (vector<CMatrixPart>::const_iterator part = afterExchangeParts.begin();
+         part != afterExchangeParts.end(); ++part) {
+        CalcR(p, grid, rhs, r, *part);
+    }
+    rhs.SetReady();
 }
 
-void CProgram::setExchangeDefinitions() {
-    if (hasLeftNeighbor()) { // проверка, не крайний ли наш блок
-        exchangeDefinitions.push_back(CExchangeDefinition(
-                rankByXY(rankX - 1, rankY), // Устанавливаем ранк соседа, с которым будем обмениваться
-                grid.Column(1, 1 /* decreaseTop */, 1 /* decreaseBottom */ ),
-                grid.Column(0, 1 /* decreaseTop */, 1 /* decreaseBottom */ )));
+CFraction CProgram::exchangeAndCalcAlpha(CMatrix &residual) {
+    CFraction alpha(0, 0);
+    exchangeDefinitions.Start(residual);
+    if (overlap) {
+        alpha.Add(CalcAlpha(residual, g, grid, interiorPart));
     }
-    if (hasRightNeighbor()) { // проверка, не крайний ли наш блок
-        exchangeDefinitions.push_back(CExchangeDefinition(
-                rankByXY(rankX + 1, rankY), // Устанавливаем ранк соседа, с которым будем обмениваться
-                grid.Column(grid.X.Size() - 2, 1 /* decreaseTop */, 1 /* decreaseBottom */ ),
-                grid.Column(grid.X.Size() - 1, 1 /* decreaseTop */, 1 /* decreaseBottom */ )));
+    exchangeDefinitions.Finish(residual);
+    for (vector<CMatrixPart>::const_iterator part = afterExchangeParts.begin();
+         part != afterExchangeParts.end(); ++part) {
+        alpha.Add(CalcAlpha(residual, g, grid, *part));
     }
-    if (hasTopNeighbor()) { // проверка, не крайний ли наш блок
-        exchangeDefinitions.push_back(CExchangeDefinition(
-                rankByXY(rankX, rankY - 1), // Устанавливаем ранк соседа, с которым будем обмениваться
-                grid.Row(1, 1 /* decreaseLeft */, 1 /* decreaseRight */ ),
-                grid.Row(0, 1 /* decreaseLeft */, 1 /* decreaseRight */ )));
+    return alpha;
+}
+
+CFraction CProgram::exchangeAndCalcTau(CMatrix &direction) {
+    CFraction tau(0, 0);
+    exchangeDefinitions.Start(direction);
+    if (overlap) {
+        tau.Add(CalcTau(r, direction, grid, interiorPart));
     }
-    if (hasBottomNeighbor()) { // проверка, не крайний ли наш блок
-        exchangeDefinitions.push_back(CExchangeDefinition(
-                rankByXY(rankX, rankY + 1), // Устанавливаем ранк соседа, с которым будем обмениваться
-                grid.Row(grid.Y.Size() - 2, 1 /* decreaseLeft */, 1 /* decreaseRight */ ),
-                grid.Row(grid.Y.Size() - 1, 1 /* decreaseLeft */, 1 /* decreaseRight */ )));
+    exchangeDefinitions.Finish(direction);
+    for (vector<CMatrixPart>::const_iterator part = afterExchangeParts.begin();
+         part != afterExchangeParts.end(); ++part) {
+        tau.Add(CalcTau(r, direction, grid, *part));
     }
+    return tau;
 }
 
-void CProgram::allReduceFraction(CFraction &fraction) {
-    NumericType buffer[2] = {fraction.Numerator, fraction.Denominator};
+void CProgram::allReduceSums(NumericType *buffer, int count) {
+    CPhaseTimer timer(PP_Allreduce, static_cast<size_t>( count ));
     MpiCheck( // проверяем на MPI_SUCCESS == 0
             MPI_Allreduce(MPI_IN_PLACE, // input buffer == output buffer
                           buffer, // данные
-                          2, // размер
+                          count, // размер
                           MpiNumericType, // тип
                           MPI_SUM, // операция
-                          MPI_COMM_WORLD), // коммуникатор
+                          comm), // коммуникатор
             "MPI_Allreduce" // текст ошибки
     );
+}
+
+void CProgram::allReduceFraction(CFraction &fraction) {
+    NumericType buffer[2] = {fraction.Numerator, fraction.Denominator};
+    allReduceSums(buffer, 2);
     fraction.Numerator = buffer[0]; // числитель
     fraction.Denominator = buffer[1]; // знаменатель
 }
 
-void CProgram::allReduceDifference() {
-    NumericType buffer = difference_2;
+NumericType CProgram::allReduceNorm(CUpdateNorms norms) {
+    CPhaseTimer timer(PP_Allreduce, 1);
+    const bool isMax = (norm == N_Max);
+    NumericType *buffer = isMax ? &norms.Max : &norms.Squares;
     MpiCheck( // проверяем на MPI_SUCCESS == 0
             MPI_Allreduce(MPI_IN_PLACE, // input buffer == output buffer
-                          &buffer, // адресс переменной, с данными запроса-ответа
+                          buffer, // адресс переменной, с данными запроса-ответа
                           1, // размер
                           MpiNumericType, // тип
-                          MPI_SUM, // суммируем квадраты
-                          MPI_COMM_WORLD),
+                          isMax ? MPI_MAX : MPI_SUM, // максимум или сумма квадратов
+                          comm),
             "MPI_Allreduce" // текст ошибки
     );
-    difference = static_cast<NumericType> (pow(buffer, 0.5)); // считаем общую невязку
+    return norms.Value(norm);
+}
+
+void CProgram::allReduceDifference(CUpdateNorms norms) {
+    convergence->Submit(iterations, norms, difference); // считаем общую невязку
 }
 
 void CProgram::iteration0() {
@@ -367,24 +646,64 @@ void CProgram::iteration0() {
 
     if (!hasLeftNeighbor()) {
         for (size_t y = 0; y < p.SizeY(); y++) {
-            p(0, y) = Phi(grid.X[0], grid.Y[y]); // Phi - граничная функция
+            p(0, y) = problem.Phi(grid.X[0], grid.Y[y]); // Phi - граничная функция
         }
     }
     if (!hasRightNeighbor()) {
         const size_t left = p.SizeX() - 1;
         for (size_t y = 0; y < p.SizeY(); y++) {
-            p(left, y) = Phi(grid.X[left], grid.Y[y]); // Phi - граничная функция
+            p(left, y) = problem.Phi(grid.X[left], grid.Y[y]); // Phi - граничная функция
         }
     }
     if (!hasTopNeighbor()) {
         for (size_t x = 0; x < p.SizeX(); x++) {
-            p(x, 0) = Phi(grid.X[x], grid.Y[0]); // Phi - граничная функция
+            p(x, 0) = problem.Phi(grid.X[x], grid.Y[0]); // Phi - граничная функция
         }
     }
     if (!hasBottomNeighbor()) {
         const size_t bottom = p.SizeY() - 1;
         for (size_t x = 0; x < p.SizeX(); x++) {
-            p(x, bottom) = Phi(grid.X[x], grid.Y[bottom]); // Phi - граничная функция
+            p(x, bottom) = problem.Phi(grid.X[x], grid.Y[bottom]); // Phi - граничная функция
+        }
+    }
+}
+
+void CProgram::initialGuess(const CSolverOptions &options) {
+    // Прямоугольник блока вместе с "заездом": "заезд" заполняется той же интерполяцией, обмен не нужен.
+    const CArea block(grid.X[0], grid.X[grid.X.Size() - 1], grid.Y[0], grid.Y[grid.Y.Size() - 1]);
+    CGridSamples samples;
+    if (!options.InitialFilename.empty()) {
+        ReadGridSamples(options.InitialFilename, block, comm, samples);
+    } else if (options.NestedLevels > 0) {
+        // Грубая сетка - каждый второй узел (при нечётном числе узлов узлы совпадают с узлами этой сетки).
+        const size_t coarseX = (pointsX + 1) / 2;
+        const size_t coarseY = (pointsY + 1) / 2;
+        if (coarseX / processesX < max<size_t>(3, halo) || coarseY / processesY < max<size_t>(3, halo)) {
+            return; // грубую сетку нельзя разбить на блоки процессов
+        }
+        CSolverOptions coarseOptions(options);
+        coarseOptions.NestedLevels--;
+        coarseOptions.CheckpointFilename.clear();
+        coarseOptions.RestartFilename.clear();
+        CProgram coarse(coarseX, coarseY, problem, coarseOptions);
+        CSimpleIterationCallback coarseCallback;
+        coarse.solve(coarseOptions, coarseCallback);
+        const CArea area = problem.Area();
+        GatherGridSamples(coarse.p, BlockedAxis(area.X0, area.Xn, coarseX, coarse.processesX),
+                          BlockedAxis(area.Y0, area.Yn, coarseY, coarse.processesY),
+                          coarse.rankX, coarse.rankY, coarse.comm, block, samples, coarse.halo);
+    } else {
+        return;
+    }
+
+    // Граница области остаётся из iteration0.
+    const size_t beginX = hasLeftNeighbor() ? 0 : 1;
+    const size_t endX = p.SizeX() - (hasRightNeighbor() ? 0 : 1);
+    const size_t beginY = hasTopNeighbor() ? 0 : 1;
+    const size_t endY = p.SizeY() - (hasBottomNeighbor() ? 0 : 1);
+    for (size_t y = beginY; y < endY; y++) {
+        for (size_t x = beginX; x < endX; x++) {
+            p(x, y) = samples.Interpolate(grid.X[x], grid.Y[y]);
         }
     }
 }
@@ -392,53 +711,436 @@ void CProgram::iteration0() {
 void CProgram::iteration1() {
     r.Init(grid.X.Size(), grid.Y.Size());
 
-    CalcR(p, grid, r);
-    exchangeDefinitions.Exchange(r);
+    CalcR(p, grid, rhs, r);
+    CMatrix &direction = preconditioned();
 
-    CFraction tau = CalcTau(r, r, grid);
+    CFraction tau = exchangeAndCalcTau(direction);
     allReduceFraction(tau);
 
-    difference = CalcP(r, tau.Value(), p);
-    difference_2 = CalcP_2(r, tau.Value(), p);
-    allReduceDifference();
+    allReduceDifference(CalcP(direction, tau.Value(), p));
 
-    g = r;
+    g = direction;
 }
 
 void CProgram::iteration2() {
-    exchangeDefinitions.Exchange(p);
-
-    CalcR(p, grid, r);
-    exchangeDefinitions.Exchange(r);
+    exchangeAndCalcR();
+    CMatrix &residual = preconditioned();
 
-    CFraction alpha = CalcAlpha(r, g, grid);
+    // С предобусловливателем g = z - alpha * g, alpha = (Az, g) / (Ag, g): g остаются A-ортогональными.
+    CFraction alpha = exchangeAndCalcAlpha(residual);
     allReduceFraction(alpha);
 
-    CalcG(r, alpha.Value(), g);
-    exchangeDefinitions.Exchange(g);
+    CalcG(residual, alpha.Value(), g);
 
-    CFraction tau = CalcTau(r, g, grid);
+    CFraction tau = exchangeAndCalcTau(g);
     allReduceFraction(tau);
 
-    difference = CalcP(g, tau.Value(), p);
-    difference_2 = CalcP_2(g, tau.Value(), p);
-    allReduceDifference();
+    allReduceDifference(CalcP(g, tau.Value(), p));
+}
+
+void CProgram::fusedInit() {
+    r.Init(grid.X.Size(), grid.Y.Size());
+    g.Init(grid.X.Size(), grid.Y.Size());
+    ag.Init(grid.X.Size(), grid.Y.Size());
+    pNext.Init(grid.X.Size(), grid.Y.Size());
+    pendingTau = 0;
+    gAg = 0;
+}
+
+void CProgram::fusedIteration() {
+    // Обмен p не нужен: "заезд" p обновляется локально по g, который известен и в "заезде".
+    CFraction alpha(CalcFusedR(p, g, ag, pendingTau, grid, rhs, pNext, r), gAg);
+    p.Swap(pNext);
+    exchangeDefinitions.Start(r); // обмен r идёт, пока редуцируется alpha и считается глубина блока
+
+    if (gAg != 0) { // на первой итерации g = 0, alpha = 0
+        allReduceSums(&alpha.Numerator, 1); // знаменатель уже общий
+    } else {
+        alpha = CFraction(0);
+    }
+
+    // Обмен g не нужен: g = r - alpha * g считается и в "заезде", а Ag берётся по линейности.
+    CFusedSums sums;
+    sums.Tau = CFraction(0, 0);
+    if (overlap) {
+        sums.Add(CalcFusedG(r, alpha.Value(), grid, g, ag, interiorPart));
+    }
+    exchangeDefinitions.Finish(r);
+    for (vector<CMatrixPart>::const_iterator part = afterExchangeParts.begin();
+         part != afterExchangeParts.end(); ++part) {
+        sums.Add(CalcFusedG(r, alpha.Value(), grid, g, ag, *part));
+    }
+    CalcFusedGBorder(r, alpha.Value(), g);
+    NumericType buffer[3] = {sums.Tau.Numerator, sums.Tau.Denominator, sums.G.Squares};
+    // Сумма квадратов g редуцируется вместе с tau бесплатно, поэтому для нормы l2 расписание
+    // проверок не нужно. Максимум не складывается вместе с суммами и идёт через convergence.
+    allReduceSums(buffer, (norm == N_Max) ? 2 : 3);
+    pendingTau = buffer[0] / buffer[1];
+    gAg = buffer[1];
+    if (norm == N_Max) {
+        sums.G.Scale(pendingTau); // |p_new - p| = |tau| * |g|
+        allReduceDifference(sums.G);
+    } else {
+        sums.G.Squares = buffer[2];
+        difference = sums.G.Value(norm) * fabs(pendingTau);
+    }
+}
+
+void CProgram::fusedFinish() {
+    CalcP(g, pendingTau, p);
+    pendingTau = 0;
+}
+
+// Редукция сумм конвейерного метода: (r, r), (Ar, r) и сумма квадратов g складываются, max |g| - максимум.
+// Четыре числа - один элемент типа pipelinedType, поэтому MPI не разрежет их между вызовами.
+static void ReducePipelinedSums(void *in, void *inout, int *length, MPI_Datatype *) {
+    const NumericType *from = static_cast<const NumericType *>( in );
+    NumericType *to = static_cast<NumericType *>( inout );
+    for (int i = 0; i < *length; i++, from += 4, to += 4) {
+        to[0] += from[0];
+        to[1] += from[1];
+        to[2] += from[2];
+        to[3] = max(to[3], from[3]);
+    }
+}
+
+void CProgram::pipelinedInit() {
+    MpiCheck(MPI_Type_contiguous(4, MpiNumericType, &pipelinedType), "MPI_Type_contiguous");
+    MpiCheck(MPI_Type_commit(&pipelinedType), "MPI_Type_commit");
+    MpiCheck(MPI_Op_create(ReducePipelinedSums, 1 /* commute */, &pipelinedOp), "MPI_Op_create");
+
+    r.Init(grid.X.Size(), grid.Y.Size());
+    g.Init(grid.X.Size(), grid.Y.Size());
+    ag.Init(grid.X.Size(), grid.Y.Size());
+    ar.Init(grid.X.Size(), grid.Y.Size());
+    aar.Init(grid.X.Size(), grid.Y.Size());
+    aag.Init(grid.X.Size(), grid.Y.Size());
+
+    CalcR(p, grid, rhs, r);
+    const CFraction sums = exchangeAndCalcTau(r); // (r, r) и (Ar, r); "заезд" r получен
+    CalcOperator(r, grid, ar);
+    pipelinedSums = CPipelinedSums();
+    pipelinedSums.RR = sums.Numerator;
+    pipelinedSums.ArR = sums.Denominator;
+    previousRR = 0;
+    previousAlpha = 0;
+}
+
+void CProgram::pipelinedIteration() {
+    NumericType buffer[4] = {pipelinedSums.RR, pipelinedSums.ArR, pipelinedSums.G.Squares, pipelinedSums.G.Max};
+    MPI_Request request;
+    MpiCheck(MPI_Iallreduce(MPI_IN_PLACE, buffer, 1, pipelinedType, pipelinedOp, comm, &request),
+             "MPI_Iallreduce");
+
+    // Пока суммы в пути: обмен "заездом" Ar и A(Ar), не зависящий от alpha и beta.
+    exchangeDefinitions.Start(ar);
+    if (overlap) {
+        CalcOperator(ar, grid, aar, interiorPart);
+    }
+    exchangeDefinitions.Finish(ar);
+    for (vector<CMatrixPart>::const_iterator part = afterExchangeParts.begin();
+         part != afterExchangeParts.end(); ++part) {
+        CalcOperator(ar, grid, aar, *part);
+    }
+
+    {
+        CPhaseTimer timer(PP_Allreduce, 4); // время, которое редукция не успела скрыть
+        MpiCheck(MPI_Wait(&request, MPI_STATUS_IGNORE), "MPI_Wait");
+    }
+    const NumericType rr = buffer[0];
+    const NumericType arr = buffer[1];
+    NumericType alpha = rr / arr;
+    NumericType beta = 0;
+    if (previousRR != 0) {
+        CUpdateNorms norms;
+        norms.Squares = buffer[2];
+        norms.Max = buffer[3];
+        difference = fabs(previousAlpha) * norms.Value(norm); // изменение p на прошлой итерации
+        beta = rr / previousRR;
+        alpha = rr / (arr - beta * rr / previousAlpha);
+    }
+
+    CPipelinedVectors vectors(p, r, ar, g, ag, aag);
+    pipelinedSums = CalcPipelined(aar, alpha, beta, grid, vectors);
+    previousRR = rr;
+    previousAlpha = alpha;
+}
+
+void CProgram::pipelinedFinish() {
+    exchangeDefinitions.Exchange(p); // p обновлялся только во внутренних точках
+    MPI_Op_free(&pipelinedOp);
+    MPI_Type_free(&pipelinedType);
+}
+
+CMatrix &CProgram::preconditioned() {
+    if (multigrid.get() == 0) {
+        return r;
+    }
+    multigrid->Precondition(r, z); // "заезд" r не нужен: сглаживатель берёт r только в своих узлах
+    return z;
+}
+
+void CProgram::multigridInit() {
+    r.Init(grid.X.Size(), grid.Y.Size());
+    exchangeAndCalcR();
+}
+
+void CProgram::multigridIteration() {
+    const bool due = convergence->Due(iterations); // копия p и проход по разности - только для проверки
+    if (due) {
+        pPrevious = p;
+    }
+    multigrid->Cycle(p, rhs.Values());
+    allReduceDifference(due ? CalcDifference(p, pPrevious) : CUpdateNorms());
+}
+
+void CProgram::multigridFinish() {
+    exchangeDefinitions.Exchange(p); // p обновлялся только во внутренних точках
+}
+
+void CProgram::directIteration() {
+    exchangeAndCalcR();
+    direct->Solve(r, z);
+    allReduceDifference(CalcP(z, 1, p));
+}
+
+void CProgram::mixedInit() {
+    r.Init(grid.X.Size(), grid.Y.Size());
+    z.Init(grid.X.Size(), grid.Y.Size());
+    floatR.Init(grid.X.Size(), grid.Y.Size());
+    floatE.Init(grid.X.Size(), grid.Y.Size());
+    floatS.Init(grid.X.Size(), grid.Y.Size());
+    floatG.Init(grid.X.Size(), grid.Y.Size());
+}
+
+void CProgram::mixedIteration() {
+    exchangeAndCalcR();
+    ConvertMatrix(r, floatR);
+    mixedSolve();
+    ConvertMatrix(floatE, z);
+    allReduceDifference(CalcP(z, 1, p));
+}
+
+void CProgram::mixedSolve() {
+    // Те же формулы, что в iteration1 и iteration2, для A e = r с e = 0 на границе области.
+    // Дроби и нормы суммируются в NumericType, во float хранятся только матрицы.
+    floatE.Init(grid.X.Size(), grid.Y.Size());
+    CalcResidual(floatE, floatR, grid, floatS); // s = A(0) - r
+    floatExchangeDefinitions.Exchange(floatS);
+    CFraction tau = CalcTau(floatS, floatS, grid);
+    allReduceFraction(tau);
+    if (tau.Denominator == 0) { // r == 0: поправка не нужна
+        return;
+    }
+    NumericType largest = allReduceNorm(CalcP(floatS, tau.Value(), floatE));
+    floatG = floatS;
+
+    for (size_t iteration = 1; iteration < mixedIterations; iteration++) {
+        floatExchangeDefinitions.Exchange(floatE);
+        CalcResidual(floatE, floatR, grid, floatS);
+        floatExchangeDefinitions.Exchange(floatS);
+        CFraction alpha = CalcAlpha(floatS, floatG, grid);
+        allReduceFraction(alpha);
+        CalcG(floatS, alpha.Value(), floatG);
+        floatExchangeDefinitions.Exchange(floatG);
+        tau = CalcTau(floatS, floatG, grid);
+        allReduceFraction(tau);
+        if (tau.Denominator == 0) {
+            break;
+        }
+        const NumericType step = allReduceNorm(CalcP(floatG, tau.Value(), floatE));
+        largest = max(largest, step);
+        if (step <= mixedReduction * largest) { // шаги CG сначала растут, сравниваем с наибольшим
+            break;
+        }
+        // Шаг меньше DefaultEps не виден во внешней проверке: на нём останавливается и классический метод.
+        // Иначе последняя, уже малая поправка снова решалась бы до mixedReduction от своего начала.
+        if (step < DefaultEps) {
+            break;
+        }
+    }
+}
+
+void CProgram::chebyshevInit() {
+    r.Init(grid.X.Size(), grid.Y.Size());
+    g.Init(grid.X.Size(), grid.Y.Size());
+    // A = Lx (x) I + I (x) Ly: спектр A - суммы значений осей, отрезок считается по оси целиком у каждого ранка.
+    const CArea area = problem.Area();
+    NumericType smallestX, largestX, smallestY, largestY;
+    AxisSpectrumBounds(BlockedAxis(area.X0, area.Xn, pointsX, processesX).Points, smallestX, largestX);
+    AxisSpectrumBounds(BlockedAxis(area.Y0, area.Yn, pointsY, processesY).Points, smallestY, largestY);
+    chebyshevCenter = (largestX + largestY + smallestX + smallestY) / 2;
+    chebyshevRadius = (largestX + largestY - smallestX - smallestY) / 2;
+    chebyshevRho = 0;
+    chebyshevTau = 0;
+    sweeps = halo; // первый проход начинается с обмена
+}
+
+void CProgram::chebyshevIteration() {
+    // Трёхчленная рекурсия (Saad, алгоритм 12.1) при sigma = center / radius: d_0 = r_0 / center,
+    // rho_k = 1 / (2 sigma - rho_k-1), d_k = rho_k rho_k-1 d_k-1 + 2 rho_k / radius r_k, p = p - d_k.
+    // Хранится g = d / tau, тогда g = r - alpha * g - тот же проход, что в методе сопряжённых градиентов.
+    NumericType alpha = 0;
+    NumericType tau = 1 / chebyshevCenter;
+    NumericType rho = chebyshevRadius / chebyshevCenter;
+    if (chebyshevTau != 0) {
+        rho = 1 / (2 * chebyshevCenter / chebyshevRadius - chebyshevRho);
+        tau = 2 * rho / chebyshevRadius;
+        alpha = -rho * chebyshevRho * chebyshevTau / tau;
+    }
+    chebyshevRho = rho;
+    chebyshevTau = tau;
+    if (halo > 1) {
+        allReduceDifference(chebyshevSweep(alpha, tau));
+        return;
+    }
+    exchangeAndCalcR();
+    CalcG(r, alpha, g);
+    allReduceDifference(CalcP(g, tau, p));
+}
+
+CUpdateNorms CProgram::chebyshevSweep(NumericType alpha, NumericType tau) {
+    if (sweeps == halo) { // p и g верны только в своих узлах
+        exchangeDefinitions.Start(p);
+        directionExchange.Start(g);
+        exchangeDefinitions.Finish(p);
+        directionExchange.Finish(g);
+        sweeps = 0;
+    }
+    sweeps++;
+    const CMatrixPart part = haloPart(sweeps); // шаблон читает p на узел шире: там p верен после прошлого прохода
+    const CMatrixPart own = haloPart(halo);
+    CalcR(p, grid, rhs, r, part);
+    rhs.SetReady();
+    CalcG(r, alpha, g, part);
+    // part без own: строки над и под own во всю ширину part, столбцы слева и справа от own.
+    if (part.BeginY < own.BeginY) {
+        CalcP(g, tau, p, CMatrixPart(part.BeginX, part.EndX, part.BeginY, own.BeginY));
+    }
+    if (own.EndY < part.EndY) {
+        CalcP(g, tau, p, CMatrixPart(part.BeginX, part.EndX, own.EndY, part.EndY));
+    }
+    if (part.BeginX < own.BeginX) {
+        CalcP(g, tau, p, CMatrixPart(part.BeginX, own.BeginX, own.BeginY, own.EndY));
+    }
+    if (own.EndX < part.EndX) {
+        CalcP(g, tau, p, CMatrixPart(own.EndX, part.EndX, own.BeginY, own.EndY));
+    }
+    return CalcP(g, tau, p, own);
+}
+
+CMatrixPart CProgram::haloPart(size_t depth) const {
+    return CMatrixPart(hasLeftNeighbor() ? depth : 1, grid.X.Size() - (hasRightNeighbor() ? depth : 1),
+                       hasTopNeighbor() ? depth : 1, grid.Y.Size() - (hasBottomNeighbor() ? depth : 1));
+}
+
+void CProgram::checkpointState(vector<CMatrix *> &matrices, vector<NumericType *> &scalars) {
+    matrices.assign(1, &p);
+    scalars.assign(1, &difference);
+    switch (iterationMode) {
+        case IM_Classic: // r считается заново в начале итерации
+            matrices.push_back(&g);
+            break;
+        case IM_Fused: // p без отложенного шага pendingTau * g
+            matrices.push_back(&g);
+            matrices.push_back(&ag);
+            scalars.push_back(&pendingTau);
+            scalars.push_back(&gAg);
+            break;
+        case IM_Pipelined: // A(Ar) считается заново, суммы ещё не редуцированы
+            matrices.push_back(&r);
+            matrices.push_back(&ar);
+            matrices.push_back(&g);
+            matrices.push_back(&ag);
+            matrices.push_back(&aag);
+            scalars.push_back(&previousRR);
+            scalars.push_back(&previousAlpha);
+            scalars.push_back(&pipelinedSums.RR);
+            scalars.push_back(&pipelinedSums.ArR);
+            scalars.push_back(&pipelinedSums.G.Squares);
+            scalars.push_back(&pipelinedSums.G.Max);
+            break;
+        case IM_Chebyshev: // r считается заново в начале итерации
+            matrices.push_back(&g);
+            scalars.push_back(&chebyshevRho);
+            scalars.push_back(&chebyshevTau);
+            break;
+        case IM_Multigrid:
+        case IM_Direct:
+        case IM_Mixed: // внутренние итерации каждый раз начинаются с e = 0
+            break;
+    }
+}
+
+void CProgram::endIteration(IIterationCallback &callback) {
+    callback.EndIteration(difference);
+    iterations++;
+    // После нулевой итерации метод ещё не подготовлен, сохранять нечего.
+    if (checkpointFilename.empty() || iterations < 2 || !checkpoint->Due(iterations)) {
+        return;
+    }
+    // Суммы конвейерного метода сохраняются общими: локальные суммы не подходят другому разбиению.
+    const CPipelinedSums localSums = pipelinedSums;
+    if (iterationMode == IM_Pipelined) {
+        NumericType buffer[4] = {pipelinedSums.RR, pipelinedSums.ArR, pipelinedSums.G.Squares, pipelinedSums.G.Max};
+        MpiCheck(MPI_Allreduce(MPI_IN_PLACE, buffer, 1, pipelinedType, pipelinedOp, comm), "MPI_Allreduce");
+        pipelinedSums.RR = buffer[0];
+        pipelinedSums.ArR = buffer[1];
+        pipelinedSums.G.Squares = buffer[2];
+        pipelinedSums.G.Max = buffer[3];
+    }
+    vector<CMatrix *> matrices;
+    vector<NumericType *> scalars;
+    checkpointState(matrices, scalars);
+    vector<NumericType> values(scalars.size());
+    for (size_t i = 0; i < scalars.size(); i++) {
+        values[i] = *scalars[i];
+    }
+    pipelinedSums = localSums;
+    checkpoint->Start(checkpointFilename, iterationMode, iterations, matrices, values);
+}
+
+void CProgram::restore(const string &filename, IIterationCallback &callback) {
+    vector<CMatrix *> matrices;
+    vector<NumericType *> scalars;
+    checkpointState(matrices, scalars);
+    vector<NumericType> values;
+    iterations = checkpoint->Read(filename, iterationMode, matrices, values);
+    if (values.size() != scalars.size()) {
+        throw CException("checkpoint `" + filename + "` was written by another iteration method");
+    }
+    for (size_t i = 0; i < scalars.size(); i++) {
+        *scalars[i] = values[i];
+    }
+    if (iterationMode == IM_Pipelined && rank != 0) { // общие суммы вносит в редукцию один ранк
+        pipelinedSums = CPipelinedSums();
+    }
+    callback.Resume(iterations, difference);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 // Последовательная реализация.
-void Serial(const size_t pointsX, const size_t pointsY, const CArea &area,
+void Serial(const size_t pointsX, const size_t pointsY, const IProblem &problem, const CSolverOptions &options,
             IIterationCallback &callback, const string &dumpFilename = "") {
     // Инициализируем grid.
+    const CArea area = problem.Area();
     CUniformGrid grid;
     grid.X.Init(area.X0, area.Xn, pointsX); // MathObjects.cpp -> PartInit(0 3 100 0 100)
     grid.Y.Init(area.Y0, area.Yn, pointsY);
+    if (options.FullWeights) {
+        grid.InitWeights();
+    }
 
     CMatrix p(grid.X.Size(), grid.Y.Size()); // create empty matrixes
     CMatrix r(grid.X.Size(), grid.Y.Size());
+    CRightHandSide rhs(problem, grid, options.LazyRightHandSide); // значения F в узлах
 
     NumericType difference = numeric_limits<NumericType>::max(); // max NumericType
+    // Без редукций расписание проверок только решает, после каких итераций обновляется difference.
+    CConvergenceMonitor convergence(options.ConvergenceCheck, options.ConvergencePeriod, options.Norm, DefaultEps,
+                                    MPI_COMM_NULL);
+    size_t iteration = 1; // номер следующей итерации
 
     // Выполняем нулевую итерацию (инициализацию).
     if (!callback.BeginIteration()) { // if diff-eps and max number of iteration bad
@@ -446,64 +1148,123 @@ void Serial(const size_t pointsX, const size_t pointsY, const CArea &area,
     }
 
     for (size_t x = 0; x < p.SizeX(); x++) {
-        p(x, 0) = Phi(grid.X[x], grid.Y[0]); // border values
-        p(x, p.SizeY() - 1) = Phi(grid.X[x], grid.Y[p.SizeY() - 1]); // border values
+        p(x, 0) = problem.Phi(grid.X[x], grid.Y[0]); // border values
+        p(x, p.SizeY() - 1) = problem.Phi(grid.X[x], grid.Y[p.SizeY() - 1]); // border values
     }
     for (size_t y = 1; y < p.SizeY() - 1; y++) {
-        p(0, y) = Phi(grid.X[0], grid.Y[y]);  // border values
-        p(p.SizeX() - 1, y) = Phi(grid.X[p.SizeX() - 1], grid.Y[y]);  // border values
+        p(0, y) = problem.Phi(grid.X[0], grid.Y[y]);  // border values
+        p(p.SizeX() - 1, y) = problem.Phi(grid.X[p.SizeX() - 1], grid.Y[y]);  // border values
     }
     callback.EndIteration(difference); // with max NumericType
 
-    // Выполняем первую итерацию.
-    if (!callback.BeginIteration()) {
-        return;
-    }
-    {
-        CalcR(p, grid, r); // Cчитаем невязку r в неграничных точках
-        const CFraction tau = CalcTau(r, r, grid); // считаем tau_1
-        difference = CalcP(r, tau.Value(), p); // Вычисление значений pij во внутренних точках, возвращается норма.
-    }
-    callback.EndIteration(difference);
+    if (options.IterationMode == IM_Fused) {
+        CMatrix g(grid.X.Size(), grid.Y.Size()); // на первой итерации g = Ag = 0 и alpha = 0
+        CMatrix ag(grid.X.Size(), grid.Y.Size());
+        CMatrix pNext(grid.X.Size(), grid.Y.Size());
+        NumericType tau = 0; // отложенный шаг p = p - tau * g
+        NumericType gAg = 0; // знаменатель alpha == знаменатель прошлого tau
+        while (callback.BeginIteration()) {
+            const NumericType alphaNumerator = CalcFusedR(p, g, ag, tau, grid, rhs, pNext, r);
+            p.Swap(pNext);
+            const NumericType alpha = (gAg != 0) ? alphaNumerator / gAg : 0;
+            const CFusedSums sums = CalcFusedG(r, alpha, grid, g, ag);
+            tau = sums.Tau.Value();
+            gAg = sums.Tau.Denominator;
+            CUpdateNorms norms = sums.G;
+            norms.Scale(tau); // |p_new - p| = |tau| * |g|
+            convergence.Submit(iteration++, norms, difference);
+
+            callback.EndIteration(difference);
+        }
+        CalcP(g, tau, p); // отложенное обновление
+    } else {
+        // Выполняем первую итерацию.
+        if (!callback.BeginIteration()) {
+            return;
+        }
+        {
+            CalcR(p, grid, rhs, r); // Cчитаем невязку r в неграничных точках
+            const CFraction tau = CalcTau(r, r, grid); // считаем tau_1
+            convergence.Submit(iteration++, CalcP(r, tau.Value(), p), difference); // Вычисление значений pij во внутренних точках, возвращается норма.
+        }
+        callback.EndIteration(difference);
 
-    CMatrix g(r);
-    // Выполняем остальные итерации.
-    while (callback.BeginIteration()) { // выйдем из цикла, когда достигнем eps
-        CalcR(p, grid, r); // Cчитаем невязку r в неграничных точках
-        const CFraction alpha = CalcAlpha(r, g, grid); // параметр скорейшего спуска
-        CalcG(r, alpha.Value(), g); // считаем направление
-        const CFraction tau = CalcTau(r, g, grid); // считаем tau_k
-        difference = CalcP(g, tau.Value(), p); // Вычисление значений pij во внутренних точках, возвращается норма.
+        CMatrix g(r);
+        // Выполняем остальные итерации.
+        while (callback.BeginIteration()) { // выйдем из цикла, когда достигнем eps
+            CalcR(p, grid, rhs, r); // Cчитаем невязку r в неграничных точках
+            const CFraction alpha = CalcAlpha(r, g, grid); // параметр скорейшего спуска
+            CalcG(r, alpha.Value(), g); // считаем направление
+            const CFraction tau = CalcTau(r, g, grid); // считаем tau_k
+            convergence.Submit(iteration++, CalcP(g, tau.Value(), p), difference); // Вычисление значений pij во внутренних точках, возвращается норма.
 
-        callback.EndIteration(difference);
+            callback.EndIteration(difference);
+        }
     }
 
     if (!dumpFilename.empty()) { // 3 аргумент - вывод результата
-        cout << "Total error: " << TotalError(p, grid) << endl;
-        ofstream outputFile(dumpFilename.c_str());
-        DumpMatrix(p, grid, outputFile);
+        cout << "Total error: " << TotalError(p, grid, problem) << endl;
+        CPhaseTimer timer(PP_Output, p.SizeX() * p.SizeY());
+        if (options.OutputFormat == OF_Text) {
+            ofstream outputFile(dumpFilename.c_str());
+            DumpMatrix(p, grid, outputFile);
+        } else {
+            WriteBinaryDump(dumpFilename, p, BlockedAxis(area.X0, area.Xn, pointsX, 1),
+                            BlockedAxis(area.Y0, area.Yn, pointsY, 1), 0, 0, MPI_COMM_SELF);
+        }
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void ParseArguments(const int argc, const char *const argv[],
-                    size_t &pointsX, size_t &pointsY, string &dumpFilename) { // read arguments
-    if (argc < 3 || argc > 4) {
-        throw CException("too few arguments\n"
-                                 "Usage: dirch POINTS_X POINTS_Y [DUMP_FILENAME]");
+void ParseArguments(const int argc, const char *const argv[], size_t &pointsX, size_t &pointsY,
+                    string &dumpFilename, CSolverOptions &options) { // read arguments
+    const string usage = string("Usage: dirch POINTS_X POINTS_Y [DUMP_FILENAME] [OPTIONS]\n") + OptionsUsage;
+    vector<string> arguments; // позиционные аргументы
+    for (int i = 1; i < argc; i++) {
+        const string argument(argv[i]);
+        if (argument.compare(0, 2, "--") == 0) {
+            ParseOption(argument, options);
+        } else {
+            arguments.push_back(argument);
+        }
     }
 
-    pointsX = strtoul(argv[1], 0, 10);
-    pointsY = strtoul(argv[2], 0, 10);
+    if (arguments.size() < 2 || arguments.size() > 3) {
+        throw CException("too few arguments\n" + usage);
+    }
+
+    pointsX = strtoul(arguments[0].c_str(), 0, 10);
+    pointsY = strtoul(arguments[1].c_str(), 0, 10);
 
     if (pointsX == 0 || pointsY == 0) {
-        throw CException("invalid format of arguments\n"
-                                 "Usage: dirch POINTS_X POINTS_Y [DUMP_FILENAME]");
+        throw CException("invalid format of arguments\n" + usage);
+    }
+
+    if (arguments.size() == 3) {
+        dumpFilename = arguments[2];
     }
 
-    if (argc == 4) {
-        dumpFilename = argv[3];
+    if (options.Preconditioner != PC_None && options.IterationMode != IM_Classic) {
+        throw CException("--preconditioner applies to --iteration=classic only");
+    }
+    if (!options.RestartFilename.empty() && (!options.InitialFilename.empty() || options.NestedLevels > 0)) {
+        throw CException("--restart takes the whole state from the checkpoint, without --initial or --nested");
+    }
+    if (!options.InitialFilename.empty() && options.NestedLevels > 0) {
+        throw CException("--initial and --nested are alternative initial guesses");
+    }
+    if (!options.ProfileFilename.empty() && options.ProfileFormat == PF_None) {
+        throw CException("--profile-file needs --profile");
+    }
+    if (options.ConvergenceCheck == CC_Auto) { // у Чебышёва без проверок нет ни одной блокирующей редукции
+        options.ConvergenceCheck = (options.IterationMode == IM_Chebyshev) ? CC_Periodic : CC_Every;
+    }
+    if (options.HaloWidth > 1 && options.IterationMode != IM_Chebyshev) {
+        throw CException("--halo wider than 1 applies to --iteration=chebyshev only");
+    }
+    if (options.HaloWidth > 1 && options.Overlap) {
+        throw CException("--halo wider than 1 exchanges once per several sweeps, without --overlap");
     }
 }
 
@@ -519,18 +1280,52 @@ void Main(const int argc, const char *const argv[]) {
         size_t pointsX;
         size_t pointsY;
         string dumpFilename;
-        ParseArguments(argc, argv, pointsX, pointsY, dumpFilename); // read arguments
+        CSolverOptions options;
+        ParseArguments(argc, argv, pointsX, pointsY, dumpFilename, options); // read arguments
+        CStencilEngine::SetTileSize(CTileSize(options.TileX, options.TileY));
+        CStencilEngine::SetDeterministic(options.Deterministic);
+        CMatrix::SetFirstTouch(options.FirstTouch);
+        CSimd::Select(options.SimdLevel);
+        if (options.ReportPlacement) {
+            ReportPlacement(cout);
+        }
+        if (options.ProfileFormat != PF_None) {
+            CProfiler::Enable();
+        }
 
-        auto_ptr <IIterationCallback> callback(new CSimpleIterationCallback);
+        unique_ptr<IProblem> problem(new CDefaultProblem);
+        if (!options.ProblemFilename.empty()) {
+            problem.reset(new CTableProblem(options.ProblemFilename));
+        }
+
+        unique_ptr<IIterationCallback> callback(new CSimpleIterationCallback);
+        CLoggingIterationCallback *log = 0; // прореженный журнал ранка 0
         if (CMpiSupport::Rank() == 0) { // if main mpi process
-            callback.reset(new CIterationCallback(cout, 0)); // destruct and create new
+            if (options.LogEvery > 0 || options.LogSeconds > 0 || !options.HistoryFilename.empty()) {
+                const size_t every = (options.LogEvery == 0 && options.LogSeconds == 0) ? 1 : options.LogEvery;
+                log = new CLoggingIterationCallback(cout, 0, every, options.LogSeconds);
+                callback.reset(log);
+            } else {
+                callback.reset(new CIterationCallback(cout, 0)); // destruct and create new
+            }
         }
 
-        if (CMpiSupport::NumberOfProccess() == 1) { // only one process
-            Serial(pointsX, pointsY, Area, *callback, dumpFilename);
+        const bool serialMode = (options.IterationMode == IM_Classic || options.IterationMode == IM_Fused) &&
+                                options.Preconditioner == PC_None &&
+                                options.CheckpointFilename.empty() && options.RestartFilename.empty() &&
+                                options.InitialFilename.empty() && options.NestedLevels == 0;
+        if (CMpiSupport::NumberOfProccess() == 1 && serialMode) { // only one process
+            Serial(pointsX, pointsY, *problem, options, *callback, dumpFilename);
         } else { // more then one process
-            CProgram::Run(pointsX, pointsY, Area, *callback, dumpFilename);
+            CProgram::Run(pointsX, pointsY, *problem, options, *callback, dumpFilename);
+        }
+        if (log != 0) { // поток записи журнала больше не пишет в cout
+            log->Finish();
+            if (!options.HistoryFilename.empty()) {
+                log->WriteHistory(options.HistoryFilename, options.HistoryFormat);
+            }
         }
+        CProfiler::Report(options.ProfileFormat, options.ProfileFilename);
     }
     cout << "(" << CMpiSupport::Rank() << ") Time: " << programTime << endl;
 }
@@ -0,0 +1,165 @@
+// Преобразование результатов dirch между текстовым и двоичным форматами (BinaryDump.h).
+//
+//   dirch-convert to-binary OUTPUT INPUT...  текстовые файлы (например, DUMP0 DUMP1 ... по процессам) -> один двоичный
+//   dirch-convert to-text INPUT OUTPUT       двоичный файл -> строки "x y значение" по всей сетке
+//
+// Текстовые файлы процессов пересекаются по "заезду", а угловые узлы "заезда" не обмениваются.
+// Поэтому значение узла берётся из файла, где узел дальше всего от края блока файла.
+// Текст хранит 6 значащих цифр, двоичный файл из текста точен только до них.
+
+#include <Std.h>
+#include <Definitions.h>
+#include <Errors.h>
+#include <BinaryDump.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct CTextPoint {
+    NumericType X;
+    NumericType Y;
+    NumericType Value;
+};
+
+struct CPointValue { // значение узла и насколько ему можно верить
+    NumericType Value;
+    int Priority; // 2 - внутри блока файла, 1 - на краю, 0 - в углу
+
+    CPointValue() : Value(0), Priority(-1) {}
+};
+
+static void ReadText(const string &filename, vector<CTextPoint> &points) {
+    ifstream input(filename.c_str());
+    if (!input) {
+        throw CException("cannot open `" + filename + "`");
+    }
+    string line;
+    while (getline(input, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        istringstream fields(line);
+        CTextPoint point;
+        if (!(fields >> point.X >> point.Y >> point.Value)) {
+            throw CException("invalid line in `" + filename + "`: " + line);
+        }
+        points.push_back(point);
+    }
+}
+
+static void ToBinary(const string &output, const vector<string> &inputs) {
+    vector<vector<CTextPoint> > files(inputs.size());
+    vector<NumericType> axisX;
+    vector<NumericType> axisY;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        ReadText(inputs[i], files[i]);
+        for (size_t j = 0; j < files[i].size(); j++) {
+            axisX.push_back(files[i][j].X);
+            axisY.push_back(files[i][j].Y);
+        }
+    }
+    sort(axisX.begin(), axisX.end());
+    axisX.erase(unique(axisX.begin(), axisX.end()), axisX.end());
+    sort(axisY.begin(), axisY.end());
+    axisY.erase(unique(axisY.begin(), axisY.end()), axisY.end());
+
+    vector<CPointValue> values(axisX.size() * axisY.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        const vector<CTextPoint> &points = files[i];
+        if (points.empty()) {
+            continue;
+        }
+        NumericType minX = points[0].X;
+        NumericType maxX = points[0].X;
+        NumericType minY = points[0].Y;
+        NumericType maxY = points[0].Y;
+        for (size_t j = 1; j < points.size(); j++) {
+            minX = min(minX, points[j].X);
+            maxX = max(maxX, points[j].X);
+            minY = min(minY, points[j].Y);
+            maxY = max(maxY, points[j].Y);
+        }
+        for (size_t j = 0; j < points.size(); j++) {
+            const CTextPoint &point = points[j];
+            const int priority = (point.X != minX && point.X != maxX ? 1 : 0) +
+                                 (point.Y != minY && point.Y != maxY ? 1 : 0);
+            const size_t x = lower_bound(axisX.begin(), axisX.end(), point.X) - axisX.begin();
+            const size_t y = lower_bound(axisY.begin(), axisY.end(), point.Y) - axisY.begin();
+            CPointValue &value = values[y * axisX.size() + x];
+            if (priority > value.Priority) {
+                value.Value = point.Value;
+                value.Priority = priority;
+            }
+        }
+    }
+
+    CBinaryDumpHeader header;
+    copy(BinaryDumpMagic, BinaryDumpMagic + sizeof(BinaryDumpMagic), header.Magic);
+    header.PointsX = axisX.size();
+    header.PointsY = axisY.size();
+    header.ValueSize = sizeof(NumericType);
+    vector<NumericType> grid(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        if (values[i].Priority < 0) {
+            throw CException("the text files do not cover the whole grid");
+        }
+        grid[i] = values[i].Value;
+    }
+
+    ofstream file(output.c_str(), ios::binary);
+    file.write(reinterpret_cast<const char *>( &header ), sizeof(header));
+    file.write(reinterpret_cast<const char *>( &axisX[0] ), axisX.size() * sizeof(NumericType));
+    file.write(reinterpret_cast<const char *>( &axisY[0] ), axisY.size() * sizeof(NumericType));
+    file.write(reinterpret_cast<const char *>( &grid[0] ), grid.size() * sizeof(NumericType));
+    if (!file) {
+        throw CException("cannot write `" + output + "`");
+    }
+}
+
+static void ToText(const string &input, const string &output) {
+    ifstream file(input.c_str(), ios::binary);
+    CBinaryDumpHeader header;
+    if (!file.read(reinterpret_cast<char *>( &header ), sizeof(header)) ||
+        !equal(BinaryDumpMagic, BinaryDumpMagic + sizeof(BinaryDumpMagic), header.Magic)) {
+        throw CException("`" + input + "` is not a dirch binary dump");
+    }
+    if (header.ValueSize != sizeof(NumericType)) {
+        throw CException("`" + input + "` was written with another NumericType");
+    }
+    vector<NumericType> axisX(header.PointsX);
+    vector<NumericType> axisY(header.PointsY);
+    vector<NumericType> row(header.PointsX);
+    file.read(reinterpret_cast<char *>( &axisX[0] ), axisX.size() * sizeof(NumericType));
+    file.read(reinterpret_cast<char *>( &axisY[0] ), axisY.size() * sizeof(NumericType));
+
+    ofstream text(output.c_str());
+    for (size_t y = 0; y < axisY.size(); y++) {
+        if (!file.read(reinterpret_cast<char *>( &row[0] ), row.size() * sizeof(NumericType))) {
+            throw CException("`" + input + "` is truncated");
+        }
+        for (size_t x = 0; x < axisX.size(); x++) {
+            text << axisX[x] << '\t' << axisY[y] << '\t' << row[x] << '\n';
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv) {
+    const string usage = "Usage: dirch-convert to-binary OUTPUT INPUT...\n"
+                         "       dirch-convert to-text INPUT OUTPUT\n";
+    try {
+        const vector<string> arguments(argv + 1, argv + argc);
+        if (arguments.size() >= 3 && arguments[0] == "to-binary") {
+            ToBinary(arguments[1], vector<string>(arguments.begin() + 2, arguments.end()));
+        } else if (arguments.size() == 3 && arguments[0] == "to-text") {
+            ToText(arguments[1], arguments[2]);
+        } else {
+            cerr << usage;
+            return 2;
+        }
+    } catch (exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}